@@ -9,6 +9,92 @@
 
 @protocol AudioEngineIFProtocol;
 
+/**
+ *  Output level. Both values are 0.0…1.0 of full scale.
+ */
+typedef struct {
+    float peak;
+    float rms;
+} AudioEngineLevel;
+
+/**
+ *  Analysis of the sound of a track, made when it is loaded
+ */
+typedef struct {
+    NSTimeInterval duration;        // after the silence is trimmed
+    NSTimeInterval trimmedDuration; // silence removed from the end
+    float peak;                     // 0.0…1.0 of full scale
+    float loudness;                 // rms of the loudest 50msec, 0.0…1.0 of full scale
+} AudioEngineSampleInfo;
+
+/**
+ *  State of the sync to an external clock. Durations are in seconds.
+ */
+typedef struct {
+    BOOL isLocked;                      // the sequencer follows the clock
+    double tempo;                       // bpm of the clock, jitter filtered. 0.0 if not locked
+    uint64_t numberOfTicks;             // 24 per beat
+    uint64_t numberOfMissedTicks;       // lost ticks bridged by the filter
+    uint64_t numberOfRelocations;       // times the sequencer jumped to the position of the clock
+    NSTimeInterval jitter;              // rms of the ticks against the filtered clock
+    NSTimeInterval maxJitter;
+    NSTimeInterval syncError;           // rms of the sequencer against the filtered clock
+    NSTimeInterval maxSyncError;
+    NSTimeInterval latency;             // mean time the sequencer is behind the clock
+    NSTimeInterval tickDelay;           // mean time from a tick to the render callback taking it
+} AudioEngineClockSync;
+
+/**
+ *  Snapshot of the render path telemetry. Durations are in seconds.
+ */
+@interface AudioEnginePerformance : NSObject
+
+/**
+ *  number of render callbacks
+ */
+@property (nonatomic, readonly) uint64_t numberOfCallbacks;
+
+/**
+ *  number of callbacks which took longer than the duration of their buffer
+ */
+@property (nonatomic, readonly) uint64_t numberOfDeadlineMisses;
+
+/**
+ *  callback duration histogram. the element N counts callbacks which took [2^N, 2^(N+1)) usec.
+ */
+@property (nonatomic, readonly) NSArray<NSNumber *>* _Nonnull callbackHistogram;
+
+/**
+ *  duration of the last / longest / average callback
+ */
+@property (nonatomic, readonly) NSTimeInterval lastCallbackDuration;
+@property (nonatomic, readonly) NSTimeInterval maxCallbackDuration;
+@property (nonatomic, readonly) NSTimeInterval averageCallbackDuration;
+
+/**
+ *  total time spent in the sequencer / in rendering voices
+ */
+@property (nonatomic, readonly) NSTimeInterval sequencerTime;
+@property (nonatomic, readonly) NSTimeInterval renderTime;
+
+/**
+ *  total number of sequencer events
+ */
+@property (nonatomic, readonly) uint64_t numberOfEvents;
+
+/**
+ *  number of voices playing at the end of the last callback, and its maximum
+ */
+@property (nonatomic, readonly) NSInteger activeVoices;
+@property (nonatomic, readonly) NSInteger maxActiveVoices;
+
+/**
+ *  CPU load of the audio graph(0.0-1.0)
+ */
+@property (nonatomic, readonly) float cpuLoad;
+@property (nonatomic, readonly) float maxCPULoad;
+@end
+
 @interface AudioEngineIF : NSObject
 
 /**
@@ -17,12 +103,13 @@
 @property (nonatomic, assign) double tempo;
 
 /**
- *  number of tracks
+ *  number of tracks(up to 256). Tracks can be added or removed while playing.
+ *  The remaining tracks keep their patterns. Set the sounds for the new number of tracks after changing it.
  */
 @property (nonatomic, assign) NSInteger numTracks;
 
 /**
- *  number of steps in a track
+ *  number of steps in a track(up to 256). The sequences are kept when it is changed.
  */
 @property (nonatomic, assign) NSInteger numSteps;
 
@@ -36,6 +123,42 @@
  */
 @property (nonatomic, copy) NSArray<NSString*>* _Nullable sounds;
 
+/**
+ *  Requested size of the audio I/O buffer in frames(default 1024).
+ *  Use a small size such as 64 for live playing. The hardware may choose another size.
+ */
+@property (nonatomic, assign) NSInteger preferredBufferSize;
+
+/**
+ *  Actual size of the audio I/O buffer in frames
+ */
+@property (nonatomic, readonly) NSInteger bufferSize;
+
+/**
+ *  Playback latency in seconds : from rendering a frame to hearing it(I/O buffer + hardware output).
+ *  Output only : the audio session is for playback, so there is no input nor round-trip latency.
+ */
+@property (nonatomic, readonly) NSTimeInterval playbackLatency;
+
+/**
+ *  Play the tracks repeating the same loop from pre-rendered buffers(default NO).
+ *  The loops are rendered on a background thread. The output is identical to the normal rendering.
+ *  Only the loops of a whole number of frames up to 8 sec are cached : at 44.1kHz, 16 sixteenths at 120 bpm(88200 frames), not at 128 bpm(82687.5).
+ */
+@property (nonatomic, assign) BOOL loopCacheEnabled;
+
+/**
+ *  Level(0.0…1.0 of full scale) at or below which the end of the sounds is trimmed when they are loaded(default 0.0 : only digital silence).
+ *  The sounds are reloaded when it is changed.
+ */
+@property (nonatomic, assign) double silenceThreshold;
+
+/**
+ *  Level(0.0…1.0 of full scale) to end a voice early when the rest of its sound is below it at the current gain(default 0.0 : off).
+ *  The output of a voice differs from the full rendering by at most this level. e.g. 0.001(-60dB)
+ */
+@property (nonatomic, assign) double releaseThreshold;
+
 - (instancetype _Nonnull)initWithNumOfTracks:(int)numTracks
                                   numOfSteps:(int)numSteps
                                 stepsPerBeat:(int)stepsPerBeat;
@@ -50,6 +173,56 @@
  */
 - (void)setStepSequence:(NSArray<NSNumber *>* _Nonnull)sequence ofTrack:(NSInteger)trackNo;
 
+/**
+ *  Set packed sequences of consecutive tracks at once. They take effect together at the next render callback.
+ *
+ *  Bit N of the word W of a track is the step W * 32 + N. Steps after numSteps are ignored.
+ *
+ *  @param bits          wordsPerTrack words for each track
+ *  @param wordsPerTrack number of words per track. (numSteps + 31) / 32 or more
+ *  @param firstTrack    track number of the first sequence
+ *  @param count         number of tracks in bits
+ */
+- (void)setPackedSequences:(const uint32_t * _Nonnull)bits wordsPerTrack:(NSInteger)wordsPerTrack
+                 fromTrack:(NSInteger)firstTrack count:(NSInteger)count;
+
+/**
+ *  Replace the whole pattern. numTracks and numSteps are updated and the sequences of all tracks are set at once.
+ *
+ *  @param bits          packed sequences(see setPackedSequences:) of numTracks tracks
+ *  @param wordsPerTrack number of words per track
+ *  @param numTracks     number of tracks(up to 256)
+ *  @param numSteps      number of steps(up to 256)
+ */
+- (void)importPackedPattern:(const uint32_t * _Nonnull)bits wordsPerTrack:(NSInteger)wordsPerTrack
+                  numTracks:(NSInteger)numTracks numSteps:(NSInteger)numSteps;
+
+/**
+ *  Set the velocity, probability and delay of each step of the specified track.
+ *  Each array has numSteps values. nil keeps the current values.
+ *
+ *  @param velocities    0.0…1.0(default) of the amplifier gain
+ *  @param probabilities 0.0(never)…1.0(always, default) chance that the note is ON
+ *  @param delays        0.0(default)…1.0(exclusive) of a step to delay the note
+ *  @param trackNo       track number
+ */
+- (void)setStepVelocities:(NSArray<NSNumber *>* _Nullable)velocities
+            probabilities:(NSArray<NSNumber *>* _Nullable)probabilities
+                   delays:(NSArray<NSNumber *>* _Nullable)delays ofTrack:(NSInteger)trackNo;
+
+/**
+ *  Set the pitch of each step of the specified track, on top of its transpose.
+ *
+ *  @param pitches -48…0(default)…48 semitones. numSteps values
+ *  @param trackNo track number
+ */
+- (void)setStepPitches:(NSArray<NSNumber *>*)pitches ofTrack:(NSInteger)trackNo;
+
+/**
+ *  Seed of the probabilities. The same seed plays the same notes in every run.
+ */
+@property (nonatomic, assign) uint32_t randomSeed;
+
 /**
  *  Erase all individual status of the specified track
  *
@@ -73,6 +246,128 @@
  */
 - (void)setPanPosition:(double)position ofTrack:(NSInteger)trackNo;
 
+/**
+ *  Set the pitch of the specified track. It is applied to the sound playing as well.
+ *
+ *  @param semitones -48…0(original)…48 semitones
+ *  @param cents     -100…0…100 cents
+ *  @param trackNo   track number
+ */
+- (void)setTranspose:(NSInteger)semitones tune:(NSInteger)cents ofTrack:(NSInteger)trackNo;
+
+/**
+ *  Get the output level of the specified track. It is cheap enough to be polled at display rate.
+ *
+ *  @param trackNo track number
+ *
+ *  @return peak & rms level. zero if the track does not exist.
+ */
+- (AudioEngineLevel)levelOfTrack:(NSInteger)trackNo;
+
+/**
+ *  Get the analysis of the sound of the specified track. For example, setAmpGain(1.0 / peak) normalizes the peak.
+ *
+ *  @param trackNo track number
+ *
+ *  @return duration, peak & loudness. zero if the track does not exist.
+ */
+- (AudioEngineSampleInfo)sampleInfoOfTrack:(NSInteger)trackNo;
+
+/**
+ *  Output level of the master(sum of all tracks)
+ */
+@property (nonatomic, readonly) AudioEngineLevel masterLevel;
+
+/**
+ *  Telemetry of the render path. It can be read from any thread without disturbing the audio thread.
+ */
+@property (nonatomic, readonly) AudioEnginePerformance* _Nonnull performance;
+
+/**
+ *  Reset the telemetry. It takes effect at the next render callback.
+ */
+- (void)resetPerformance;
+
+/**
+ *  Start recording every command, pattern edit, parameter change and render callback
+ *  into a preallocated buffer. The trace can be replayed offline deterministically.
+ */
+- (void)startTraceRecording;
+
+/**
+ *  Stop recording and write the trace to the specified file.
+ *
+ *  @param path file path to write
+ *
+ *  @return YES if succeeded
+ */
+- (BOOL)stopTraceRecordingToFile:(NSString * _Nonnull)path;
+
+/**
+ *  Render the stems of a recorded trace offline and write them to WAV files(16bit stereo).
+ *  All the stems are rendered in a single pass and the files are written concurrently.
+ *
+ *  @param tracePath trace file written by stopTraceRecordingToFile:
+ *  @param paths     WAV file of each bus(64 at most)
+ *  @param buses     bus(index of paths) of each track. -1 leaves the track out. the others go to bus 0
+ *
+ *  @return YES if succeeded
+ */
+- (BOOL)exportStemsOfTrace:(NSString * _Nonnull)tracePath
+                   toFiles:(NSArray<NSString *> * _Nonnull)paths
+               busOfTracks:(NSArray<NSNumber *> * _Nonnull)buses;
+
+/**
+ *  Receive a tick of an external clock(24 per beat, as MIDI clock).
+ *  While the ticks keep coming, the tempo and the position of the sequencer follow them
+ *  sample-accurately and the tempo property is ignored. The jitter of the ticks is filtered.
+ *
+ *  @param hostTime mach_absolute_time at which the tick is heard. The sequencer is heard with it.
+ */
+- (void)receiveClockTickAtTime:(uint64_t)hostTime;
+
+/**
+ *  Receive a beat(24 ticks) of an external clock. See receiveClockTickAtTime:
+ */
+- (void)receiveClockBeatAtTime:(uint64_t)hostTime;
+
+/**
+ *  Receive the start of an external clock. The next tick is the first step of the sequence.
+ */
+- (void)receiveClockStartAtTime:(uint64_t)hostTime;
+
+/**
+ *  Bandwidth of the jitter filter in Hz(default 1.0). Lower filters more jitter, higher follows tempo changes faster.
+ */
+@property (nonatomic, assign) double clockBandwidth;
+
+/**
+ *  Receive the clock on a local UDP port(127.0.0.1) as a stand-in for a MIDI clock input.
+ *  Each datagram is a byte(0xF8 : tick, 0xF9 : beat, 0xFA : start), optionally followed by
+ *  the host time at which it is heard(8 bytes, little-endian). Otherwise it is timestamped when it arrives.
+ *
+ *  @param port UDP port. 0 chooses a free port(clockReceiverPort)
+ *
+ *  @return YES if succeeded
+ */
+- (BOOL)startClockReceiverOnPort:(NSInteger)port;
+- (void)stopClockReceiver;
+
+/**
+ *  UDP port receiving the clock. 0 if not receiving
+ */
+@property (nonatomic, readonly) NSInteger clockReceiverPort;
+
+/**
+ *  State of the sync to the external clock : tempo, jitter, sync error and latency
+ */
+@property (nonatomic, readonly) AudioEngineClockSync clockSync;
+
+/**
+ *  Reset the statistics of clockSync. It takes effect at the next render callback.
+ */
+- (void)resetClockSync;
+
 /**
  *  Start a sequencer
  */
@@ -6,56 +6,112 @@
 //
 
 #include <string>
+#include <algorithm>
 #include <mutex>
+#include <atomic>
 
 #import <mach/mach_time.h>
 
 #import "AudioIO.h"
 #import "Sequencer.h"
 #import "DrumOscillator.h"
+#import "LevelMeter.h"
+#import "LoopCache.h"
 #import "Synthesizer.h"
+#import "TraceRecorder.h"
+#import "TraceReplayer.h"
+#import "StemWriter.h"
+#import "ClockSync.h"
+#import "ClockReceiver.h"
+#import "BundleSampleLoader.h"
+#import "TriggerQueue.h"
 
 #import "AudioEngineIF.h"
 
+//  the triggers are queued on the audio thread and delivered to the delegate
+//  from the main queue, so the audio thread neither allocates nor dispatches
 class SequencerConnector : public SequencerListener {
-    AudioEngineIF *receiver_;
     AudioIO *io_;
-    BOOL respondableToSelector_;
+    TriggerQueue queue_;
+    std::atomic<bool> respondableToSelector_;   //  updated when the delegate is set
 public:
-    SequencerConnector(AudioEngineIF *receiver, AudioIO *io) :
-    receiver_(receiver), io_(io), respondableToSelector_(NO) {}
+    SequencerConnector(AudioIO *io, const int maxNumberOfTracks) :
+    io_(io), queue_(maxNumberOfTracks), respondableToSelector_(false) {}
 
-    void    NoteOnViaSequencer(int offset, const std::vector<int> &parts, int step) {
+    void    SetRespondable(const bool respondable) {
+        respondableToSelector_.store(respondable, std::memory_order_release);
+    }
+    bool    PopTrigger(uint64_t &hostTime, int &step, std::vector<int> &tracks) {
+        return queue_.Pop(hostTime, step, tracks);
+    }
 
-        uint64_t triggeredTime = io_->GetHostTime() + offset;
-        if (respondableToSelector_ == NO) {
-            respondableToSelector_ = [receiver_.delegate respondsToSelector:@selector(audioEngine:willTriggerTracks:step:atTime:)];
+    void    NoteOnViaSequencer(int offset, const std::vector<int> &parts, const std::vector<int32_t> &/*velocities*/,
+                               const std::vector<int32_t> &/*pitches*/, int step) {
+        //  nothing to do on the audio thread without a delegate
+        if (!respondableToSelector_.load(std::memory_order_acquire)) {
+            return;
         }
-        if (respondableToSelector_) {
-            NSMutableArray<NSNumber *>* tracks = [@[] mutableCopy];
-            for (auto partNo : parts) {
-                [tracks addObject:[NSNumber numberWithInt:partNo]];
-            }
+        queue_.Push(io_->GetHostTime() + offset, step, parts);
+    }
+};
 
-            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                [receiver_.delegate audioEngine:receiver_
-                              willTriggerTracks:tracks
-                                           step:step
-                                         atTime:triggeredTime];
-            });
+//  the delegate is told of the triggers at this interval. they are heard
+//  later by the output latency
+static const uint64_t kTriggerDeliveryInterval = 5 * NSEC_PER_MSEC;
+
+@interface AudioEnginePerformance ()
+- (instancetype)initWithSnapshot:(const PerformanceMonitor::Snapshot &)snapshot
+                         cpuLoad:(float)cpuLoad
+                      maxCPULoad:(float)maxCPULoad;
+@end
+
+@implementation AudioEnginePerformance
+
+- (instancetype)initWithSnapshot:(const PerformanceMonitor::Snapshot &)snapshot
+                         cpuLoad:(float)cpuLoad
+                      maxCPULoad:(float)maxCPULoad
+{
+    self = [super init];
+    if (self != nil)
+    {
+        _numberOfCallbacks = snapshot.numberOfCallbacks;
+        _numberOfDeadlineMisses = snapshot.numberOfDeadlineMisses;
+        NSMutableArray<NSNumber *>* histogram = [NSMutableArray arrayWithCapacity:PerformanceMonitor::kNumberOfHistogramBins];
+        for (int bin = 0; bin < PerformanceMonitor::kNumberOfHistogramBins; ++bin) {
+            [histogram addObject:@(snapshot.callbackHistogram[bin])];
         }
+        _callbackHistogram = [histogram copy];
+        _lastCallbackDuration = snapshot.lastCallbackNanosec / (double)NSEC_PER_SEC;
+        _maxCallbackDuration = snapshot.maxCallbackNanosec / (double)NSEC_PER_SEC;
+        _averageCallbackDuration = (snapshot.numberOfCallbacks > 0) ?
+            snapshot.totalCallbackNanosec / (double)NSEC_PER_SEC / snapshot.numberOfCallbacks : 0.0;
+        _sequencerTime = snapshot.sequencerNanosec / (double)NSEC_PER_SEC;
+        _renderTime = snapshot.renderNanosec / (double)NSEC_PER_SEC;
+        _numberOfEvents = snapshot.numberOfEvents;
+        _activeVoices = snapshot.activeVoices;
+        _maxActiveVoices = snapshot.maxActiveVoices;
+        _cpuLoad = cpuLoad;
+        _maxCPULoad = maxCPULoad;
     }
-};
+    return self;
+}
+
+@end
 
 static inline uint64_t now() {
     return mach_absolute_time();
 }
 
 @interface AudioEngineIF ()
+@property (nonatomic) BundleSampleLoader* sampleLoader;
 @property (nonatomic) Synthesizer*        synth;
 @property (nonatomic) AudioIO*            audioIo;
 @property (nonatomic) SequencerConnector* connector;
+@property (nonatomic) dispatch_source_t   triggerTimer;
 @property (nonatomic) Sequencer*          sequencer;
+@property (nonatomic) TraceRecorder*      traceRecorder;
+@property (nonatomic) ClockSync*          clockSyncer;
+@property (nonatomic) ClockReceiver*      clockReceiver;
 
 @property (nonatomic, readwrite) float    frequency;
 @property (nonatomic) NSInteger           stepsPerBeat;
@@ -82,16 +138,21 @@ static inline uint64_t now() {
         _stepsPerBeat = stepsPerBeat;
 
         _audioIo = new AudioIO(_frequency);
-        _synth = new Synthesizer(_frequency);
+        _sampleLoader = new BundleSampleLoader();
+        _synth = new Synthesizer(_frequency, _sampleLoader);
         _sequencer = new Sequencer(_frequency,
                                    numTracks/*tracks*/,
                                    (int)_numSteps/*steps*/,
                                    (int)_stepsPerBeat/*stepsPerBeat*/);
 
+        _clockSyncer = new ClockSync(_frequency);
+        _clockReceiver = new ClockReceiver(*_clockSyncer);
+        _sequencer->SetClockSync(_clockSyncer);
+
         _audioIo->SetListener(_synth);
         _synth->SetSequencer(_sequencer);
 
-        _connector = new SequencerConnector(self, _audioIo);
+        _connector = new SequencerConnector(_audioIo, std::max(numTracks, (int)Sequencer::kMaxNumberOfTracks));
         _sequencer->AddListener(_connector);
 
         _audioIo->Open();
@@ -105,14 +166,26 @@ static inline uint64_t now() {
 //  ---------------------------------------------------------------------------
 - (void)dealloc
 {
+    if (_triggerTimer != nil)
+    {
+        dispatch_source_cancel(_triggerTimer);
+        _triggerTimer = nil;
+    }
     delete _audioIo;
     _audioIo = nullptr;
-    delete _synth;
+    delete _synth;      //  deletes the sequencer too
     _synth = nullptr;
-    delete _sequencer;
     _sequencer = nullptr;
+    delete _sampleLoader;
+    _sampleLoader = nullptr;
     delete _connector;
     _connector = nullptr;
+    delete _traceRecorder;
+    _traceRecorder = nullptr;
+    delete _clockReceiver;
+    _clockReceiver = nullptr;
+    delete _clockSyncer;
+    _clockSyncer = nullptr;
 }
 
 #pragma mark -
@@ -130,7 +203,236 @@ static inline uint64_t now() {
     return result;  //  nanosec
 }
 
+//  ---------------------------------------------------------------------------
+//      levelOfTrack:
+//  ---------------------------------------------------------------------------
+- (AudioEngineLevel)levelOfTrack:(NSInteger)trackNo
+{
+    AudioEngineLevel result = { 0.0f, 0.0f };
+    LevelMeter::Level level;
+    if (_synth != nullptr && _synth->GetTrackLevel(static_cast<int>(trackNo), level))
+    {
+        result.peak = level.peak;
+        result.rms = level.rms;
+    }
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      sampleInfoOfTrack:
+//  ---------------------------------------------------------------------------
+- (AudioEngineSampleInfo)sampleInfoOfTrack:(NSInteger)trackNo
+{
+    AudioEngineSampleInfo result = { 0.0, 0.0, 0.0f, 0.0f };
+    DrumOscillator::SampleInfo info;
+    if (_synth != nullptr && _synth->GetSampleInfo(static_cast<int>(trackNo), info) && info.samplingRate > 0.0f)
+    {
+        result.duration = info.numberOfFrames / info.samplingRate;
+        result.trimmedDuration = info.trimmedFrames / info.samplingRate;
+        result.peak = static_cast<float>(info.peak) / 0x7FFF;
+        result.loudness = static_cast<float>(info.loudness) / 0x7FFF;
+    }
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      masterLevel
+//  ---------------------------------------------------------------------------
+- (AudioEngineLevel)masterLevel
+{
+    AudioEngineLevel result = { 0.0f, 0.0f };
+    if (_synth != nullptr)
+    {
+        LevelMeter::Level level;
+        _synth->GetMasterLevel(level);
+        result.peak = level.peak;
+        result.rms = level.rms;
+    }
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      performance
+//  ---------------------------------------------------------------------------
+- (AudioEnginePerformance *)performance
+{
+    PerformanceMonitor::Snapshot snapshot = {};
+    float cpuLoad = 0.0f, maxCPULoad = 0.0f;
+    if (_audioIo != nullptr)
+    {
+        _audioIo->GetPerformanceMonitor().GetSnapshot(snapshot);
+        cpuLoad = _audioIo->GetCPULoad();
+        maxCPULoad = _audioIo->GetMaxCPULoad();
+    }
+    return [[AudioEnginePerformance alloc] initWithSnapshot:snapshot
+                                                    cpuLoad:cpuLoad
+                                                 maxCPULoad:maxCPULoad];
+}
+
+//  ---------------------------------------------------------------------------
+//      resetPerformance
+//  ---------------------------------------------------------------------------
+- (void)resetPerformance
+{
+    if (_audioIo != nullptr)
+    {
+        _audioIo->GetPerformanceMonitor().Reset();
+    }
+}
+
 #pragma mark public property & methods
+//  ---------------------------------------------------------------------------
+//      setDelegate:
+//  ---------------------------------------------------------------------------
+- (void)setDelegate:(id<AudioEngineIFProtocol>)delegate
+{
+    _delegate = delegate;
+    const BOOL respondable = [delegate respondsToSelector:@selector(audioEngine:willTriggerTracks:step:atTime:)];
+    if (respondable && (_triggerTimer == nil))
+    {
+        __weak AudioEngineIF *weakSelf = self;
+        _triggerTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+        dispatch_source_set_timer(_triggerTimer, DISPATCH_TIME_NOW, kTriggerDeliveryInterval, NSEC_PER_MSEC);
+        dispatch_source_set_event_handler(_triggerTimer, ^{
+            [weakSelf deliverTriggers];
+        });
+        dispatch_resume(_triggerTimer);
+    }
+    else if (!respondable && (_triggerTimer != nil))
+    {
+        dispatch_source_cancel(_triggerTimer);
+        _triggerTimer = nil;
+    }
+    if (_connector != nullptr)
+    {
+        _connector->SetRespondable(respondable);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      deliverTriggers                                         [main queue]
+//  ---------------------------------------------------------------------------
+- (void)deliverTriggers
+{
+    if (_connector == nullptr)
+    {
+        return;
+    }
+    id<AudioEngineIFProtocol> delegate = self.delegate;
+    uint64_t hostTime = 0;
+    int step = 0;
+    std::vector<int> tracks;
+    while (_connector->PopTrigger(hostTime, step, tracks))
+    {
+        NSMutableArray<NSNumber *>* trackNumbers = [NSMutableArray arrayWithCapacity:tracks.size()];
+        for (auto trackNo : tracks)
+        {
+            [trackNumbers addObject:[NSNumber numberWithInt:trackNo]];
+        }
+        [delegate audioEngine:self willTriggerTracks:trackNumbers step:step atTime:hostTime];
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      preferredBufferSize
+//  ---------------------------------------------------------------------------
+- (NSInteger)preferredBufferSize
+{
+    if (_audioIo != nullptr)
+    {
+        return _audioIo->GetPreferredBufferSize();
+    }
+    return 0;
+}
+- (void)setPreferredBufferSize:(NSInteger)preferredBufferSize
+{
+    if (_audioIo != nullptr && preferredBufferSize > 0)
+    {
+        _audioIo->SetPreferredBufferSize(static_cast<uint32_t>(preferredBufferSize));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      bufferSize
+//  ---------------------------------------------------------------------------
+- (NSInteger)bufferSize
+{
+    if (_audioIo != nullptr)
+    {
+        return _audioIo->GetBufferSize();
+    }
+    return 0;
+}
+
+//  ---------------------------------------------------------------------------
+//      playbackLatency
+//  ---------------------------------------------------------------------------
+- (NSTimeInterval)playbackLatency
+{
+    if (_audioIo != nullptr)
+    {
+        return _audioIo->GetPlaybackLatency() / (double)NSEC_PER_SEC;
+    }
+    return 0.0;
+}
+
+//  ---------------------------------------------------------------------------
+//      loopCacheEnabled
+//  ---------------------------------------------------------------------------
+- (BOOL)loopCacheEnabled
+{
+    if (_synth != nullptr)
+    {
+        return _synth->IsLoopCacheEnabled();
+    }
+    return NO;
+}
+- (void)setLoopCacheEnabled:(BOOL)loopCacheEnabled
+{
+    if (_synth != nullptr)
+    {
+        _synth->SetLoopCacheEnabled(loopCacheEnabled);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      silenceThreshold
+//  ---------------------------------------------------------------------------
+- (double)silenceThreshold
+{
+    if (_synth != nullptr)
+    {
+        return static_cast<double>(_synth->GetSilenceLevel()) / 0x7FFF;
+    }
+    return 0.0;
+}
+- (void)setSilenceThreshold:(double)silenceThreshold
+{
+    if (_synth != nullptr && silenceThreshold >= 0.0 && silenceThreshold <= 1.0)
+    {
+        _synth->SetSilenceLevel(static_cast<int32_t>(silenceThreshold * 0x7FFF));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      releaseThreshold
+//  ---------------------------------------------------------------------------
+- (double)releaseThreshold
+{
+    if (_synth != nullptr)
+    {
+        return static_cast<double>(_synth->GetReleaseLevel()) / 0x7FFF;
+    }
+    return 0.0;
+}
+- (void)setReleaseThreshold:(double)releaseThreshold
+{
+    if (_synth != nullptr && releaseThreshold >= 0.0 && releaseThreshold <= 1.0)
+    {
+        _synth->SetReleaseLevel(static_cast<int32_t>(releaseThreshold * 0x7FFF));
+    }
+}
+
 //  ---------------------------------------------------------------------------
 //      setTempo
 //  ---------------------------------------------------------------------------
@@ -155,19 +457,9 @@ static inline uint64_t now() {
 }
 - (void)setNumTracks:(NSInteger)numTracks
 {
-    if (_synth != nullptr) {
-        _synth->StopSequence(now());
-
-        if (_sequencer != nullptr) {
-            delete _sequencer;
-        }
-        _sequencer = new Sequencer(_frequency,
-                                   (int)numTracks/*tracks*/,
-                                   (int)_numSteps/*steps*/,
-                                   (int)_stepsPerBeat/*stepsPerBeat*/);
-        _synth->SetSequencer(_sequencer);
-        _sequencer->AddListener(_connector);
-
+    //  applied at a block boundary. the playback and the patterns of the remaining tracks are kept
+    if (_sequencer != nullptr && numTracks >= 0 && numTracks <= _sequencer->GetMaxNumTracks()) {
+        _sequencer->UpdateNumTracks(now(), static_cast<int>(numTracks));
     }
 }
 
@@ -176,6 +468,9 @@ static inline uint64_t now() {
 //  ---------------------------------------------------------------------------
 - (void)setNumSteps:(NSInteger)numSteps
 {
+    if (numSteps <= 0 || numSteps > Sequencer::kMaxNumberOfSteps) {
+        return;
+    }
     _numSteps = numSteps;
     if (_sequencer != nullptr) {
         _sequencer->UpdateNumSteps(now(), static_cast<int>(_numSteps));
@@ -204,14 +499,102 @@ static inline uint64_t now() {
 //  ---------------------------------------------------------------------------
 - (void)setStepSequence:(NSArray<NSNumber *> *)sequence ofTrack:(NSInteger)trackNo
 {
-    if (_synth != nullptr) {
-        if (sequence.count == (NSUInteger)_numSteps) {
-            std::vector<bool> seq;
+    if (_sequencer != nullptr) {
+        if (sequence.count == (NSUInteger)_numSteps && _numSteps <= Sequencer::kMaxNumberOfSteps) {
+            uint32_t bits[Sequencer::kWordsPerTrack] = {};
+            NSUInteger step = 0;
             for (NSNumber *stepObj in sequence) {
-                seq.push_back(stepObj.boolValue);
+                bits[step / 32] |= (stepObj.boolValue ? 1u : 0u) << (step % 32);
+                ++step;
             }
-            _sequencer->UpdateTrack(static_cast<int>(trackNo), seq);
+            _sequencer->UpdateTracks(static_cast<int>(trackNo), 1, bits, Sequencer::kWordsPerTrack);
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      setPackedSequences:wordsPerTrack:fromTrack:count:
+//  ---------------------------------------------------------------------------
+- (void)setPackedSequences:(const uint32_t *)bits wordsPerTrack:(NSInteger)wordsPerTrack
+                 fromTrack:(NSInteger)firstTrack count:(NSInteger)count
+{
+    if (_sequencer != nullptr && bits != NULL && wordsPerTrack > 0) {
+        _sequencer->UpdateTracks(static_cast<int>(firstTrack), static_cast<int>(count),
+                                 bits, static_cast<int>(wordsPerTrack));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      importPackedPattern:wordsPerTrack:numTracks:numSteps:
+//  ---------------------------------------------------------------------------
+- (void)importPackedPattern:(const uint32_t *)bits wordsPerTrack:(NSInteger)wordsPerTrack
+                  numTracks:(NSInteger)numTracks numSteps:(NSInteger)numSteps
+{
+    if (_sequencer != nullptr && bits != NULL && wordsPerTrack > 0 &&
+        numTracks >= 0 && numTracks <= _sequencer->GetMaxNumTracks() &&
+        numSteps > 0 && numSteps <= Sequencer::kMaxNumberOfSteps) {
+        //  the numbers of tracks and steps are taken with the patterns in the same callback
+        _numSteps = numSteps;
+        _sequencer->ImportPatterns(static_cast<int>(numTracks), static_cast<int>(numSteps),
+                                   bits, static_cast<int>(wordsPerTrack));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      setStepVelocities:probabilities:delays:ofTrack:
+//  ---------------------------------------------------------------------------
+- (void)setStepVelocities:(NSArray<NSNumber *> *)velocities
+            probabilities:(NSArray<NSNumber *> *)probabilities
+                   delays:(NSArray<NSNumber *> *)delays ofTrack:(NSInteger)trackNo
+{
+    if (_sequencer != nullptr && _numSteps <= Sequencer::kMaxNumberOfSteps) {
+        if ((velocities != nil && velocities.count != (NSUInteger)_numSteps) ||
+            (probabilities != nil && probabilities.count != (NSUInteger)_numSteps) ||
+            (delays != nil && delays.count != (NSUInteger)_numSteps)) {
+            return;
         }
+        uint16_t velocityLane[Sequencer::kMaxNumberOfSteps];
+        uint16_t probabilityLane[Sequencer::kMaxNumberOfSteps];
+        uint8_t delayLane[Sequencer::kMaxNumberOfSteps];
+        for (NSInteger step = 0; step < _numSteps; ++step) {
+            //  out of range values are clipped by the sequencer
+            velocityLane[step] = std::min(std::max(velocities[step].doubleValue, 0.0), 1.0) * Sequencer::kVelocityUnity;
+            probabilityLane[step] = std::min(std::max(probabilities[step].doubleValue, 0.0), 1.0) * Sequencer::kProbabilityAlways;
+            delayLane[step] = std::min(std::max(delays[step].doubleValue * Sequencer::kDelayResolution, 0.0),
+                                       Sequencer::kDelayResolution - 1.0);
+        }
+        _sequencer->UpdateStepLanes(static_cast<int>(trackNo), 1,
+                                    (velocities != nil) ? velocityLane : NULL,
+                                    (probabilities != nil) ? probabilityLane : NULL,
+                                    (delays != nil) ? delayLane : NULL,
+                                    NULL, static_cast<int>(_numSteps));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      setStepPitches:ofTrack:
+//  ---------------------------------------------------------------------------
+- (void)setStepPitches:(NSArray<NSNumber *> *)pitches ofTrack:(NSInteger)trackNo
+{
+    if (_sequencer != nullptr && _numSteps <= Sequencer::kMaxNumberOfSteps && pitches.count == (NSUInteger)_numSteps) {
+        int8_t pitchLane[Sequencer::kMaxNumberOfSteps];
+        for (NSInteger step = 0; step < _numSteps; ++step) {
+            const NSInteger pitch = pitches[step].integerValue;
+            pitchLane[step] = std::min<NSInteger>(std::max<NSInteger>(pitch, -Sequencer::kMaxPitch), Sequencer::kMaxPitch);
+        }
+        _sequencer->UpdateStepLanes(static_cast<int>(trackNo), 1, NULL, NULL, NULL, pitchLane,
+                                    static_cast<int>(_numSteps));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      setRandomSeed
+//  ---------------------------------------------------------------------------
+- (void)setRandomSeed:(uint32_t)randomSeed
+{
+    _randomSeed = randomSeed;
+    if (_sequencer != nullptr) {
+        _sequencer->SetRandomSeed(randomSeed);
     }
 }
 
@@ -220,12 +603,9 @@ static inline uint64_t now() {
 //  ---------------------------------------------------------------------------
 - (void)clearSequence:(NSInteger)trackNo
 {
-    if (_synth != nullptr) {
-        std::vector<bool> seq;
-        for (int i=0; i<_numSteps; ++i) {
-            seq.push_back(false);
-        }
-        _sequencer->UpdateTrack(static_cast<int>(trackNo), seq);
+    if (_sequencer != nullptr) {
+        const uint32_t bits[Sequencer::kWordsPerTrack] = {};
+        _sequencer->UpdateTracks(static_cast<int>(trackNo), 1, bits, Sequencer::kWordsPerTrack);
     }
 }
 
@@ -255,6 +635,209 @@ static inline uint64_t now() {
     }
 }
 
+//  ---------------------------------------------------------------------------
+//      setTranspose:tune:ofTrack:
+//  ---------------------------------------------------------------------------
+- (void)setTranspose:(NSInteger)semitones tune:(NSInteger)cents ofTrack:(NSInteger)trackNo
+{
+    if (_synth != nullptr) {
+        if (semitones >= -DrumOscillator::kMaxTranspose && semitones <= DrumOscillator::kMaxTranspose &&
+            cents >= -DrumOscillator::kMaxTune && cents <= DrumOscillator::kMaxTune) {
+            _synth->SetTranspose(static_cast<int>(trackNo), static_cast<int32_t>(semitones));
+            _synth->SetTune(static_cast<int>(trackNo), static_cast<int32_t>(cents));
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      startTraceRecording
+//  ---------------------------------------------------------------------------
+- (void)startTraceRecording
+{
+    if (_synth != nullptr)
+    {
+        if (_traceRecorder == nullptr)
+        {
+            static const size_t kTraceCapacity = 1 << 18;   //  records(6MB)
+            _traceRecorder = new TraceRecorder(kTraceCapacity);
+            _synth->SetTraceRecorder(_traceRecorder);
+        }
+        _traceRecorder->Start(_frequency, static_cast<int>(self.numTracks), static_cast<int>(_numSteps),
+                              static_cast<int>(_stepsPerBeat), _synth->GetSoundSet());
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      stopTraceRecordingToFile:
+//  ---------------------------------------------------------------------------
+- (BOOL)stopTraceRecordingToFile:(NSString *)path
+{
+    if (_traceRecorder == nullptr)
+    {
+        return NO;
+    }
+    std::string path_cstr([path fileSystemRepresentation]);
+    return _traceRecorder->WriteToFile(path_cstr) ? YES : NO;
+}
+
+//  ---------------------------------------------------------------------------
+//      exportStemsOfTrace:toFiles:busOfTracks:
+//  ---------------------------------------------------------------------------
+- (BOOL)exportStemsOfTrace:(NSString *)tracePath
+                   toFiles:(NSArray<NSString *> *)paths
+               busOfTracks:(NSArray<NSNumber *> *)buses
+{
+    TraceReplayer replayer(_sampleLoader);
+    if (paths.count == 0 || paths.count > Synthesizer::kMaxNumberOfBuses ||
+        !replayer.Load(std::string([tracePath fileSystemRepresentation]))) {
+        return NO;
+    }
+    std::vector<std::string> files;
+    for (NSString *path in paths) {
+        files.push_back(std::string([path fileSystemRepresentation]));
+    }
+    std::vector<int> trackBuses;
+    for (NSNumber *bus in buses) {
+        trackBuses.push_back(bus.intValue);
+    }
+
+    StemWriter writer;
+    if (!writer.Open(files, static_cast<uint32_t>(replayer.GetHeader().samplingRate))) {
+        return NO;
+    }
+    bool result = replayer.ReplayStems(trackBuses, static_cast<int>(files.size()),
+                                       [&writer](int16_t** buffer, const uint32_t length) {
+        writer.Write(buffer, length);
+    });
+    result = writer.Close() && result;
+    return result ? YES : NO;
+}
+
+#pragma mark external clock
+//  ---------------------------------------------------------------------------
+//      receiveClockTickAtTime:
+//  ---------------------------------------------------------------------------
+- (void)receiveClockTickAtTime:(uint64_t)hostTime
+{
+    if (_clockSyncer != nullptr)
+    {
+        _clockSyncer->Receive(ClockSync::kClockMessage_Tick, hostTime);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      receiveClockBeatAtTime:
+//  ---------------------------------------------------------------------------
+- (void)receiveClockBeatAtTime:(uint64_t)hostTime
+{
+    if (_clockSyncer != nullptr)
+    {
+        _clockSyncer->Receive(ClockSync::kClockMessage_Beat, hostTime);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      receiveClockStartAtTime:
+//  ---------------------------------------------------------------------------
+- (void)receiveClockStartAtTime:(uint64_t)hostTime
+{
+    if (_clockSyncer != nullptr)
+    {
+        _clockSyncer->Receive(ClockSync::kClockMessage_Start, hostTime);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      clockBandwidth
+//  ---------------------------------------------------------------------------
+- (double)clockBandwidth
+{
+    if (_clockSyncer != nullptr)
+    {
+        return _clockSyncer->GetBandwidth();
+    }
+    return 0.0;
+}
+- (void)setClockBandwidth:(double)clockBandwidth
+{
+    if (_clockSyncer != nullptr && clockBandwidth > 0.0)
+    {
+        _clockSyncer->SetBandwidth(static_cast<float>(clockBandwidth));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      startClockReceiverOnPort:
+//  ---------------------------------------------------------------------------
+- (BOOL)startClockReceiverOnPort:(NSInteger)port
+{
+    if (_clockReceiver == nullptr || port < 0 || port > 0xFFFF)
+    {
+        return NO;
+    }
+    return _clockReceiver->Start(static_cast<uint16_t>(port)) ? YES : NO;
+}
+
+//  ---------------------------------------------------------------------------
+//      stopClockReceiver
+//  ---------------------------------------------------------------------------
+- (void)stopClockReceiver
+{
+    if (_clockReceiver != nullptr)
+    {
+        _clockReceiver->Stop();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      clockReceiverPort
+//  ---------------------------------------------------------------------------
+- (NSInteger)clockReceiverPort
+{
+    if (_clockReceiver != nullptr)
+    {
+        return _clockReceiver->GetPort();
+    }
+    return 0;
+}
+
+//  ---------------------------------------------------------------------------
+//      clockSync
+//  ---------------------------------------------------------------------------
+- (AudioEngineClockSync)clockSync
+{
+    AudioEngineClockSync result = {};
+    if (_clockSyncer != nullptr)
+    {
+        ClockSync::Report report;
+        _clockSyncer->GetReport(report);
+        result.isLocked = report.isLocked ? YES : NO;
+        result.tempo = report.tempo;
+        result.numberOfTicks = report.numberOfTicks;
+        result.numberOfMissedTicks = report.numberOfMissedTicks;
+        result.numberOfRelocations = report.numberOfRelocations;
+        result.jitter = report.jitterRms;
+        result.maxJitter = report.jitterMax;
+        result.syncError = report.errorRms;
+        result.maxSyncError = report.errorMax;
+        result.latency = report.latency;
+        result.tickDelay = report.tickDelay;
+    }
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      resetClockSync
+//  ---------------------------------------------------------------------------
+- (void)resetClockSync
+{
+    if (_clockSyncer != nullptr)
+    {
+        _clockSyncer->ResetReport();
+    }
+}
+
+#pragma mark -
 //  ---------------------------------------------------------------------------
 //      start
 //  ---------------------------------------------------------------------------
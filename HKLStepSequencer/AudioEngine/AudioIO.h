@@ -9,16 +9,10 @@
 #pragma once
 #include <AudioToolbox/AudioToolbox.h>
 #include <vector>
+#include "PerformanceMonitor.h"
+#include "RenderContext.h"
 
-class AudioIOListener
-{
-public:
-    virtual ~AudioIOListener(void)    {}
-    virtual void ProcessReplacing(class AudioIO* io, int16_t** buffer, const uint32_t length) = 0;
-};
-
-
-class AudioIO
+class AudioIO : public RenderContext
 {
 public:
     AudioIO(float samplingRate);
@@ -34,10 +28,20 @@ public:
     uint64_t    GetHostTime(void) const     { return hostTime_; }
     uint64_t    GetLatency(void) const      { return latency_; }
 
+    /* requested I/O buffer size in frames. the hardware may choose another size */
+    void        SetPreferredBufferSize(const uint32_t frames);
+    uint32_t    GetPreferredBufferSize(void) const  { return ioBufferSize_; }
+    uint32_t    GetBufferSize(void) const           { return actualBufferSize_; }
+    /* nanosec from rendering a frame to hearing it : I/O buffer + hardware output latency */
+    uint64_t    GetPlaybackLatency(void) const      { return playbackLatency_; }
+
     void    SetListener(AudioIOListener* listener);
+    /* renders interleaved frames through the render callback without the hardware(tests) */
+    void    RenderOffline(int16_t* interleaved, const uint32_t frames, const uint64_t hostTime);
     
     Float32 GetCPULoad(void) const;
     Float32 GetMaxCPULoad(void) const;
+    PerformanceMonitor& GetPerformanceMonitor(void)     { return monitor_; }
 
     static void InterruptionCallback(void* inClientData, UInt32 inInterruptionState);
     static void AudioRouteChangeCallback(void* inClientData, AudioSessionPropertyID inID, UInt32 inDataSize, const void* inData);
@@ -69,6 +73,11 @@ private:
     std::vector<int16_t*>   outputBuffer_;
     uint64_t    hostTime_;
     uint64_t    latency_;
+    uint32_t    actualBufferSize_;
+    uint64_t    playbackLatency_;
+    uint32_t    timebaseNumer_;     //  HostClock::GetTimebase, cached
+    uint32_t    timebaseDenom_;
+    PerformanceMonitor  monitor_;
 
     void *receiver;
 };
@@ -6,8 +6,9 @@
 //  Copyright 2011 KORG INC. All rights reserved.
 //
 
-#include <mach/mach_time.h>
+#include <algorithm>
 #include "AudioIO.h"
+#include "HostClock.h"
 #include <Foundation/Foundation.h>
 #include <AVFoundation/AVFoundation.h>
 
@@ -82,8 +83,15 @@ isRunning_(false),
 dataBuffer_(),
 outputBuffer_(),
 hostTime_(0),
-latency_(0)
+latency_(0),
+actualBufferSize_(0),
+playbackLatency_(0),
+timebaseNumer_(1),
+timebaseDenom_(1),
+monitor_()
 {
+    HostClock::GetTimebase(timebaseNumer_, timebaseDenom_);
+
     dataBuffer_.assign(bufferLength_ * numberOfOutputBus_, 0);
     outputBuffer_.clear();
     for (uint32_t ch = 0; ch < numberOfOutputBus_; ++ch)
@@ -274,6 +282,17 @@ AudioIO::IsRunning(void) const
     return isRunning_;
 }
 
+//  ---------------------------------------------------------------------------
+//      AudioIO::SetPreferredBufferSize
+//  ---------------------------------------------------------------------------
+void
+AudioIO::SetPreferredBufferSize(const uint32_t frames)
+{
+    //  larger buffers are split into bufferLength_ chunks by Render()
+    ioBufferSize_ = std::min<uint32_t>(std::max<uint32_t>(frames, 16), bufferLength_);
+    this->SetIOBufferSize();
+}
+
 //  ---------------------------------------------------------------------------
 //      AudioIO::SetIOBufferSize
 //  ---------------------------------------------------------------------------
@@ -287,7 +306,13 @@ AudioIO::SetIOBufferSize(void)
         AVAudioSession *session = [AVAudioSession sharedInstance];
         ThrowIfBOOL_([session setPreferredIOBufferDuration:duration
                                                      error:nil]);
-        latency_ = static_cast<UInt64>(session.preferredIOBufferDuration * NSEC_PER_SEC/* sec to nsec */);
+        //  the actual duration is known only after the request has been applied
+        const NSTimeInterval    ioBufferDuration = (session.IOBufferDuration > 0.0) ?
+                                                   session.IOBufferDuration : session.preferredIOBufferDuration;
+        latency_ = static_cast<UInt64>(ioBufferDuration * NSEC_PER_SEC/* sec to nsec */);
+        actualBufferSize_ = static_cast<uint32_t>(ioBufferDuration * sampleRate_ + 0.5);
+        //  the output of the hardware only : the session is for playback and has no input
+        playbackLatency_ = static_cast<UInt64>((ioBufferDuration + session.outputLatency) * NSEC_PER_SEC);
 
         // ThrowIfOSStatus_(::AudioSessionSetProperty(kAudioSessionProperty_PreferredHardwareIOBufferDuration,
         //                                            sizeof(duration), &duration));
@@ -322,6 +347,7 @@ AudioIO::Render(AudioUnitRenderActionFlags* /*ioActionFlags*/,
                 UInt32 inNumberFrames,
                 AudioBufferList* ioData)
 {
+    monitor_.BeginCallback();
     if ((inTimeStamp != NULL) && ((inTimeStamp->mFlags & kAudioTimeStampHostTimeValid) != 0))
     {
         hostTime_ = inTimeStamp->mHostTime;
@@ -354,13 +380,12 @@ AudioIO::Render(AudioUnitRenderActionFlags* /*ioActionFlags*/,
 
             if (rest > 0)
             {
-                mach_timebase_info_data_t   timeInfo;
-                mach_timebase_info(&timeInfo);
                 const uint64_t  timeNano = static_cast<uint64_t>(static_cast<float>(processLength) * 1000000000ULL / sampleRate_);
-                hostTime_ += timeNano * timeInfo.denom / timeInfo.numer;
+                hostTime_ += timeNano * timebaseDenom_ / timebaseNumer_;
             }
         }
     }
+    monitor_.EndCallback(inNumberFrames, sampleRate_);
 }
 
 //  ---------------------------------------------------------------------------
@@ -370,13 +395,31 @@ OSStatus
 AudioIO::RenderCallback(void* inRefCon, AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp,
                         UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList* ioData)
 {
-    @autoreleasepool {
-        AudioIO*  io = reinterpret_cast<AudioIO*>(inRefCon);
-        io->Render(ioActionFlags, inTimeStamp, inBusNumber, inNumberFrames, ioData);
-    }
+    AudioIO*  io = reinterpret_cast<AudioIO*>(inRefCon);
+    io->Render(ioActionFlags, inTimeStamp, inBusNumber, inNumberFrames, ioData);
     return noErr;
 }
 
+//  ---------------------------------------------------------------------------
+//      AudioIO::RenderOffline
+//  ---------------------------------------------------------------------------
+void
+AudioIO::RenderOffline(int16_t* interleaved, const uint32_t frames, const uint64_t hostTime)
+{
+    AudioTimeStamp  timeStamp = {};
+    timeStamp.mHostTime = hostTime;
+    timeStamp.mFlags = kAudioTimeStampHostTimeValid;
+
+    AudioBufferList bufferList;
+    bufferList.mNumberBuffers = 1;
+    bufferList.mBuffers[0].mNumberChannels = numberOfOutputBus_;
+    bufferList.mBuffers[0].mDataByteSize = frames * numberOfOutputBus_ * sizeof(SInt16);
+    bufferList.mBuffers[0].mData = interleaved;
+
+    AudioUnitRenderActionFlags  flags = 0;
+    AudioIO::RenderCallback(this, &flags, &timeStamp, 0, frames, &bufferList);
+}
+
 //  ---------------------------------------------------------------------------
 //      AudioIO::SetListener
 //  ---------------------------------------------------------------------------
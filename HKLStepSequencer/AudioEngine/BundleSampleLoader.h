@@ -0,0 +1,29 @@
+//
+//  BundleSampleLoader.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SampleLoader.h"
+
+//  Reads the sounds of the main bundle with ExtAudioFile(iOS/macOS).
+class BundleSampleLoader : public SampleLoader
+{
+public:
+    BundleSampleLoader(void);
+    ~BundleSampleLoader(void);
+
+    /* relative to the main bundle unless filename is an absolute path */
+    bool    Load(const std::string& filename, std::vector<int16_t>& pcmData, float& samplingRate) const;
+
+private:
+    BundleSampleLoader(const BundleSampleLoader& other) = delete;
+    const BundleSampleLoader& operator= (const BundleSampleLoader& other) = delete;
+};
@@ -0,0 +1,111 @@
+//
+//  BundleSampleLoader.mm
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <string>
+#include <vector>
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <Foundation/Foundation.h>
+#include "BundleSampleLoader.h"
+
+//  ---------------------------------------------------------------------------
+//      BundleSampleLoader::BundleSampleLoader
+//  ---------------------------------------------------------------------------
+BundleSampleLoader::BundleSampleLoader(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      BundleSampleLoader::~BundleSampleLoader
+//  ---------------------------------------------------------------------------
+BundleSampleLoader::~BundleSampleLoader(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      BundleSampleLoader::Load
+//  ---------------------------------------------------------------------------
+bool
+BundleSampleLoader::Load(const std::string& filename, std::vector<int16_t>& pcmData, float& samplingRate) const
+{
+    NSString*   nsFile = [NSString stringWithCString:filename.c_str() encoding:NSUTF8StringEncoding];
+    NSString*   resourcePath = [nsFile isAbsolutePath] ? nsFile :
+                               [[[NSBundle mainBundle] bundlePath] stringByAppendingPathComponent:nsFile];
+
+    bool    loaded = false;
+    pcmData.clear();
+    NSURL*  url = [[NSURL alloc] initFileURLWithPath:resourcePath isDirectory:NO];
+    ExtAudioFileRef fileRef = NULL;
+    OSStatus    err = ::ExtAudioFileOpenURL((__bridge CFURLRef)(url), &fileRef);
+    if (err == noErr)
+    {
+        AudioStreamBasicDescription fileFormat;
+        UInt32  size = sizeof(fileFormat);
+        err = ::ExtAudioFileGetProperty(fileRef, kExtAudioFileProperty_FileDataFormat, &size, &fileFormat);
+        if (err == noErr)
+        {
+            if ((fileFormat.mFormatID == kAudioFormatLinearPCM) && 
+                (fileFormat.mBitsPerChannel == 16) && 
+                (fileFormat.mChannelsPerFrame == 1) && 
+                ((fileFormat.mFormatFlags & kAudioFormatFlagIsSignedInteger) != 0) && 
+                ((fileFormat.mFormatFlags & kAudioFormatFlagIsPacked) != 0))
+            {
+                samplingRate = static_cast<float>(fileFormat.mSampleRate);
+
+                const UInt32    tmpFrames = 1024;
+                std::vector<uint8_t>   tmpBuf(tmpFrames * fileFormat.mBytesPerFrame);
+                AudioBufferList bufList;
+                bufList.mNumberBuffers = 1;
+                bufList.mBuffers[0].mNumberChannels = fileFormat.mChannelsPerFrame;
+                bufList.mBuffers[0].mDataByteSize   = static_cast<const UInt32>(tmpBuf.size());
+                bufList.mBuffers[0].mData           = &tmpBuf[0];
+
+                while (true)
+                {
+                    UInt32 frames = tmpFrames;
+                    bufList.mBuffers[0].mDataByteSize = static_cast<const UInt32>(tmpBuf.size());
+                    err = ExtAudioFileRead(fileRef, &frames, &bufList);
+                    if (err != noErr)
+                    {
+                        break;
+                    }
+                    if (frames == 0)
+                    {
+                        break;
+                    }
+                    else
+                    {
+                        int16_t*    src = static_cast<int16_t*>(bufList.mBuffers[0].mData);
+                        pcmData.insert(pcmData.end(), src, src + frames);
+                    }
+                }
+
+                const bool  isBigEndian = ((fileFormat.mFormatFlags & kAudioFormatFlagIsBigEndian) != 0);
+#if TARGET_RT_BIG_ENDIAN
+                const bool  flipPcm = !isBigEndian;
+#else
+                const bool  flipPcm = isBigEndian;
+#endif
+                if (flipPcm)
+                {
+                    for (size_t index = 0; index < pcmData.size(); ++index)
+                    {
+                        pcmData[index] = ::CFSwapInt16(pcmData[index]);
+                    }
+                }
+                loaded = true;
+            }
+        }
+    }
+    if (fileRef != NULL)
+    {
+        ::ExtAudioFileDispose(fileRef);
+        fileRef = NULL;
+    }
+    return loaded;
+}
@@ -0,0 +1,114 @@
+//
+//  ClockReceiver.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "HostClock.h"
+#include "ClockReceiver.h"
+#include "ClockSync.h"
+
+//  ---------------------------------------------------------------------------
+//      ClockReceiver::ClockReceiver
+//  ---------------------------------------------------------------------------
+ClockReceiver::ClockReceiver(ClockSync& sync) :
+sync_(sync),
+socket_(-1),
+port_(0),
+isRunning_(false),
+receiver_()
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockReceiver::~ClockReceiver
+//  ---------------------------------------------------------------------------
+ClockReceiver::~ClockReceiver(void)
+{
+    this->Stop();
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockReceiver::Start
+//  ---------------------------------------------------------------------------
+bool
+ClockReceiver::Start(const uint16_t port)
+{
+    this->Stop();
+    socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_ < 0)
+    {
+        return false;
+    }
+
+    //  wakes up regularly to see if it is stopped
+    struct timeval  timeout = { 0, 100000 };
+    struct sockaddr_in  address = {};
+    socklen_t   length = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((::setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) ||
+        (::bind(socket_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) ||
+        (::getsockname(socket_, reinterpret_cast<struct sockaddr*>(&address), &length) != 0))
+    {
+        ::close(socket_);
+        socket_ = -1;
+        return false;
+    }
+    port_ = ntohs(address.sin_port);
+    isRunning_.store(true, std::memory_order_release);
+    receiver_ = std::thread(&ClockReceiver::Run, this);
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockReceiver::Stop
+//  ---------------------------------------------------------------------------
+void
+ClockReceiver::Stop(void)
+{
+    isRunning_.store(false, std::memory_order_release);
+    if (receiver_.joinable())
+    {
+        receiver_.join();
+    }
+    if (socket_ >= 0)
+    {
+        ::close(socket_);
+        socket_ = -1;
+    }
+    port_ = 0;
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockReceiver::Run                              [receiver thread]
+//  ---------------------------------------------------------------------------
+void
+ClockReceiver::Run(void)
+{
+    uint8_t packet[16];
+    while (isRunning_.load(std::memory_order_acquire))
+    {
+        const ssize_t   size = ::recv(socket_, packet, sizeof(packet), 0);
+        const uint64_t  arrival = HostClock::Now();
+        if (size <= 0)
+        {
+            continue;   //  timed out
+        }
+        uint64_t    hostTime = 0;
+        for (int byte = 0; (byte < 8) && (size >= 9); ++byte)
+        {
+            hostTime |= static_cast<uint64_t>(packet[1 + byte]) << (byte * 8);
+        }
+        sync_.Receive(packet[0], (hostTime != 0) ? hostTime : arrival);
+    }
+}
@@ -0,0 +1,46 @@
+//
+//  ClockReceiver.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+class ClockSync;
+
+//  Receives an external clock on a local UDP port : a stand-in for a MIDI
+//  clock input or a network clock.
+//
+//  Each datagram is a ClockSync message(0xF8 : tick, 0xF9 : beat, 0xFA : start),
+//  optionally followed by the host time at which it is heard(HostClock::Now(),
+//  8 bytes little-endian). Without a host time, the message is timestamped
+//  when it arrives.
+class ClockReceiver
+{
+public:
+    ClockReceiver(ClockSync& sync);
+    ~ClockReceiver(void);               //  stops
+
+    /* 127.0.0.1 only. port 0 : any free port(GetPort) */
+    bool    Start(const uint16_t port);
+    void    Stop(void);
+    bool    IsRunning(void) const       { return isRunning_.load(std::memory_order_acquire); }
+    uint16_t    GetPort(void) const     { return port_; }
+
+private:
+    ClockReceiver(const ClockReceiver& other) = delete;
+    const ClockReceiver& operator= (const ClockReceiver& other) = delete;
+
+    void    Run(void);
+
+    ClockSync&  sync_;
+    int         socket_;
+    uint16_t    port_;
+    std::atomic<bool>   isRunning_;
+    std::thread receiver_;
+};
@@ -0,0 +1,323 @@
+//
+//  ClockSync.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cmath>
+#include <algorithm>
+
+#include "HostClock.h"
+#include "ClockSync.h"
+#include "RenderContext.h"
+
+static const double kMaxOmega = 0.5;        //  the DLL is stable far below 1.0 radian per message
+static const double kMinTempo = 20.0;       //  bpm
+static const double kMaxTempo = 480.0;
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::ClockSync
+//  ---------------------------------------------------------------------------
+ClockSync::ClockSync(const float samplingRate) :
+samplingRate_(samplingRate),
+timebaseNumer_(1),
+timebaseDenom_(1),
+bandwidth_(1.0f),
+queue_(kQueueCapacity),
+queueWrite_(0),
+queueRead_(0),
+queueMutex_(),
+hasTick_(false),
+isLocked_(false),
+lastFrame_(0),
+lastPosition_(0),
+lastSpan_(1),
+nextPosition_(0),
+period_(1),
+resetRequested_(false),
+isLockedReport_(false),
+periodReport_(0)
+{
+    HostClock::GetTimebase(timebaseNumer_, timebaseDenom_);
+    this->ClearReport();
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::~ClockSync
+//  ---------------------------------------------------------------------------
+ClockSync::~ClockSync(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::Receive
+//  ---------------------------------------------------------------------------
+void
+ClockSync::Receive(const int message, const uint64_t hostTime)
+{
+    const Message   received = { hostTime, 0.0, message };
+    this->Push(received);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::ReceiveAtFrame
+//  ---------------------------------------------------------------------------
+void
+ClockSync::ReceiveAtFrame(const int message, const double frame)
+{
+    const Message   received = { 0, frame, message };
+    this->Push(received);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::Push
+//  ---------------------------------------------------------------------------
+void
+ClockSync::Push(const Message& message)
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    const uint64_t  write = queueWrite_.load(std::memory_order_relaxed);
+    if (write - queueRead_.load(std::memory_order_acquire) >= kQueueCapacity)
+    {
+        numberOfDroppedMessages_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    queue_[write % kQueueCapacity] = message;
+    queueWrite_.store(write + 1, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::SetBandwidth
+//  ---------------------------------------------------------------------------
+void
+ClockSync::SetBandwidth(const float bandwidth)
+{
+    bandwidth_.store(std::max(bandwidth, 0.0f), std::memory_order_relaxed);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::Update                               [audio thread]
+//  ---------------------------------------------------------------------------
+bool
+ClockSync::Update(RenderContext* io, const uint64_t callbackFrame)
+{
+    if (resetRequested_.exchange(false, std::memory_order_acquire))
+    {
+        this->ClearReport();
+    }
+
+    const uint64_t  hostTime = (io != NULL) ? io->GetHostTime() : 0;
+    const double    latency = (io != NULL) ? io->GetPlaybackLatency() * samplingRate_ / 1000000000 : 0.0;
+    const uint64_t  write = queueWrite_.load(std::memory_order_acquire);
+    uint64_t    read = queueRead_.load(std::memory_order_relaxed);
+    for (; read < write; ++read)
+    {
+        const Message&  message = queue_[read % kQueueCapacity];
+        double  received = message.frame;
+        if (message.hostTime != 0)
+        {
+            if (io == NULL)
+            {
+                numberOfDroppedMessages_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            const int64_t   delta = message.hostTime - hostTime;
+            const double    deltaNanosec = static_cast<double>(delta) * timebaseNumer_ / timebaseDenom_;
+            received = callbackFrame + deltaNanosec * samplingRate_ / 1000000000;
+        }
+        if (message.message != kClockMessage_Start)
+        {
+            const double    delay = callbackFrame - received;
+            ClockSync::Add(numberOfDelays_, 1);
+            ClockSync::Add(delaySum_, delay);
+            ClockSync::Max(delayMax_, delay);
+        }
+        //  heard at its time : the frame is rendered the output latency earlier
+        this->ProcessMessage(message.message, received - latency);
+    }
+    queueRead_.store(read, std::memory_order_release);
+
+    //  the clock has stopped : the sequencer keeps the last tempo
+    if (isLocked_ && (callbackFrame > lastFrame_ + (kMaxMissedTicks + 1) * lastSpan_ * period_))
+    {
+        this->Unlock();
+    }
+    isLockedReport_.store(isLocked_, std::memory_order_relaxed);
+    periodReport_.store(isLocked_ ? period_ : 0.0, std::memory_order_relaxed);
+    return isLocked_;
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::ProcessMessage                       [audio thread]
+//  ---------------------------------------------------------------------------
+void
+ClockSync::ProcessMessage(const int message, const double frame)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    if (message == kClockMessage_Start)
+    {
+        //  the filtered clock goes on. only its position restarts from the next tick
+        lastPosition_ -= nextPosition_;
+        nextPosition_ = 0;
+        return;
+    }
+    if ((message != kClockMessage_Tick) && (message != kClockMessage_Beat))
+    {
+        return;
+    }
+
+    const double    span = (message == kClockMessage_Beat) ? kTicksPerBeat : 1;
+    double  position = static_cast<double>(nextPosition_);
+    nextPosition_ += static_cast<int64_t>(span);
+    ClockSync::Add(numberOfTicks_, static_cast<uint64_t>(span));
+
+    const double    minPeriod = samplingRate_ * 60.0 / (kMaxTempo * kTicksPerBeat);
+    const double    maxPeriod = samplingRate_ * 60.0 / (kMinTempo * kTicksPerBeat);
+    if (hasTick_)
+    {
+        double  ticks = position - lastPosition_;
+        if (!isLocked_)
+        {
+            //  the first period : filtered from the next message
+            const double    period = (frame - lastFrame_) / ticks;
+            if ((period >= minPeriod) && (period <= maxPeriod))
+            {
+                period_ = period;
+                isLocked_ = true;
+            }
+            lastFrame_ = frame;
+            lastPosition_ = position;
+            lastSpan_ = span;
+            return;
+        }
+
+        double  error = frame - (lastFrame_ + ticks * period_);
+        //  lost messages : the message is later by whole messages
+        const double    missed = std::floor(error / (span * period_) + 0.5);
+        if ((missed >= 0) && (missed <= kMaxMissedTicks))
+        {
+            if (missed > 0)
+            {
+                position += missed * span;
+                nextPosition_ += static_cast<int64_t>(missed * span);
+                ticks += missed * span;
+                error -= missed * span * period_;
+                ClockSync::Add(numberOfMissedTicks_, static_cast<uint64_t>(missed * span));
+            }
+            ClockSync::Add(numberOfJitters_, 1);
+            ClockSync::Add(jitterSumOfSquares_, error * error);
+            ClockSync::Max(jitterMax_, std::fabs(error));
+
+            //  2nd order DLL, critically damped. the loop gain is the bandwidth per message
+            const double    interval = ticks * period_ / samplingRate_;
+            const double    omega = std::min(2.0 * M_PI * bandwidth_.load(std::memory_order_relaxed) * interval, kMaxOmega);
+            lastFrame_ = frame - error + std::sqrt(2.0) * omega * error;
+            const double    period = period_ + omega * omega * error / ticks;
+            period_ = CLIP(period, minPeriod, maxPeriod);
+            lastPosition_ = position;
+            lastSpan_ = span;
+            return;
+        }
+        //  too early, or too many lost : the tempo has jumped
+        ClockSync::Add(numberOfRelocks_, 1);
+        this->Unlock();
+    }
+    hasTick_ = true;
+    lastFrame_ = frame;
+    lastPosition_ = position;
+    lastSpan_ = span;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::Unlock                               [audio thread]
+//  ---------------------------------------------------------------------------
+void
+ClockSync::Unlock(void)
+{
+    hasTick_ = false;
+    isLocked_ = false;
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::AddError                             [audio thread]
+//  ---------------------------------------------------------------------------
+void
+ClockSync::AddError(const double frames)
+{
+    ClockSync::Add(numberOfErrors_, 1);
+    ClockSync::Add(errorSum_, frames);
+    ClockSync::Add(errorSumOfSquares_, frames * frames);
+    ClockSync::Max(errorMax_, std::fabs(frames));
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::AddRelocation                        [audio thread]
+//  ---------------------------------------------------------------------------
+void
+ClockSync::AddRelocation(void)
+{
+    ClockSync::Add(numberOfRelocations_, 1);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::GetReport
+//  ---------------------------------------------------------------------------
+void
+ClockSync::GetReport(Report& report) const
+{
+    const double    period = periodReport_.load(std::memory_order_relaxed);
+    const uint64_t  numOfJitters = numberOfJitters_.load(std::memory_order_relaxed);
+    const uint64_t  numOfErrors = numberOfErrors_.load(std::memory_order_relaxed);
+    const uint64_t  numOfDelays = numberOfDelays_.load(std::memory_order_relaxed);
+    report.isLocked = isLockedReport_.load(std::memory_order_relaxed);
+    report.tempo = (period > 0) ? samplingRate_ * 60.0 / (period * kTicksPerBeat) : 0.0;
+    report.numberOfTicks = numberOfTicks_.load(std::memory_order_relaxed);
+    report.numberOfMissedTicks = numberOfMissedTicks_.load(std::memory_order_relaxed);
+    report.numberOfDroppedMessages = numberOfDroppedMessages_.load(std::memory_order_relaxed);
+    report.numberOfRelocks = numberOfRelocks_.load(std::memory_order_relaxed);
+    report.numberOfRelocations = numberOfRelocations_.load(std::memory_order_relaxed);
+    report.jitterRms = (numOfJitters > 0) ?
+        std::sqrt(jitterSumOfSquares_.load(std::memory_order_relaxed) / numOfJitters) / samplingRate_ : 0.0;
+    report.jitterMax = jitterMax_.load(std::memory_order_relaxed) / samplingRate_;
+    report.errorRms = (numOfErrors > 0) ?
+        std::sqrt(errorSumOfSquares_.load(std::memory_order_relaxed) / numOfErrors) / samplingRate_ : 0.0;
+    report.errorMax = errorMax_.load(std::memory_order_relaxed) / samplingRate_;
+    report.latency = (numOfErrors > 0) ? errorSum_.load(std::memory_order_relaxed) / numOfErrors / samplingRate_ : 0.0;
+    report.tickDelay = (numOfDelays > 0) ? delaySum_.load(std::memory_order_relaxed) / numOfDelays / samplingRate_ : 0.0;
+    report.maxTickDelay = delayMax_.load(std::memory_order_relaxed) / samplingRate_;
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::ResetReport
+//  ---------------------------------------------------------------------------
+void
+ClockSync::ResetReport(void)
+{
+    resetRequested_.store(true, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      ClockSync::ClearReport
+//  ---------------------------------------------------------------------------
+void
+ClockSync::ClearReport(void)
+{
+    numberOfTicks_.store(0, std::memory_order_relaxed);
+    numberOfMissedTicks_.store(0, std::memory_order_relaxed);
+    numberOfDroppedMessages_.store(0, std::memory_order_relaxed);
+    numberOfRelocks_.store(0, std::memory_order_relaxed);
+    numberOfRelocations_.store(0, std::memory_order_relaxed);
+    numberOfJitters_.store(0, std::memory_order_relaxed);
+    jitterSumOfSquares_.store(0, std::memory_order_relaxed);
+    jitterMax_.store(0, std::memory_order_relaxed);
+    numberOfErrors_.store(0, std::memory_order_relaxed);
+    errorSum_.store(0, std::memory_order_relaxed);
+    errorSumOfSquares_.store(0, std::memory_order_relaxed);
+    errorMax_.store(0, std::memory_order_relaxed);
+    numberOfDelays_.store(0, std::memory_order_relaxed);
+    delaySum_.store(0, std::memory_order_relaxed);
+    delayMax_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,152 @@
+//
+//  ClockSync.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//  Follows an external clock : MIDI clock ticks(24 per beat) or beats.
+//
+//  The messages are timestamped by the thread receiving them and queued
+//  without blocking the audio thread. At the beginning of each callback the
+//  audio thread converts their timestamps to frames of the sequencer and feeds
+//  them to a second order DLL(delay-locked loop). The DLL filters the jitter
+//  into the tick period(the tempo) and the position of the clock at any frame,
+//  which the Sequencer follows sample-accurately.
+class ClockSync
+{
+public:
+    enum
+    {
+        kTicksPerBeat = 24,                 //  MIDI clock
+        kQueueCapacity = 1024,              //  messages received within a callback
+        kMaxMissedTicks = 8,                //  bridged by the DLL. more : relocked
+    };
+
+    //  MIDI realtime status bytes. a beat(undefined in MIDI) is kTicksPerBeat ticks
+    enum
+    {
+        kClockMessage_Tick = 0xF8,
+        kClockMessage_Beat = 0xF9,
+        kClockMessage_Start = 0xFA,         //  the next tick is the step 0
+    };
+
+    typedef struct {
+        bool        isLocked;
+        double      tempo;                  //  bpm of the filtered clock
+        uint64_t    numberOfTicks;          //  taken by the DLL. a beat counts kTicksPerBeat
+        uint64_t    numberOfMissedTicks;    //  bridged by the DLL
+        uint64_t    numberOfDroppedMessages;    //  the queue was full, or not convertible to frames
+        uint64_t    numberOfRelocks;
+        uint64_t    numberOfRelocations;    //  the sequencer jumped to the position of the clock
+        double      jitterRms;              //  sec : the ticks against the filtered clock
+        double      jitterMax;
+        double      errorRms;               //  sec : the sequencer against the filtered clock, at each callback
+        double      errorMax;
+        double      latency;                //  sec : mean of the signed error. positive : behind the clock
+        double      tickDelay;              //  sec : mean time from a tick to the callback taking it
+        double      maxTickDelay;
+    } Report;
+
+    ClockSync(const float samplingRate);
+    ~ClockSync(void);
+
+    //  any thread. hostTime : HostClock::Now() at which the message is heard.
+    //  the sequencer is heard with it.
+    void    Receive(const int message, const uint64_t hostTime);
+    /* offline : frame of Sequencer::Process(frames since the sequencer was created) */
+    void    ReceiveAtFrame(const int message, const double frame);
+    /* Hz of the DLL(default 1Hz). lower filters more jitter, higher follows tempo changes faster */
+    void    SetBandwidth(const float bandwidth);
+    float   GetBandwidth(void) const        { return bandwidth_.load(std::memory_order_relaxed); }
+    void    GetReport(Report& report) const;
+    void    ResetReport(void);      //  applied at the beginning of the next callback
+
+    //  audio thread
+    /* takes the messages received. false : not locked(the sequencer keeps its own tempo) */
+    bool    Update(class RenderContext* io, const uint64_t callbackFrame);
+    double  GetTickFrameLength(void) const  { return period_; }
+    /* ticks since the start at the frame */
+    double  GetPosition(const uint64_t frame) const     { return lastPosition_ + (frame - lastFrame_) / period_; }
+    void    AddError(const double frames);
+    void    AddRelocation(void);
+
+private:
+    ClockSync(const ClockSync& other) = delete;
+    const ClockSync& operator= (const ClockSync& other) = delete;
+
+    typedef struct {
+        uint64_t    hostTime;           //  0 : frame
+        double      frame;
+        int32_t     message;
+    } Message;
+
+    void    Push(const Message& message);
+    void    ProcessMessage(const int message, const double frame);
+    void    Unlock(void);
+    void    ClearReport(void);
+
+    static inline void  Add(std::atomic<uint64_t>& counter, const uint64_t value)
+    {
+        //  single writer : no need to pay for a read-modify-write
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    static inline void  Add(std::atomic<double>& sum, const double value)
+    {
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    static inline void  Max(std::atomic<double>& maximum, const double value)
+    {
+        if (value > maximum.load(std::memory_order_relaxed))
+        {
+            maximum.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    const float samplingRate_;
+    uint32_t    timebaseNumer_;     //  HostClock::GetTimebase, cached
+    uint32_t    timebaseDenom_;
+    std::atomic<float>  bandwidth_;
+
+    //  single consumer queue : the producers are serialized by queueMutex_
+    std::vector<Message>    queue_;
+    std::atomic<uint64_t>   queueWrite_;
+    std::atomic<uint64_t>   queueRead_;
+    std::mutex  queueMutex_;
+
+    //  audio thread
+    bool        hasTick_;           //  lastFrame_ is valid
+    bool        isLocked_;          //  period_ is valid
+    double      lastFrame_;         //  filtered frame of the last tick
+    double      lastPosition_;      //  ticks since the start at lastFrame_
+    double      lastSpan_;          //  ticks of the last message
+    int64_t     nextPosition_;
+    double      period_;            //  frames per tick
+
+    //  audio thread -> any thread
+    std::atomic<bool>       resetRequested_;
+    std::atomic<bool>       isLockedReport_;
+    std::atomic<double>     periodReport_;
+    std::atomic<uint64_t>   numberOfTicks_;
+    std::atomic<uint64_t>   numberOfMissedTicks_;
+    std::atomic<uint64_t>   numberOfDroppedMessages_;   //  written by the producers too
+    std::atomic<uint64_t>   numberOfRelocks_;
+    std::atomic<uint64_t>   numberOfRelocations_;
+    std::atomic<uint64_t>   numberOfJitters_;
+    std::atomic<double>     jitterSumOfSquares_;
+    std::atomic<double>     jitterMax_;
+    std::atomic<uint64_t>   numberOfErrors_;
+    std::atomic<double>     errorSum_;
+    std::atomic<double>     errorSumOfSquares_;
+    std::atomic<double>     errorMax_;
+    std::atomic<uint64_t>   numberOfDelays_;
+    std::atomic<double>     delaySum_;
+    std::atomic<double>     delayMax_;
+};
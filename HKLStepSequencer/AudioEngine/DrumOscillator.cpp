@@ -0,0 +1,672 @@
+//
+//  DrumOscillator.cpp
+//  WISTSample
+//
+//  Created by Nobuhisa Okamura on 11/05/19.
+//  Copyright 2011 KORG INC. All rights reserved.
+//
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "SampleLoader.h"
+#include "DrumOscillator.h"
+
+namespace {
+//  pitch ratios of every semitone and cent, so that a pitch change is a lookup
+struct PitchTable
+{
+    double  semitones[DrumOscillator::kMaxTranspose * 2 + 1];
+    double  cents[DrumOscillator::kMaxTune * 2 + 1];
+
+    PitchTable(void)
+    {
+        for (int semitone = -DrumOscillator::kMaxTranspose; semitone <= DrumOscillator::kMaxTranspose; ++semitone)
+        {
+            semitones[semitone + DrumOscillator::kMaxTranspose] = ::pow(2.0, semitone / 12.0);
+        }
+        for (int cent = -DrumOscillator::kMaxTune; cent <= DrumOscillator::kMaxTune; ++cent)
+        {
+            cents[cent + DrumOscillator::kMaxTune] = ::pow(2.0, cent / 1200.0);
+        }
+    }
+};
+const PitchTable    sPitchTable;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::DrumOscillator
+//  ---------------------------------------------------------------------------
+DrumOscillator::DrumOscillator(float samplingRate) :
+tgSamplingRate_(samplingRate),
+pcmSamplingRate_(tgSamplingRate_),
+transpose_(0),
+tune_(0),
+panCoef_(0),
+isValid_(false),
+numberOfFrames_(0),
+currentAddress_(0),
+sample_(),
+isRunning_(false),
+trigger_(false)
+{
+    this->SetPanPosition(64);
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::~DrumOscillator
+//  ---------------------------------------------------------------------------
+DrumOscillator::~DrumOscillator(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetPanPosition
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetPanPosition(const int pan)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    panPosition_ = CLIP(pan, 0, 127);
+    const int32_t   panOfs = panPosition_ - 64;
+    const int32_t   coef = (0x400000 + 66577 * panOfs) >> 8;
+    panCoef_ = CLIP(coef, 0, 0x7FFF);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetPanPosition
+//  ---------------------------------------------------------------------------
+int
+DrumOscillator::GetPanPosition(void) const
+{
+    return panPosition_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetAmpCoefficient
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetAmpCoefficient(const int32_t ampCoef)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    ampCoef_ = CLIP(ampCoef, 0, 0xFFFF);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetAmpCoefficient
+//  ---------------------------------------------------------------------------
+int32_t
+DrumOscillator::GetAmpCoefficient(void) const
+{
+    return ampCoef_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetTranspose
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetTranspose(const int32_t transpose)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    transpose_ = CLIP(transpose, -kMaxTranspose, kMaxTranspose);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetTranspose
+//  ---------------------------------------------------------------------------
+int32_t
+DrumOscillator::GetTranspose(void) const
+{
+    return transpose_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetTune
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetTune(const int32_t tune)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    tune_ = CLIP(tune, -kMaxTune, kMaxTune);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetTune
+//  ---------------------------------------------------------------------------
+int32_t
+DrumOscillator::GetTune(void) const
+{
+    return tune_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::UpdatePitchOffset
+//  ---------------------------------------------------------------------------
+//  20.12. two lookups instead of pow() : cheap enough for every render of
+//  every voice. exactly the sampling rate ratio at 0 semitone and 0 cent.
+inline void
+DrumOscillator::UpdatePitchOffset(void)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    const int32_t   semitone = CLIP(transpose_ + pitch_, -kMaxTranspose, kMaxTranspose);
+    pitchOffset_ = static_cast<uint32_t>(sPitchTable.semitones[semitone + kMaxTranspose] *
+                                         (sPitchTable.cents[tune_ + kMaxTune] * rateRatio_) *
+                                         0x1000);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetPcmSamplingRate
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetPcmSamplingRate(float fs)
+{
+    pcmSamplingRate_ = fs;
+    rateRatio_ = ::pow(2.0, (::log(pcmSamplingRate_) - ::log(tgSamplingRate_)) / log(2.0));
+    this->UpdatePitchOffset();
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::TriggerOn
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::TriggerOn(const int32_t velocity, const int32_t pitch)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    trigger_ = true;
+    triggerVelocity_ = CLIP(velocity, 0, kVelocityUnity);
+    triggerPitch_ = CLIP(pitch, -kMaxTranspose, kMaxTranspose);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::IsRunning
+//  ---------------------------------------------------------------------------
+bool
+DrumOscillator::IsRunning(void) const
+{
+    return isRunning_ || trigger_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetVoiceState
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::GetVoiceState(bool& isRunning, uint32_t& address, int32_t& velocity, int32_t& pitch) const
+{
+    isRunning = isRunning_;
+    address = currentAddress_;
+    velocity = velocity_;
+    pitch = pitch_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetVoiceState
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetVoiceState(const bool isRunning, const uint32_t address, const int32_t velocity, const int32_t pitch)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    isRunning_ = isRunning;
+    currentAddress_ = address;
+    velocity_ = CLIP(velocity, 0, kVelocityUnity);
+    pitch_ = CLIP(pitch, -kMaxTranspose, kMaxTranspose);
+    trigger_ = false;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetOscOut
+//  ---------------------------------------------------------------------------
+inline int32_t
+DrumOscillator::GetOscOut(void)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    int32_t result = 0;
+    if (!isValid_ || !isRunning_) {
+        return result;
+    }
+
+    const uint32_t  addr = currentAddress_ >> 12;
+    if (addr < audibleFrames_) {
+        const uint32_t  nextAddr = addr + 1;
+        const int32_t   data = pcmData_[addr];
+        const int32_t   nextData = (nextAddr < numberOfFrames_) ? pcmData_[nextAddr] : 0;
+        const int32_t   interpolated = data + (((nextData - data) * static_cast<int32_t>(currentAddress_ & 0x0FFF)) >> 12);
+        result = CLIP(interpolated, -0x7FFF, 0x7FFF);
+        currentAddress_ += pitchOffset_;
+    } else {
+        isRunning_ = false;
+    }
+
+    return result;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::ProcessAmp
+//  ---------------------------------------------------------------------------
+inline int32_t
+DrumOscillator::ProcessAmp(int32_t oscOut, int32_t ampCoef)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    const int32_t   amp = (oscOut * ampCoef) >> 15;
+    return CLIP(amp, -0x7FFF, 0x7FFF);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::ProcessPan
+//  ---------------------------------------------------------------------------
+inline void
+DrumOscillator::ProcessPan(int32_t ampOut, int32_t& left, int32_t& right)
+{
+    left = ((ampOut * (0x7FFF - panCoef_)) >> 15);
+    right = (ampOut * panCoef_) >> 15;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetRenderKernel
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetRenderKernel(const int kernel)
+{
+    if ((kernel >= 0) && (kernel < kNumberOfRenderKernels))
+    {
+        renderKernel_ = kernel;
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::UpdateAudibleFrames
+//  ---------------------------------------------------------------------------
+//  The tail peaks never increase, so the first inaudible block is found by a
+//  binary search. It is searched again only when the gain has been changed.
+inline void
+DrumOscillator::UpdateAudibleFrames(void)
+{
+    const int32_t   ampCoef = (ampCoef_ * velocity_) >> 15;
+    if ((ampCoef == audibleAmpCoef_) && (releaseLevel_ == audibleReleaseLevel_))
+    {
+        return;
+    }
+    audibleAmpCoef_ = ampCoef;
+    audibleReleaseLevel_ = releaseLevel_;
+    audibleFrames_ = numberOfFrames_;
+    if (releaseLevel_ > 0)
+    {
+        //  the output of a block is at most (peak * ampCoef) >> 15 + 1 for negative samples
+        const int32_t   level = releaseLevel_;
+        const std::vector<int16_t>&   tailPeaks = sample_->tailPeaks;
+        const auto  inaudible = std::partition_point(tailPeaks.begin(), tailPeaks.end(), [ampCoef, level](const int16_t peak) {
+            return ((peak * ampCoef) >> 15) >= level;
+        });
+        const uint32_t  frames = static_cast<uint32_t>(inaudible - tailPeaks.begin()) * kTailBlockFrames;
+        audibleFrames_ = std::min(frames, numberOfFrames_);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::Process
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::Process(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel)
+{
+    if (trigger_)
+    {
+        isRunning_ = true;
+        currentAddress_ = 0;
+        velocity_ = triggerVelocity_;
+        pitch_ = triggerPitch_;
+        trigger_ = false;
+    }
+    int     rendered = 0;
+    if (isRunning_)
+    {
+        this->UpdateAudibleFrames();
+        this->UpdatePitchOffset();
+        switch (renderKernel_)
+        {
+            case kRenderKernel_Block:
+                rendered = this->ProcessBlock(output, length, mixLevel);
+                break;
+            default:
+                rendered = this->ProcessScalar(output, length, mixLevel);
+                break;
+        }
+    }
+    if ((mixLevel != NULL) && (rendered < length))
+    {
+        //  the voices mixed before this one
+        LevelMeter::Measure(output[0] + rendered, output[1] + rendered, length - rendered, *mixLevel);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::Skip
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::Skip(int length)
+{
+    if (trigger_)
+    {
+        isRunning_ = true;
+        currentAddress_ = 0;
+        velocity_ = triggerVelocity_;
+        pitch_ = triggerPitch_;
+        trigger_ = false;
+    }
+    if (!isRunning_ || !isValid_ || (length <= 0))
+    {
+        return;
+    }
+
+    this->UpdateAudibleFrames();
+    this->UpdatePitchOffset();
+    const uint64_t  endAddress = static_cast<uint64_t>(audibleFrames_) << 12;
+    const uint64_t  restFrames = (currentAddress_ >= endAddress) ? 0 :
+                                 (pitchOffset_ == 0) ? length :
+                                 (endAddress - currentAddress_ + pitchOffset_ - 1) / pitchOffset_;
+    if (restFrames >= static_cast<uint64_t>(length))
+    {
+        currentAddress_ += pitchOffset_ * static_cast<uint32_t>(length);
+    }
+    else
+    {
+        currentAddress_ += pitchOffset_ * static_cast<uint32_t>(restFrames);
+        isRunning_ = false;
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::ProcessScalar
+//  ---------------------------------------------------------------------------
+//  returns the frames rendered : less than length if the voice has ended
+inline int
+DrumOscillator::ProcessScalar(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    int16_t*    left = output[0];
+    int16_t*    right = output[1];
+    //  the velocity scales the amp of the hit. exact at kVelocityUnity
+    const int32_t   ampCoef = (ampCoef_ * velocity_) >> 15;
+    //  metering is done in the same pass as mixing
+    int32_t     peak = levelPeak_;
+    uint64_t    sumOfSquares = 0;
+    int32_t     mixPeak = (mixLevel != NULL) ? mixLevel->peak : 0;
+    uint64_t    mixSumOfSquares = 0;
+    int         frame = 0;
+    while (frame < length)
+    {
+        int32_t leftOut, rightOut;
+        this->ProcessPan(this->ProcessAmp(this->GetOscOut(), ampCoef), leftOut, rightOut);
+        LevelMeter::Measure(leftOut, rightOut, peak, sumOfSquares);
+        leftOut += *left;
+        rightOut += *right;
+        const int32_t   leftMix = CLIP(leftOut, -0x7FFF, 0x7FFF);
+        const int32_t   rightMix = CLIP(rightOut, -0x7FFF, 0x7FFF);
+        *(left++) = leftMix;
+        *(right++) = rightMix;
+        if (mixLevel != NULL)
+        {
+            LevelMeter::Measure(leftMix, rightMix, mixPeak, mixSumOfSquares);
+        }
+        ++frame;
+        if (!isRunning_)
+        {
+            break;
+        }
+    }
+    levelPeak_ = peak;
+    levelSumOfSquares_ += sumOfSquares;
+    if (mixLevel != NULL)
+    {
+        mixLevel->peak = mixPeak;
+        mixLevel->sumOfSquares += mixSumOfSquares;
+    }
+    return frame;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::ProcessBlock
+//  ---------------------------------------------------------------------------
+//  Bit-exact with ProcessScalar. The number of frames left in the sample is
+//  resolved once, so the inner loop has no validity or end-of-sample checks.
+inline int
+DrumOscillator::ProcessBlock(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    if (!isValid_)
+    {
+        return 0;   //  silent(the scalar kernel adds zeros)
+    }
+
+    const uint64_t  endAddress = static_cast<uint64_t>(audibleFrames_) << 12;
+    const uint64_t  restFrames = (currentAddress_ >= endAddress) ? 0 :
+                                 (pitchOffset_ == 0) ? length :
+                                 (endAddress - currentAddress_ + pitchOffset_ - 1) / pitchOffset_;
+    const int       frames = (restFrames < static_cast<uint64_t>(length)) ? static_cast<int>(restFrames) : length;
+
+    const int16_t*  pcm = pcmData_;
+    const int32_t   ampCoef = (ampCoef_ * velocity_) >> 15;
+    const int32_t   leftCoef = 0x7FFF - panCoef_;
+    const int32_t   rightCoef = panCoef_;
+    const uint32_t  pitchOffset = pitchOffset_;
+    uint32_t    address = currentAddress_;
+    int16_t*    left = output[0];
+    int16_t*    right = output[1];
+    int32_t     peak = levelPeak_;
+    uint64_t    sumOfSquares = 0;
+    int32_t     mixPeak = (mixLevel != NULL) ? mixLevel->peak : 0;
+    uint64_t    mixSumOfSquares = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        const uint32_t  addr = address >> 12;
+        const int32_t   data = pcm[addr];
+        const int32_t   nextData = pcm[addr + 1];
+        const int32_t   interpolated = data + (((nextData - data) * static_cast<int32_t>(address & 0x0FFF)) >> 12);
+        const int32_t   oscOut = CLIP(interpolated, -0x7FFF, 0x7FFF);
+        const int32_t   amp = (oscOut * ampCoef) >> 15;
+        const int32_t   ampOut = CLIP(amp, -0x7FFF, 0x7FFF);
+        int32_t leftOut = (ampOut * leftCoef) >> 15;
+        int32_t rightOut = (ampOut * rightCoef) >> 15;
+        LevelMeter::Measure(leftOut, rightOut, peak, sumOfSquares);
+        leftOut += left[frame];
+        rightOut += right[frame];
+        const int32_t   leftMix = CLIP(leftOut, -0x7FFF, 0x7FFF);
+        const int32_t   rightMix = CLIP(rightOut, -0x7FFF, 0x7FFF);
+        left[frame] = leftMix;
+        right[frame] = rightMix;
+        if (mixLevel != NULL)
+        {
+            LevelMeter::Measure(leftMix, rightMix, mixPeak, mixSumOfSquares);
+        }
+        address += pitchOffset;
+    }
+    currentAddress_ = address;
+    levelPeak_ = peak;
+    levelSumOfSquares_ += sumOfSquares;
+    if (mixLevel != NULL)
+    {
+        mixLevel->peak = mixPeak;
+        mixLevel->sumOfSquares += mixSumOfSquares;
+    }
+    if (frames < length)
+    {
+        isRunning_ = false;
+    }
+    return frames;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetLevel
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::GetLevel(int32_t& peak, uint64_t& sumOfSquares)
+{
+    peak = levelPeak_;
+    sumOfSquares = levelSumOfSquares_;
+    levelPeak_ = 0;
+    levelSumOfSquares_ = 0;
+}
+
+#pragma mark - sample analysis
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetSilenceLevel
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetSilenceLevel(const int32_t level)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    silenceLevel_ = CLIP(level, 0, 0x7FFF);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetSilenceLevel
+//  ---------------------------------------------------------------------------
+int32_t
+DrumOscillator::GetSilenceLevel(void) const
+{
+    return silenceLevel_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetReleaseLevel
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetReleaseLevel(const int32_t level)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    releaseLevel_ = CLIP(level, 0, 0x7FFF);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetReleaseLevel
+//  ---------------------------------------------------------------------------
+int32_t
+DrumOscillator::GetReleaseLevel(void) const
+{
+    return releaseLevel_;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::GetSampleInfo
+//  ---------------------------------------------------------------------------
+const DrumOscillator::SampleInfo&
+DrumOscillator::GetSampleInfo(void) const
+{
+    static const SampleInfo sEmptyInfo = {};
+    return (sample_ != nullptr) ? sample_->info : sEmptyInfo;
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::AnalyzeSample
+//  ---------------------------------------------------------------------------
+//  called after loading. sample.pcmData holds the frames loaded, without the
+//  guard sample. sample.info.samplingRate is set.
+void
+DrumOscillator::AnalyzeSample(Sample& sample) const
+{
+    std::vector<int16_t>&   pcmData = sample.pcmData;
+    const uint32_t  loadedFrames = static_cast<uint32_t>(pcmData.size());
+
+    //  trailing silence : never played audibly, so it is not kept
+    uint32_t    frames = loadedFrames;
+    while ((frames > 0) && (std::abs(static_cast<int32_t>(pcmData[frames - 1])) <= silenceLevel_))
+    {
+        --frames;
+    }
+    sample.info.trimmedFrames = loadedFrames - frames;
+    sample.info.numberOfFrames = frames;
+    pcmData.resize(frames);
+    pcmData.push_back(0);   //  guard sample for interpolation
+    pcmData.shrink_to_fit();
+
+    //  peak from each block to the end, for the early release
+    const uint32_t  numOfBlocks = (frames + kTailBlockFrames - 1) / kTailBlockFrames;
+    sample.tailPeaks.assign(numOfBlocks, 0);
+    int32_t     peak = 0;
+    for (uint32_t blockNo = numOfBlocks; blockNo-- > 0; )
+    {
+        const uint32_t  end = std::min<uint32_t>(frames, (blockNo + 1) * kTailBlockFrames);
+        for (uint32_t frame = blockNo * kTailBlockFrames; frame < end; ++frame)
+        {
+            peak = std::max(peak, std::abs(static_cast<int32_t>(pcmData[frame])));
+        }
+        sample.tailPeaks[blockNo] = static_cast<int16_t>(std::min(peak, 0x7FFF));
+    }
+    sample.info.peak = (numOfBlocks > 0) ? sample.tailPeaks[0] : 0;
+
+    //  loudness : rms of the loudest window
+    const uint32_t  window = std::max<uint32_t>(static_cast<uint32_t>(sample.info.samplingRate * kLoudnessWindowMsec / 1000), 1);
+    uint64_t    sumOfSquares = 0;
+    uint64_t    maxSumOfSquares = 0;
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        const int64_t   value = pcmData[frame];
+        sumOfSquares += static_cast<uint64_t>(value * value);
+        if (frame >= window)
+        {
+            const int64_t   oldValue = pcmData[frame - window];
+            sumOfSquares -= static_cast<uint64_t>(oldValue * oldValue);
+        }
+        maxSumOfSquares = std::max(maxSumOfSquares, sumOfSquares);
+    }
+    const int32_t   loudness = static_cast<int32_t>(::sqrt(static_cast<double>(maxSumOfSquares) / window));
+    sample.info.loudness = std::min(loudness, 0x7FFF);
+}
+
+#pragma mark -
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::LoadAudioFile
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::LoadAudioFile(const SampleLoader& loader, const std::string &filename)
+{
+    std::shared_ptr<Sample> sample = std::make_shared<Sample>();
+    sample->info = SampleInfo();
+    float   pcmSamplingRate = 0.0f;
+    const bool  loaded = loader.Load(filename, sample->pcmData, pcmSamplingRate) && (pcmSamplingRate > 0.0f);
+    if (loaded)
+    {
+        sample->info.samplingRate = pcmSamplingRate;
+        this->AnalyzeSample(*sample);
+        this->SetSample(sample);
+    }
+    else
+    {
+        this->SetSample(nullptr);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      DrumOscillator::SetSample
+//  ---------------------------------------------------------------------------
+void
+DrumOscillator::SetSample(const std::shared_ptr<const Sample>& sample)
+{
+    sample_ = sample;
+    isValid_ = (sample_ != nullptr);
+    if (isValid_)
+    {
+        numberOfFrames_ = sample_->info.numberOfFrames;
+        pcmData_ = sample_->pcmData.data();
+        this->SetPcmSamplingRate(sample_->info.samplingRate);
+    }
+    else
+    {
+        numberOfFrames_ = 0;
+        pcmData_ = nullptr;
+    }
+    audibleFrames_ = numberOfFrames_;
+    audibleAmpCoef_ = -1;   //  decided at the next render
+}
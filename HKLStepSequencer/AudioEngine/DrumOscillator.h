@@ -7,44 +7,140 @@
 //
 
 #pragma once
+#include <memory>
+#include <vector>
+#include "LevelMeter.h"
 
 class DrumOscillator
 {
 public:
+    enum
+    {
+        kRenderKernel_Scalar = 0,   //  reference : per-sample bounds checks
+        kRenderKernel_Block,        //  bounds resolved once per block
+        kNumberOfRenderKernels
+    };
+    enum
+    {
+        kVelocityUnity = 0x8000,    //  Q15 : x1.0
+        kMaxTranspose = 48,         //  semitones : transpose + the pitch of the hit
+        kMaxTune = 100,             //  cents
+    };
+    enum
+    {
+        kTailBlockFrames = 64,      //  granularity of the early release
+        kLoudnessWindowMsec = 50,
+    };
+
+    typedef struct {
+        uint32_t    numberOfFrames;     //  after trimming
+        uint32_t    trimmedFrames;      //  silence removed from the end
+        float       samplingRate;
+        int32_t     peak;               //  0 - 0x7FFF
+        int32_t     loudness;           //  0 - 0x7FFF : maximum rms in kLoudnessWindowMsec
+    } SampleInfo;
+
+    //  immutable once loaded : shared by the voices playing the same sound
+    typedef struct {
+        std::vector<int16_t>    pcmData;    //  info.numberOfFrames + 1 : padded with 0 for interpolation
+        std::vector<int16_t>    tailPeaks;  //  per kTailBlockFrames : peak from the block to the end
+        SampleInfo  info;
+    } Sample;
+
     DrumOscillator(float samplingRate);
     ~DrumOscillator(void);
 
+    void    SetRenderKernel(const int kernel);
+    int     GetRenderKernel(void) const     { return renderKernel_; }
+
     /* 0(left)-64(center)-127(right) */
     void    SetPanPosition(const int pan);
+    int     GetPanPosition(void) const;
 
     /* 0x0(mute) - 0x7FFF(x1.0) - 0xFFFF(x2.0) */
     void    SetAmpCoefficient(const int32_t ampCoef);
-    int32_t GetAmpCoefficient(void);
+    int32_t GetAmpCoefficient(void) const;
+
+    /* -kMaxTranspose - kMaxTranspose semitones. applied to the voice playing as well */
+    void    SetTranspose(const int32_t transpose);
+    int32_t GetTranspose(void) const;
+    /* -kMaxTune - kMaxTune cents */
+    void    SetTune(const int32_t tune);
+    int32_t GetTune(void) const;
 
-    void    Process(int16_t** output, int length);
-    void    TriggerOn(void);
+    /* mixLevel : if not NULL, the mix in output after this voice is measured into it(the last voice mixed) */
+    void    Process(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel = NULL);
+    /* advances the voice as Process does without rendering it */
+    void    Skip(int length);
+    /* velocity : gain of the hit. 0(mute) - kVelocityUnity(x1.0), applied on top of the amp */
+    /* pitch : semitones of the hit, added to the transpose */
+    void    TriggerOn(const int32_t velocity = kVelocityUnity, const int32_t pitch = 0);
+    bool    IsRunning(void) const;
+    /* Process mixes it at the next call : running or triggered */
+    bool    IsActive(void) const            { return isRunning_ || trigger_; }
 
-    void    LoadAudioFileInResourceFolder(const std::string &filename);
+    /* playback position(20.12), velocity and pitch of the hit for trace record/replay */
+    void    GetVoiceState(bool& isRunning, uint32_t& address, int32_t& velocity, int32_t& pitch) const;
+    void    SetVoiceState(const bool isRunning, const uint32_t address, const int32_t velocity = kVelocityUnity,
+                          const int32_t pitch = 0);
+
+    /* peak & sum of squares(L+R) of the output since the last call */
+    void    GetLevel(int32_t& peak, uint64_t& sumOfSquares);
+
+    /* 0 - 0x7FFF : the samples at the end at or below it are trimmed at load. set before loading */
+    void    SetSilenceLevel(const int32_t level);
+    int32_t GetSilenceLevel(void) const;
+    /* 0(off) - 0x7FFF : a voice ends when the peak of the rest of the sample at the current gain is below it */
+    void    SetReleaseLevel(const int32_t level);
+    int32_t GetReleaseLevel(void) const;
+    const SampleInfo&   GetSampleInfo(void) const;
+
+    /* filename : resolved by the loader(e.g. relative to the main bundle) */
+    void    LoadAudioFile(const class SampleLoader& loader, const std::string &filename);
+    /* plays the sample loaded by another oscillator without copying it. NULL : silent */
+    void    SetSample(const std::shared_ptr<const Sample>& sample);
+    std::shared_ptr<const Sample>   GetSample(void) const     { return sample_; }
 
 private:
-    void    LoadAudioFile(CFStringRef path);
+    DrumOscillator(const DrumOscillator& other) = delete;
+    const DrumOscillator& operator= (const DrumOscillator& other) = delete;
+
     void    SetPcmSamplingRate(float fs);
-    void    CalculatePitch(void);
+    void    UpdatePitchOffset(void);
+    void    AnalyzeSample(Sample& sample) const;
+    void    UpdateAudibleFrames(void);
+    int     ProcessScalar(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel);
+    int     ProcessBlock(int16_t** output, int length, LevelMeter::BlockLevel* mixLevel);
     int32_t GetOscOut(void);
-    int32_t ProcessAmp(int32_t oscOut);
+    int32_t ProcessAmp(int32_t oscOut, int32_t ampCoef);
     void    ProcessPan(int32_t ampOut, int32_t& left, int32_t& right);
 
     const float     tgSamplingRate_;
     int32_t     ampCoef_ = 0x7FFF >> 2; //  amp gain
     float       pcmSamplingRate_;
+    double      rateRatio_ = 1.0;       //  pcm / output sampling rate
     int32_t     transpose_;
     int32_t     tune_;
     uint32_t    pitchOffset_ = 0x1000;  //  1.0
     int32_t     panCoef_;
+    int         panPosition_ = 64;
     bool        isValid_;
     uint32_t    numberOfFrames_;
     uint32_t    currentAddress_;
-    std::vector<int16_t>    pcmData_;
+    std::shared_ptr<const Sample>   sample_;
+    const int16_t*  pcmData_ = nullptr; //  of sample_ : numberOfFrames_ + 1
+    int32_t     silenceLevel_ = 0;
+    int32_t     releaseLevel_ = 0;
+    uint32_t    audibleFrames_ = 0;     //  the voice ends here. numberOfFrames_ unless released early
+    int32_t     audibleAmpCoef_ = -1;   //  amp * velocity which audibleFrames_ was decided for
+    int32_t     audibleReleaseLevel_ = 0;
     bool        isRunning_;
     bool        trigger_;
+    int32_t     velocity_ = kVelocityUnity;         //  of the hit being played
+    int32_t     triggerVelocity_ = kVelocityUnity;
+    int32_t     pitch_ = 0;
+    int32_t     triggerPitch_ = 0;
+    int         renderKernel_ = kRenderKernel_Scalar;
+    int32_t     levelPeak_ = 0;
+    uint64_t    levelSumOfSquares_ = 0;
 };
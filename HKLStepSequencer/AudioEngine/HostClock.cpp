@@ -0,0 +1,47 @@
+//
+//  HostClock.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <chrono>
+#endif
+
+#include "HostClock.h"
+
+//  ---------------------------------------------------------------------------
+//      HostClock::Now                                              [static]
+//  ---------------------------------------------------------------------------
+uint64_t
+HostClock::Now(void)
+{
+#if defined(__APPLE__)
+    return ::mach_absolute_time();
+#else
+    const auto  now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+#endif
+}
+
+//  ---------------------------------------------------------------------------
+//      HostClock::GetTimebase                                      [static]
+//  ---------------------------------------------------------------------------
+void
+HostClock::GetTimebase(uint32_t& numer, uint32_t& denom)
+{
+    numer = 1;
+    denom = 1;
+#if defined(__APPLE__)
+    mach_timebase_info_data_t   timeInfo;
+    if (::mach_timebase_info(&timeInfo) == 0)
+    {
+        numer = timeInfo.numer;
+        denom = timeInfo.denom;
+    }
+#endif
+}
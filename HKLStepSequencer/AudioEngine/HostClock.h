@@ -0,0 +1,22 @@
+//
+//  HostClock.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+
+//  The clock of the host time : AudioTimeStamp::mHostTime and the time stamps
+//  of the clock messages. mach_absolute_time on Apple platforms, elsewhere the
+//  steady clock of the C++ library(1 tick = 1 nanosec), so the engine can be
+//  built and replayed offline on any platform.
+class HostClock
+{
+public:
+    static uint64_t Now(void);
+    /* nanosec = ticks * numer / denom */
+    static void     GetTimebase(uint32_t& numer, uint32_t& denom);
+};
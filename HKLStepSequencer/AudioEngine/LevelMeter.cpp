@@ -0,0 +1,177 @@
+//
+//  LevelMeter.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cmath>
+
+#include "LevelMeter.h"
+
+namespace {
+    const float kPeakReleaseTime = 0.3f;    //  sec(1/e)
+    const float kRmsTimeConstant = 0.1f;    //  sec
+    const float kFullScale = 32767.0f;
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::LevelMeter
+//  ---------------------------------------------------------------------------
+LevelMeter::LevelMeter(const int maxNumberOfTracks) :
+maxNumberOfTracks_(maxNumberOfTracks),
+frames_(0),
+samplingRate_(0.0f),
+peakDecay_(0.0f),
+rmsCoef_(1.0f),
+trackState_(maxNumberOfTracks),
+masterState_(),
+sequence_(0),
+trackPeak_(maxNumberOfTracks),
+trackRms_(maxNumberOfTracks),
+masterPeak_(0.0f),
+masterRms_(0.0f)
+{
+    for (int trackNo = 0; trackNo < maxNumberOfTracks_; ++trackNo)
+    {
+        trackState_[trackNo] = { 0.0f, 0.0f };
+        trackPeak_[trackNo].store(0.0f, std::memory_order_relaxed);
+        trackRms_[trackNo].store(0.0f, std::memory_order_relaxed);
+    }
+    masterState_ = { 0.0f, 0.0f };
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::~LevelMeter
+//  ---------------------------------------------------------------------------
+LevelMeter::~LevelMeter(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::Measure                                         [static]
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::Measure(const int16_t* left, const int16_t* right, const int frames, BlockLevel& level)
+{
+    int32_t     peak = level.peak;
+    uint64_t    sumOfSquares = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        LevelMeter::Measure(left[frame], right[frame], peak, sumOfSquares);
+    }
+    level.peak = peak;
+    level.sumOfSquares += sumOfSquares;
+}
+
+#pragma mark - audio thread
+//  ---------------------------------------------------------------------------
+//      LevelMeter::BeginUpdate
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::BeginUpdate(const uint32_t frames, const float samplingRate)
+{
+    if ((frames != frames_) || (samplingRate != samplingRate_))
+    {
+        frames_ = frames;
+        samplingRate_ = samplingRate;
+        peakDecay_ = ::expf(-static_cast<float>(frames) / (samplingRate * kPeakReleaseTime));
+        rmsCoef_ = 1.0f - ::expf(-static_cast<float>(frames) / (samplingRate * kRmsTimeConstant));
+    }
+
+    //  odd while writing
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::Update
+//  ---------------------------------------------------------------------------
+inline void
+LevelMeter::Update(Ballistics& state, std::atomic<float>& peak, std::atomic<float>& rms,
+                   const int32_t blockPeak, const uint64_t sumOfSquares)
+{
+    const float blockMeanSquare = (frames_ > 0) ? static_cast<float>(sumOfSquares) / (2.0f * frames_) : 0.0f;
+    const float decayed = state.peakHold * peakDecay_;
+    state.peakHold = (blockPeak > decayed) ? static_cast<float>(blockPeak) : decayed;
+    state.meanSquare += (blockMeanSquare - state.meanSquare) * rmsCoef_;
+
+    peak.store(state.peakHold / kFullScale, std::memory_order_relaxed);
+    rms.store(::sqrtf(state.meanSquare) / kFullScale, std::memory_order_relaxed);
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::UpdateTrack
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::UpdateTrack(const int trackNo, const int32_t peak, const uint64_t sumOfSquares)
+{
+    if ((trackNo >= 0) && (trackNo < maxNumberOfTracks_))
+    {
+        this->Update(trackState_[trackNo], trackPeak_[trackNo], trackRms_[trackNo], peak, sumOfSquares);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::UpdateMaster
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::UpdateMaster(const int32_t peak, const uint64_t sumOfSquares)
+{
+    this->Update(masterState_, masterPeak_, masterRms_, peak, sumOfSquares);
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::EndUpdate
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::EndUpdate(void)
+{
+    //  even when published
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+#pragma mark - any thread
+//  ---------------------------------------------------------------------------
+//      LevelMeter::Read
+//  ---------------------------------------------------------------------------
+inline void
+LevelMeter::Read(const std::atomic<float>& peak, const std::atomic<float>& rms, Level& level) const
+{
+    while (true)
+    {
+        const uint32_t  before = sequence_.load(std::memory_order_acquire);
+        level.peak = peak.load(std::memory_order_relaxed);
+        level.rms = rms.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint32_t  after = sequence_.load(std::memory_order_relaxed);
+        if (((before & 1) == 0) && (before == after))
+        {
+            break;
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::GetTrackLevel
+//  ---------------------------------------------------------------------------
+bool
+LevelMeter::GetTrackLevel(const int trackNo, Level& level) const
+{
+    if ((trackNo < 0) || (trackNo >= maxNumberOfTracks_))
+    {
+        return false;
+    }
+    this->Read(trackPeak_[trackNo], trackRms_[trackNo], level);
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      LevelMeter::GetMasterLevel
+//  ---------------------------------------------------------------------------
+void
+LevelMeter::GetMasterLevel(Level& level) const
+{
+    this->Read(masterPeak_, masterRms_, level);
+}
@@ -0,0 +1,84 @@
+//
+//  LevelMeter.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//  Per-track and master peak/RMS levels.
+//  The audio thread feeds block measurements between BeginUpdate()/EndUpdate(),
+//  and the result is published through a seqlock so that the UI can poll it at
+//  display rate without blocking the audio thread.
+class LevelMeter
+{
+public:
+    typedef struct {
+        float   peak;   //  0.0-1.0 of full scale
+        float   rms;    //  0.0-1.0 of full scale
+    } Level;
+
+    //  measurement of a block : fed to UpdateTrack()/UpdateMaster()
+    typedef struct {
+        int32_t     peak;           //  0-0x7FFF
+        uint64_t    sumOfSquares;   //  L+R
+    } BlockLevel;
+
+    /* adds frames of a stereo buffer to level */
+    static void Measure(const int16_t* left, const int16_t* right, const int frames, BlockLevel& level);
+    /* adds a frame : the same pass as mixing */
+    static inline void  Measure(const int32_t left, const int32_t right, int32_t& peak, uint64_t& sumOfSquares)
+    {
+        const int32_t   absLeft = (left < 0) ? -left : left;
+        const int32_t   absRight = (right < 0) ? -right : right;
+        const int32_t   absMax = (absLeft > absRight) ? absLeft : absRight;
+        peak = (absMax > peak) ? absMax : peak;
+        sumOfSquares += static_cast<uint64_t>(left * left) + static_cast<uint64_t>(right * right);
+    }
+
+    LevelMeter(const int maxNumberOfTracks);
+    ~LevelMeter(void);
+
+    int     GetMaxNumberOfTracks(void) const    { return maxNumberOfTracks_; }
+
+    //  audio thread
+    void    BeginUpdate(const uint32_t frames, const float samplingRate);
+    void    UpdateTrack(const int trackNo, const int32_t peak, const uint64_t sumOfSquares);
+    void    UpdateMaster(const int32_t peak, const uint64_t sumOfSquares);
+    void    EndUpdate(void);
+
+    //  any thread
+    bool    GetTrackLevel(const int trackNo, Level& level) const;
+    void    GetMasterLevel(Level& level) const;
+
+private:
+    LevelMeter(const LevelMeter& other) = delete;
+    const LevelMeter& operator= (const LevelMeter& other) = delete;
+
+    typedef struct {
+        float   peakHold;
+        float   meanSquare;
+    } Ballistics;
+
+    void    Update(Ballistics& state, std::atomic<float>& peak, std::atomic<float>& rms,
+                   const int32_t blockPeak, const uint64_t sumOfSquares);
+    void    Read(const std::atomic<float>& peak, const std::atomic<float>& rms, Level& level) const;
+
+    const int   maxNumberOfTracks_;
+    uint32_t    frames_;
+    float       samplingRate_;      //  peakDecay_/rmsCoef_ are recalculated only when these change
+    float       peakDecay_;
+    float       rmsCoef_;
+    std::vector<Ballistics>     trackState_;    //  audio thread only
+    Ballistics                  masterState_;   //  audio thread only
+    std::atomic<uint32_t>       sequence_;
+    std::vector< std::atomic<float> >   trackPeak_;
+    std::vector< std::atomic<float> >   trackRms_;
+    std::atomic<float>          masterPeak_;
+    std::atomic<float>          masterRms_;
+};
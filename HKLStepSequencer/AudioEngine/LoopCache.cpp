@@ -0,0 +1,569 @@
+//
+//  LoopCache.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <memory>
+
+#include "LoopCache.h"
+
+namespace {
+    const int kWorkerInterval = 20;     //  msec
+    const uint32_t  kLevelChunkFrames = 64;     //  the level of a cached track is measured in advance
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::LoopCache
+//  ---------------------------------------------------------------------------
+LoopCache::LoopCache(const float samplingRate) :
+maxLoopFrames_(static_cast<uint32_t>(samplingRate * kMaxLoopSeconds)),
+tracks_(kMaxNumberOfTracks),
+renderer_(nullptr),
+isEnabled_(false),
+isWorkerRunning_(false),
+epoch_(0),
+cachedFrames_(0),
+cachedBytes_(0),
+maxBytes_(kDefaultMaxBytes),
+isActive_(false),
+serial_(0),
+retired_(),
+workerMutex_(),
+worker_()
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::~LoopCache
+//  ---------------------------------------------------------------------------
+LoopCache::~LoopCache(void)
+{
+    this->Stop();
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::GetLoopFrames
+//  ---------------------------------------------------------------------------
+bool
+LoopCache::GetLoopFrames(const float stepFrameLength, const int numberOfSteps, uint32_t& loopFrames) const
+{
+    //  The sequencer accumulates the step position in float. Every loop is
+    //  rendered sample by sample identically only if that arithmetic is exact,
+    //  i.e. all positions fit in the mantissa with the fraction of the step
+    //  length, and the loop is an integral number of frames long.
+    const double    stepLength = stepFrameLength;
+    int     fractionalBits = 0;
+    while ((fractionalBits < 24) && (std::floor(std::ldexp(stepLength, fractionalBits)) != std::ldexp(stepLength, fractionalBits)))
+    {
+        ++fractionalBits;
+    }
+    const double    limit = std::ldexp(1.0, 24 - fractionalBits);
+    if ((stepLength + 2.0 >= limit) || (kMaxBlockLength + 1.0 >= limit))
+    {
+        return false;
+    }
+    const double    frames = stepLength * numberOfSteps;
+    if ((frames < 1.0) || (frames > maxLoopFrames_) || (std::floor(frames) != frames))
+    {
+        return false;
+    }
+    loopFrames = static_cast<uint32_t>(frames);
+    return true;
+}
+
+#pragma mark - non real-time
+//  ---------------------------------------------------------------------------
+//      LoopCache::Start
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Start(LoopCacheRenderer* renderer, const bool background)
+{
+    {
+        std::lock_guard<std::mutex> lock(workerMutex_);
+        renderer_ = renderer;
+        isEnabled_.store(true);
+    }
+    if (background && !worker_.joinable())
+    {
+        isWorkerRunning_.store(true);
+        worker_ = std::thread(&LoopCache::RunWorker, this);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Stop
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Stop(void)
+{
+    isEnabled_.store(false);
+    if (worker_.joinable())
+    {
+        isWorkerRunning_.store(false);
+        worker_.join();
+    }
+    this->Clear();
+
+    std::lock_guard<std::mutex> lock(workerMutex_);
+    this->Reclaim(true);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Clear
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Clear(void)
+{
+    std::lock_guard<std::mutex> lock(workerMutex_);
+    for (auto& track : tracks_)
+    {
+        this->Retire(track.rendered.exchange(nullptr));
+        track.renderedSequence = 0;
+    }
+    this->Reclaim(false);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::SetMaxBytes
+//  ---------------------------------------------------------------------------
+void
+LoopCache::SetMaxBytes(const size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(workerMutex_);
+    maxBytes_ = bytes;
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::RunWorker
+//  ---------------------------------------------------------------------------
+void
+LoopCache::RunWorker(void)
+{
+    while (isWorkerRunning_.load())
+    {
+        this->Update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(kWorkerInterval));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Update
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Update(void)
+{
+    std::lock_guard<std::mutex> lock(workerMutex_);
+    if ((renderer_ == nullptr) || !this->IsEnabled())
+    {
+        return;
+    }
+
+    for (int trackNo = 0; trackNo < kMaxNumberOfTracks; ++trackNo)
+    {
+        Track&      track = tracks_[trackNo];
+        LoopInfo    info;
+        uint32_t    sequence;
+        if (!this->ReadObserved(track, info, sequence) || (sequence == track.renderedSequence))
+        {
+            continue;
+        }
+        track.renderedSequence = sequence;
+        const RenderedLoop* current = track.rendered.load(std::memory_order_acquire);
+        if ((current != nullptr) && LoopCache::IsSameLoop(current->info, info))
+        {
+            continue;
+        }
+
+        //  the loop of the track has changed : its buffer is given back to the budget first
+        this->Retire(track.rendered.exchange(nullptr));
+        this->Reclaim(false);
+        const uint32_t  frames = info.key.loopFrames;
+        const uint32_t  numOfChunks = (frames + kLevelChunkFrames - 1) / kLevelChunkFrames;
+        const size_t    bytes = frames * 2 * sizeof(int16_t) + numOfChunks * sizeof(LevelMeter::BlockLevel);
+        if (cachedBytes_.load(std::memory_order_relaxed) + bytes > maxBytes_)
+        {
+            continue;       //  rendered live
+        }
+
+        //  1st pass from the observed state : the voice state at its end is where
+        //  the loop settles. 2nd pass from there, over the 1st, must end in the same state.
+        std::unique_ptr<RenderedLoop>   loop(new RenderedLoop);
+        loop->left.assign(frames, 0);
+        loop->right.assign(frames, 0);
+        if (!renderer_->RenderLoop(trackNo, info, &loop->left[0], &loop->right[0]))
+        {
+            continue;
+        }
+        loop->info = info;
+        if (!renderer_->RenderLoop(trackNo, info, &loop->left[0], &loop->right[0]) ||
+            !LoopCache::IsSameVoice(loop->info, info.isRunning, info.address, info.velocity, info.pitch))
+        {
+            continue;
+        }
+        const LevelMeter::BlockLevel    silence = { 0, 0 };
+        loop->levels.assign(numOfChunks, silence);
+        for (uint32_t chunk = 0; chunk < numOfChunks; ++chunk)
+        {
+            const uint32_t  start = chunk * kLevelChunkFrames;
+            LevelMeter::Measure(loop->left.data() + start, loop->right.data() + start,
+                                std::min(kLevelChunkFrames, frames - start), loop->levels[chunk]);
+        }
+        loop->serial = ++serial_;
+        cachedBytes_.fetch_add(LoopCache::GetBytes(*loop), std::memory_order_relaxed);
+        track.rendered.store(loop.release(), std::memory_order_release);
+    }
+    this->Reclaim(false);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::ReadObserved
+//  ---------------------------------------------------------------------------
+bool
+LoopCache::ReadObserved(Track& track, LoopInfo& info, uint32_t& sequence)
+{
+    while (true)
+    {
+        const uint32_t  before = track.sequence.load(std::memory_order_acquire);
+        if (before == 0)
+        {
+            return false;   //  nothing observed yet
+        }
+        if ((before & 1) == 0)
+        {
+            info = track.observed;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (track.sequence.load(std::memory_order_relaxed) == before)
+            {
+                sequence = before;
+                return true;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::GetBytes                                         [static]
+//  ---------------------------------------------------------------------------
+inline size_t
+LoopCache::GetBytes(const RenderedLoop& loop)
+{
+    return (loop.left.size() + loop.right.size()) * sizeof(int16_t) + loop.levels.size() * sizeof(LevelMeter::BlockLevel);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Retire
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Retire(RenderedLoop* loop)
+{
+    if (loop != nullptr)
+    {
+        retired_.push_back(std::make_pair(loop, epoch_.load()));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Reclaim
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Reclaim(const bool wait)
+{
+    //  a retired loop may still be played by the callback running when it was
+    //  retired. it is freed once that callback has finished.
+    for (int retry = 0; !retired_.empty(); ++retry)
+    {
+        const uint64_t  epoch = epoch_.load();
+        for (auto ite = retired_.begin(); ite != retired_.end();)
+        {
+            if (((ite->second & 1) == 0) || (ite->second != epoch))
+            {
+                cachedBytes_.fetch_sub(LoopCache::GetBytes(*ite->first), std::memory_order_relaxed);
+                delete ite->first;
+                ite = retired_.erase(ite);
+            }
+            else
+            {
+                ++ite;
+            }
+        }
+        if (!wait || (retry >= 1000))
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::IsSameKey                                        [static]
+//  ---------------------------------------------------------------------------
+inline bool
+LoopCache::IsSameKey(const Key& left, const Key& right)
+{
+    return (left.stepFrameLength == right.stepFrameLength) && (left.stepFrame == right.stepFrame) &&
+           (left.numberOfSteps == right.numberOfSteps) && (left.loopFrames == right.loopFrames) &&
+           (left.paramVersion == right.paramVersion) && (left.soundVersion == right.soundVersion);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::IsSameLoop                                       [static]
+//  ---------------------------------------------------------------------------
+bool
+LoopCache::IsSameLoop(const LoopInfo& left, const LoopInfo& right)
+{
+    return LoopCache::IsSameKey(left.key, right.key) && (left.numberOfTriggers == right.numberOfTriggers) &&
+           (::memcmp(left.triggers, right.triggers, left.numberOfTriggers * sizeof(left.triggers[0])) == 0) &&
+           (::memcmp(left.velocities, right.velocities, left.numberOfTriggers * sizeof(left.velocities[0])) == 0) &&
+           (::memcmp(left.pitches, right.pitches, left.numberOfTriggers * sizeof(left.pitches[0])) == 0);
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::IsSameVoice                                      [static]
+//  ---------------------------------------------------------------------------
+//  a stopped voice renders nothing wherever it stopped.
+inline bool
+LoopCache::IsSameVoice(const LoopInfo& info, const bool isRunning, const uint32_t address,
+                       const int32_t velocity, const int32_t pitch)
+{
+    return (info.isRunning == isRunning) &&
+           (!isRunning || ((info.address == address) && (info.velocity == velocity) && (info.pitch == pitch)));
+}
+
+#pragma mark - audio thread
+//  ---------------------------------------------------------------------------
+//      LoopCache::BeginCallback
+//  ---------------------------------------------------------------------------
+bool
+LoopCache::BeginCallback(void)
+{
+    epoch_.fetch_add(1);    //  odd
+    const bool  isEnabled = isEnabled_.load();
+    if (isActive_ && !isEnabled)
+    {
+        for (auto& track : tracks_)
+        {
+            track.isRecording = false;
+            track.playing = nullptr;
+        }
+    }
+    isActive_ = isEnabled;
+    return isActive_;
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::EndCallback
+//  ---------------------------------------------------------------------------
+void
+LoopCache::EndCallback(void)
+{
+    epoch_.fetch_add(1);    //  even
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::GetPlaying
+//  ---------------------------------------------------------------------------
+inline const LoopCache::RenderedLoop*
+LoopCache::GetPlaying(Track& track)
+{
+    //  the loop is valid only while it is published. compare before dereferencing it
+    if ((track.playing != nullptr) &&
+        ((track.playing != track.rendered.load(std::memory_order_acquire)) || (track.playing->serial != track.playingSerial)))
+    {
+        track.playing = nullptr;
+    }
+    return track.playing;
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::StartTrack
+//  ---------------------------------------------------------------------------
+void
+LoopCache::StartTrack(const int trackNo, const uint32_t observedFrames, const Key& key,
+                      const bool isRunning, const uint32_t address, const int32_t velocity, const int32_t pitch)
+{
+    if ((trackNo < 0) || (trackNo >= kMaxNumberOfTracks))
+    {
+        return;
+    }
+    Track&  track = tracks_[trackNo];
+
+    //  publish the loop which has just finished
+    LoopInfo&   recording = track.recording;
+    if (track.isRecording && (recording.key.loopFrames == observedFrames) && LoopCache::IsSameKey(recording.key, key))
+    {
+        const uint32_t  sequence = track.sequence.load(std::memory_order_relaxed);
+        track.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        track.observed.key = recording.key;
+        track.observed.isRunning = recording.isRunning;
+        track.observed.address = recording.address;
+        track.observed.velocity = recording.velocity;
+        track.observed.pitch = recording.pitch;
+        track.observed.numberOfTriggers = recording.numberOfTriggers;
+        ::memcpy(track.observed.triggers, recording.triggers, recording.numberOfTriggers * sizeof(recording.triggers[0]));
+        ::memcpy(track.observed.velocities, recording.velocities, recording.numberOfTriggers * sizeof(recording.velocities[0]));
+        ::memcpy(track.observed.pitches, recording.pitches, recording.numberOfTriggers * sizeof(recording.pitches[0]));
+        track.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    recording.key = key;
+    recording.isRunning = isRunning;
+    recording.address = address;
+    recording.velocity = velocity;
+    recording.pitch = pitch;
+    recording.numberOfTriggers = 0;
+    track.isRecording = (key.loopFrames > 0);
+
+    //  play from the cache if the voice is where the rendered loop starts.
+    track.playing = nullptr;
+    const RenderedLoop* rendered = track.rendered.load(std::memory_order_acquire);
+    if (track.isRecording && (rendered != nullptr) && LoopCache::IsSameKey(rendered->info.key, key) &&
+        LoopCache::IsSameVoice(rendered->info, isRunning, address, velocity, pitch))
+    {
+        track.playing = rendered;
+        track.playingSerial = rendered->serial;
+        track.nextTrigger = 0;
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Trigger
+//  ---------------------------------------------------------------------------
+void
+LoopCache::Trigger(const int trackNo, const uint32_t position, const int32_t velocity, const int32_t pitch)
+{
+    if ((trackNo < 0) || (trackNo >= kMaxNumberOfTracks))
+    {
+        return;
+    }
+    Track&  track = tracks_[trackNo];
+    if (track.isRecording)
+    {
+        LoopInfo&   recording = track.recording;
+        if (recording.numberOfTriggers < kMaxNumberOfTriggers)
+        {
+            recording.triggers[recording.numberOfTriggers] = position;
+            recording.velocities[recording.numberOfTriggers] = velocity;
+            recording.pitches[recording.numberOfTriggers] = pitch;
+            ++recording.numberOfTriggers;
+        }
+        else
+        {
+            track.isRecording = false;
+        }
+    }
+
+    const RenderedLoop* loop = this->GetPlaying(track);
+    if (loop != nullptr)
+    {
+        if ((track.nextTrigger < loop->info.numberOfTriggers) && (loop->info.triggers[track.nextTrigger] == position) &&
+            (loop->info.velocities[track.nextTrigger] == velocity) && (loop->info.pitches[track.nextTrigger] == pitch))
+        {
+            ++track.nextTrigger;
+        }
+        else
+        {
+            track.playing = nullptr;    //  the pattern has been changed
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::Play
+//  ---------------------------------------------------------------------------
+bool
+LoopCache::Play(const int trackNo, int16_t** output, const uint32_t position, const int length,
+                const uint32_t paramVersion, const uint32_t soundVersion, LevelMeter::BlockLevel* mixLevel)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    if ((trackNo < 0) || (trackNo >= kMaxNumberOfTracks))
+    {
+        return false;
+    }
+    Track&  track = tracks_[trackNo];
+    const RenderedLoop* loop = this->GetPlaying(track);
+    if (loop == nullptr)
+    {
+        return false;
+    }
+    const LoopInfo& info = loop->info;
+    const uint32_t  end = position + length;
+    if ((info.key.paramVersion != paramVersion) || (info.key.soundVersion != soundVersion) ||
+        (end > info.key.loopFrames) ||
+        ((track.nextTrigger < info.numberOfTriggers) && (info.triggers[track.nextTrigger] < end)))
+    {
+        track.playing = nullptr;
+        return false;
+    }
+
+    //  the level of the track : only the chunks the block covers partially are measured
+    const int16_t*  srcLeft = loop->left.data();
+    const int16_t*  srcRight = loop->right.data();
+    LevelMeter::BlockLevel  level = { track.peak, 0 };
+    const uint32_t  firstChunk = (position + kLevelChunkFrames - 1) / kLevelChunkFrames;
+    const uint32_t  lastChunk = end / kLevelChunkFrames;
+    if (firstChunk < lastChunk)
+    {
+        const uint32_t  head = firstChunk * kLevelChunkFrames;
+        const uint32_t  tail = lastChunk * kLevelChunkFrames;
+        LevelMeter::Measure(srcLeft + position, srcRight + position, head - position, level);
+        for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+        {
+            const LevelMeter::BlockLevel&   chunkLevel = loop->levels[chunk];
+            level.peak = (chunkLevel.peak > level.peak) ? chunkLevel.peak : level.peak;
+            level.sumOfSquares += chunkLevel.sumOfSquares;
+        }
+        LevelMeter::Measure(srcLeft + tail, srcRight + tail, end - tail, level);
+    }
+    else
+    {
+        LevelMeter::Measure(srcLeft + position, srcRight + position, length, level);
+    }
+    track.peak = level.peak;
+    track.sumOfSquares += level.sumOfSquares;
+
+    //  same saturation and metering as DrumOscillator::Process
+    srcLeft += position;
+    srcRight += position;
+    int16_t*    left = output[0];
+    int16_t*    right = output[1];
+    for (int frame = 0; frame < length; ++frame)
+    {
+        const int32_t   leftOut = left[frame] + srcLeft[frame];
+        const int32_t   rightOut = right[frame] + srcRight[frame];
+        left[frame] = CLIP(leftOut, -0x7FFF, 0x7FFF);
+        right[frame] = CLIP(rightOut, -0x7FFF, 0x7FFF);
+    }
+    if (mixLevel != NULL)
+    {
+        LevelMeter::Measure(left, right, length, *mixLevel);
+    }
+    cachedFrames_.fetch_add(length, std::memory_order_relaxed);
+    return true;
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      LoopCache::TakeLevel
+//  ---------------------------------------------------------------------------
+void
+LoopCache::TakeLevel(const int trackNo, int32_t& peak, uint64_t& sumOfSquares)
+{
+    if ((trackNo < 0) || (trackNo >= kMaxNumberOfTracks))
+    {
+        return;
+    }
+    Track&  track = tracks_[trackNo];
+    peak = (track.peak > peak) ? track.peak : peak;
+    sumOfSquares += track.sumOfSquares;
+    track.peak = 0;
+    track.sumOfSquares = 0;
+}
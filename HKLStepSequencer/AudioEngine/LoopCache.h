@@ -0,0 +1,163 @@
+//
+//  LoopCache.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "LevelMeter.h"
+#include "Sequencer.h"
+
+class LoopCacheRenderer;
+
+//  Pre-rendered loops of each track.
+//
+//  The audio thread observes every loop of every track(the triggers and the
+//  voice state at the loop start) and publishes it at the next loop start.
+//  A background worker renders the observed loop into a buffer. From the next
+//  loop start where the voice is in the same state, the track is played from
+//  the buffer while its oscillator only advances its position(Skip).
+//
+//  The buffer is only used while it is known to be identical to live
+//  rendering : every trigger must come at its cached position, velocity and pitch, the amp/pan/pitch and
+//  the sound set must be unchanged and the loop must not be longer than the
+//  cached one. Otherwise the track falls back to live rendering immediately,
+//  which is seamless because the oscillator state is always up to date.
+//
+//  The loops are limited to kMaxLoopSeconds and their total size to a budget
+//  (kDefaultMaxBytes). When the budget is reached, the tracks without a loop
+//  are rendered live until the others release theirs.
+class LoopCache
+{
+public:
+    enum
+    {
+        kMaxNumberOfTracks = Sequencer::kMaxNumberOfTracks,     //  the tracks after it are rendered live
+        kMaxNumberOfTriggers = 128,         //  per loop
+        kMaxLoopSeconds = 8,
+        kDefaultMaxBytes = 16 * 1024 * 1024,    //  of all the rendered loops
+        kMaxBlockLength = 4096,             //  longest block passed to Synthesizer::ProcessReplacing
+    };
+
+    typedef struct {
+        float       stepFrameLength;
+        float       stepFrame;              //  frames of step 0 already elapsed at the loop start
+        int32_t     numberOfSteps;
+        uint32_t    loopFrames;             //  0 : not cacheable
+        uint32_t    paramVersion;           //  amp & pan of the track
+        uint32_t    soundVersion;
+    } Key;
+
+    typedef struct {
+        Key         key;
+        bool        isRunning;              //  voice state at the loop start
+        uint32_t    address;
+        int32_t     velocity;
+        int32_t     pitch;
+        uint32_t    numberOfTriggers;
+        uint32_t    triggers[kMaxNumberOfTriggers];     //  positions in the loop
+        int32_t     velocities[kMaxNumberOfTriggers];
+        int32_t     pitches[kMaxNumberOfTriggers];
+    } LoopInfo;
+
+    LoopCache(const float samplingRate);
+    ~LoopCache(void);
+
+    bool    GetLoopFrames(const float stepFrameLength, const int numberOfSteps, uint32_t& loopFrames) const;
+
+    //  non real-time
+    void    Start(LoopCacheRenderer* renderer, const bool background);
+    void    Stop(void);
+    bool    IsEnabled(void) const       { return isEnabled_.load(std::memory_order_acquire); }
+    void    Update(void);               //  renders the loops observed since the last call
+    void    Clear(void);
+    /* the loops exceeding it are not rendered. applied to the next ones */
+    void    SetMaxBytes(const size_t bytes);
+    uint64_t    GetNumberOfCachedFrames(void) const     { return cachedFrames_.load(std::memory_order_relaxed); }
+    size_t  GetNumberOfBytes(void) const    { return cachedBytes_.load(std::memory_order_relaxed); }
+
+    //  audio thread
+    bool    BeginCallback(void);        //  false : disabled. nothing else may be called in this callback
+    void    EndCallback(void);
+    void    StartTrack(const int trackNo, const uint32_t observedFrames, const Key& key,
+                       const bool isRunning, const uint32_t address, const int32_t velocity, const int32_t pitch);
+    void    Trigger(const int trackNo, const uint32_t position, const int32_t velocity, const int32_t pitch);
+    /* mixLevel : as DrumOscillator::Process */
+    bool    Play(const int trackNo, int16_t** output, const uint32_t position, const int length,
+                 const uint32_t paramVersion, const uint32_t soundVersion, LevelMeter::BlockLevel* mixLevel);
+    void    TakeLevel(const int trackNo, int32_t& peak, uint64_t& sumOfSquares);
+
+private:
+    LoopCache(const LoopCache& other) = delete;
+    const LoopCache& operator= (const LoopCache& other) = delete;
+
+    typedef struct {
+        uint64_t    serial;
+        LoopInfo    info;               //  voice state : at both ends of the loop
+        std::vector<int16_t>    left;
+        std::vector<int16_t>    right;
+        std::vector<LevelMeter::BlockLevel> levels;     //  of each kLevelChunkFrames
+    } RenderedLoop;
+
+    struct Track {
+        //  audio thread
+        LoopInfo    recording;
+        bool        isRecording = false;
+        const RenderedLoop* playing = nullptr;
+        uint64_t    playingSerial = 0;
+        uint32_t    nextTrigger = 0;
+        int32_t     peak = 0;
+        uint64_t    sumOfSquares = 0;
+        //  audio thread -> worker
+        std::atomic<uint32_t>   sequence;
+        LoopInfo    observed;
+        //  worker -> audio thread
+        std::atomic<RenderedLoop*>  rendered;
+        //  worker
+        uint32_t    renderedSequence = 0;   //  sequence of the last observation tried
+
+        Track(void) : sequence(0), rendered(nullptr) {}
+    };
+
+    static bool IsSameLoop(const LoopInfo& left, const LoopInfo& right);
+    static bool IsSameVoice(const LoopInfo& info, const bool isRunning, const uint32_t address,
+                            const int32_t velocity, const int32_t pitch);
+    static bool IsSameKey(const Key& left, const Key& right);
+    bool    ReadObserved(Track& track, LoopInfo& info, uint32_t& sequence);
+    const RenderedLoop* GetPlaying(Track& track);
+    static size_t   GetBytes(const RenderedLoop& loop);
+    void    Retire(RenderedLoop* loop);
+    void    Reclaim(const bool wait);
+    void    RunWorker(void);
+
+    const uint32_t  maxLoopFrames_;
+    std::vector<Track>  tracks_;
+    LoopCacheRenderer*  renderer_;
+    std::atomic<bool>   isEnabled_;
+    std::atomic<bool>   isWorkerRunning_;
+    std::atomic<uint64_t>   epoch_;         //  odd while the audio thread is in a callback
+    std::atomic<uint64_t>   cachedFrames_;
+    std::atomic<size_t>     cachedBytes_;   //  published and retired loops
+    size_t      maxBytes_;
+    bool        isActive_;              //  audio thread
+    uint64_t    serial_;
+    std::vector< std::pair<RenderedLoop*, uint64_t> >   retired_;
+    std::mutex  workerMutex_;
+    std::thread worker_;
+};
+
+//  Renders a loop of a track on the worker thread
+class LoopCacheRenderer
+{
+public:
+    virtual ~LoopCacheRenderer(void)    {}
+    /* starts at the voice state in info and updates it to the state at the end */
+    virtual bool    RenderLoop(const int trackNo, LoopCache::LoopInfo& info, int16_t* left, int16_t* right) = 0;
+};
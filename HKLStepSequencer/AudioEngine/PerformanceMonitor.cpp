@@ -0,0 +1,223 @@
+//
+//  PerformanceMonitor.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include "HostClock.h"
+#include "PerformanceMonitor.h"
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::PerformanceMonitor
+//  ---------------------------------------------------------------------------
+PerformanceMonitor::PerformanceMonitor(void) :
+timebaseNumer_(1),
+timebaseDenom_(1),
+callbackStart_(0),
+resetRequested_(false),
+counters_(),
+sequence_(0)
+{
+    HostClock::GetTimebase(timebaseNumer_, timebaseDenom_);
+    this->ClearCounters();
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::~PerformanceMonitor
+//  ---------------------------------------------------------------------------
+PerformanceMonitor::~PerformanceMonitor(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::Now                                     [static]
+//  ---------------------------------------------------------------------------
+uint64_t
+PerformanceMonitor::Now(void)
+{
+    return HostClock::Now();
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::TicksToNanosec
+//  ---------------------------------------------------------------------------
+inline uint64_t
+PerformanceMonitor::TicksToNanosec(const uint64_t ticks) const
+{
+    return ticks * timebaseNumer_ / timebaseDenom_;
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::ClearCounters
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::ClearCounters(void)
+{
+    counters_ = Snapshot();
+    this->Publish();
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::Publish
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::Publish(void)
+{
+    //  odd while writing
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    numberOfCallbacks_.store(counters_.numberOfCallbacks, std::memory_order_relaxed);
+    numberOfDeadlineMisses_.store(counters_.numberOfDeadlineMisses, std::memory_order_relaxed);
+    for (int bin = 0; bin < kNumberOfHistogramBins; ++bin)
+    {
+        callbackHistogram_[bin].store(counters_.callbackHistogram[bin], std::memory_order_relaxed);
+    }
+    lastCallbackNanosec_.store(counters_.lastCallbackNanosec, std::memory_order_relaxed);
+    maxCallbackNanosec_.store(counters_.maxCallbackNanosec, std::memory_order_relaxed);
+    totalCallbackNanosec_.store(counters_.totalCallbackNanosec, std::memory_order_relaxed);
+    sequencerTicks_.store(counters_.sequencerNanosec, std::memory_order_relaxed);
+    renderTicks_.store(counters_.renderNanosec, std::memory_order_relaxed);
+    numberOfEvents_.store(counters_.numberOfEvents, std::memory_order_relaxed);
+    activeVoices_.store(counters_.activeVoices, std::memory_order_relaxed);
+    maxActiveVoices_.store(counters_.maxActiveVoices, std::memory_order_relaxed);
+
+    //  even when published
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+#pragma mark - audio thread
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::BeginCallback
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::BeginCallback(void)
+{
+    if (resetRequested_.load(std::memory_order_acquire))
+    {
+        this->ClearCounters();
+        resetRequested_.store(false, std::memory_order_release);
+    }
+    callbackStart_ = PerformanceMonitor::Now();
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::EndCallback
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::EndCallback(const uint32_t frames, const float samplingRate)
+{
+    const uint64_t  elapsed = this->TicksToNanosec(PerformanceMonitor::Now() - callbackStart_);
+    const uint64_t  deadline = static_cast<uint64_t>(static_cast<double>(frames) * 1000000000.0 / samplingRate);
+
+    //  floor(log2(usec))
+    uint64_t    usec = elapsed / 1000;
+    int         bin = 0;
+    while ((usec > 1) && (bin < kNumberOfHistogramBins - 1))
+    {
+        usec >>= 1;
+        ++bin;
+    }
+
+    ++counters_.numberOfCallbacks;
+    ++counters_.callbackHistogram[bin];
+    counters_.totalCallbackNanosec += elapsed;
+    if (elapsed > deadline)
+    {
+        ++counters_.numberOfDeadlineMisses;
+    }
+    counters_.lastCallbackNanosec = elapsed;
+    if (elapsed > counters_.maxCallbackNanosec)
+    {
+        counters_.maxCallbackNanosec = elapsed;
+    }
+    this->Publish();
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::AddSequencerTime
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::AddSequencerTime(const uint64_t ticks)
+{
+    counters_.sequencerNanosec += ticks;
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::AddRenderTime
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::AddRenderTime(const uint64_t ticks)
+{
+    counters_.renderNanosec += ticks;
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::AddEvents
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::AddEvents(const uint32_t count)
+{
+    counters_.numberOfEvents += count;
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::SetActiveVoices
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::SetActiveVoices(const uint32_t count)
+{
+    counters_.activeVoices = count;
+    if (count > counters_.maxActiveVoices)
+    {
+        counters_.maxActiveVoices = count;
+    }
+}
+
+#pragma mark - any thread
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::GetSnapshot
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::GetSnapshot(Snapshot& snapshot) const
+{
+    uint64_t    sequencerTicks;
+    uint64_t    renderTicks;
+    while (true)
+    {
+        const uint32_t  before = sequence_.load(std::memory_order_acquire);
+        snapshot.numberOfCallbacks = numberOfCallbacks_.load(std::memory_order_relaxed);
+        snapshot.numberOfDeadlineMisses = numberOfDeadlineMisses_.load(std::memory_order_relaxed);
+        for (int bin = 0; bin < kNumberOfHistogramBins; ++bin)
+        {
+            snapshot.callbackHistogram[bin] = callbackHistogram_[bin].load(std::memory_order_relaxed);
+        }
+        snapshot.lastCallbackNanosec = lastCallbackNanosec_.load(std::memory_order_relaxed);
+        snapshot.maxCallbackNanosec = maxCallbackNanosec_.load(std::memory_order_relaxed);
+        snapshot.totalCallbackNanosec = totalCallbackNanosec_.load(std::memory_order_relaxed);
+        sequencerTicks = sequencerTicks_.load(std::memory_order_relaxed);
+        renderTicks = renderTicks_.load(std::memory_order_relaxed);
+        snapshot.numberOfEvents = numberOfEvents_.load(std::memory_order_relaxed);
+        snapshot.activeVoices = activeVoices_.load(std::memory_order_relaxed);
+        snapshot.maxActiveVoices = maxActiveVoices_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint32_t  after = sequence_.load(std::memory_order_relaxed);
+        if (((before & 1) == 0) && (before == after))
+        {
+            break;
+        }
+    }
+    snapshot.sequencerNanosec = this->TicksToNanosec(sequencerTicks);
+    snapshot.renderNanosec = this->TicksToNanosec(renderTicks);
+}
+
+//  ---------------------------------------------------------------------------
+//      PerformanceMonitor::Reset
+//  ---------------------------------------------------------------------------
+void
+PerformanceMonitor::Reset(void)
+{
+    resetRequested_.store(true, std::memory_order_release);
+}
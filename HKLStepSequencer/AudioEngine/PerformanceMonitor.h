@@ -0,0 +1,85 @@
+//
+//  PerformanceMonitor.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+//  Real-time telemetry of the render path.
+//  The audio thread is the only writer. Every method it calls is lock-free and
+//  allocation-free. The counters are published at the end of each callback
+//  through a seqlock, so that GetSnapshot() returns a consistent set of them
+//  from any thread.
+class PerformanceMonitor
+{
+public:
+    /* bin N counts callbacks which took [2^N, 2^(N+1)) usec. bin 0 and the last bin also count shorter/longer ones. */
+    enum { kNumberOfHistogramBins = 16 };
+
+    typedef struct {
+        uint64_t    numberOfCallbacks;
+        uint64_t    numberOfDeadlineMisses;     //  callbacks longer than the duration of their buffer
+        uint64_t    callbackHistogram[kNumberOfHistogramBins];
+        uint64_t    lastCallbackNanosec;
+        uint64_t    maxCallbackNanosec;
+        uint64_t    totalCallbackNanosec;
+        uint64_t    sequencerNanosec;           //  total time spent in Sequencer::Process
+        uint64_t    renderNanosec;              //  total time spent in voice rendering
+        uint64_t    numberOfEvents;             //  total sequencer events decoded
+        uint32_t    activeVoices;
+        uint32_t    maxActiveVoices;
+    } Snapshot;
+
+    PerformanceMonitor(void);
+    ~PerformanceMonitor(void);
+
+    static uint64_t Now(void);
+
+    //  audio thread
+    void    BeginCallback(void);
+    void    EndCallback(const uint32_t frames, const float samplingRate);
+    void    AddSequencerTime(const uint64_t ticks);
+    void    AddRenderTime(const uint64_t ticks);
+    void    AddEvents(const uint32_t count);
+    void    SetActiveVoices(const uint32_t count);
+
+    //  any thread
+    void    GetSnapshot(Snapshot& snapshot) const;
+    void    Reset(void);    //  applied at the beginning of the next callback
+
+private:
+    PerformanceMonitor(const PerformanceMonitor& other) = delete;
+    const PerformanceMonitor& operator= (const PerformanceMonitor& other) = delete;
+
+    uint64_t    TicksToNanosec(const uint64_t ticks) const;
+    void        ClearCounters(void);
+
+    void        Publish(void);
+
+    uint32_t    timebaseNumer_;
+    uint32_t    timebaseDenom_;
+    uint64_t    callbackStart_;
+    std::atomic<bool>       resetRequested_;
+
+    //  audio thread only. sequencerNanosec/renderNanosec : ticks
+    Snapshot    counters_;
+
+    //  published : written between two increments of sequence_(odd while writing)
+    std::atomic<uint32_t>   sequence_;
+    std::atomic<uint64_t>   numberOfCallbacks_;
+    std::atomic<uint64_t>   numberOfDeadlineMisses_;
+    std::atomic<uint64_t>   callbackHistogram_[kNumberOfHistogramBins];
+    std::atomic<uint64_t>   lastCallbackNanosec_;
+    std::atomic<uint64_t>   maxCallbackNanosec_;
+    std::atomic<uint64_t>   totalCallbackNanosec_;
+    std::atomic<uint64_t>   sequencerTicks_;
+    std::atomic<uint64_t>   renderTicks_;
+    std::atomic<uint64_t>   numberOfEvents_;
+    std::atomic<uint32_t>   activeVoices_;
+    std::atomic<uint32_t>   maxActiveVoices_;
+};
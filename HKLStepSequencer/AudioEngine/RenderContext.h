@@ -0,0 +1,34 @@
+//
+//  RenderContext.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+
+//  The audio I/O as seen by the engine during a render callback : when the
+//  callback is heard and where its cost is measured. AudioIO implements it on
+//  the device. Offline renders(tests, TraceReplayer) pass NULL, so the engine
+//  builds without the platform audio API.
+class RenderContext
+{
+public:
+    virtual ~RenderContext(void)    {}
+    /* HostClock time of the first frame of the callback */
+    virtual uint64_t    GetHostTime(void) const = 0;
+    /* nanosec of the I/O buffer */
+    virtual uint64_t    GetLatency(void) const = 0;
+    /* nanosec from rendering a frame to hearing it : I/O buffer + hardware output */
+    virtual uint64_t    GetPlaybackLatency(void) const = 0;
+    virtual class PerformanceMonitor&   GetPerformanceMonitor(void) = 0;
+};
+
+class AudioIOListener
+{
+public:
+    virtual ~AudioIOListener(void)    {}
+    virtual void ProcessReplacing(RenderContext* io, int16_t** buffer, const uint32_t length) = 0;
+};
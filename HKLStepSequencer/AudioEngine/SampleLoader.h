@@ -0,0 +1,24 @@
+//
+//  SampleLoader.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//  Reads a sound for DrumOscillator as 16bit mono PCM. The engine reads its
+//  sounds only through it : BundleSampleLoader reads the app bundle with
+//  ExtAudioFile, WavSampleLoader is a portable WAV reader.
+//  Load() may be called from several threads at the same time.
+class SampleLoader
+{
+public:
+    virtual ~SampleLoader(void)     {}
+    /* pcmData : the frames of the sound. false : not found, or not 16bit mono PCM */
+    virtual bool    Load(const std::string& filename, std::vector<int16_t>& pcmData, float& samplingRate) const = 0;
+};
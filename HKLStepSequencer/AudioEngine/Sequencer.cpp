@@ -6,35 +6,83 @@
 //  Copyright 2011 KORG INC. All rights reserved.
 //
 
+#include <cmath>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <algorithm>
 
-#include <mach/mach_time.h>
-
+#include "HostClock.h"
 #include "Sequencer.h"
-#include "AudioIO.h"
+#include "RenderContext.h"
+#include "TraceRecorder.h"
+#include "ClockSync.h"
 
 //  ---------------------------------------------------------------------------
 //      Sequencer::Sequencer
 //  ---------------------------------------------------------------------------
 Sequencer::Sequencer(float samplingRate, int numberOfTracks, int numberOfSteps, int stepsPerBeat) :
 samplingRate_(samplingRate),
-numberOfTracks_(numberOfTracks),
-numberOfSteps_(numberOfSteps),
+numberOfTracks_(std::max(numberOfTracks, 0)),
+requestedNumberOfTracks_(numberOfTracks_),
+numberOfSteps_(std::min<int>(numberOfSteps, kMaxNumberOfSteps)),
+requestedNumberOfSteps_(numberOfSteps_),
 stepsPerBeat_(stepsPerBeat),
 isRunning_(false),
 currentStep_(0),
 stepFrameLength_(0),
 currentFrame_(0),
 trigger_(false),
+maxNumberOfTracks_(std::max<int>(numberOfTracks_, kMaxNumberOfTracks)),
 seq_(),
+latestSeq_(),
+pendingSeq_(),
+hasPendingSeq_(false),
+pendingNumberOfTracks_(-1),
+pendingNumberOfSteps_(-1),
+patternsMutex_(),
+pendingMutex_(),
+lanes_(),
+latestLanes_(),
+pendingLanes_(),
+hasPendingLanes_(false),
+randomTracks_(),
+delayedTracks_(),
+editedLanes_(),
+stalePendingLanes_(),
+staleLanes_(),
+randomSeed_(0),
+loopCount_(0),
+sequenceFrame_(0),
+callbackFrame_(0),
+delayedTriggers_(),
+triggeredTracks_(),
+triggeredVelocities_(),
+triggeredPitches_(),
+delayedTrack_(),
+delayedVelocity_(),
+delayedPitch_(),
 commands_(),
 listeners_(),
-commandsMutex_()
+commandsMutex_(),
+numberOfCommands_(0),
+timebaseNumer_(1),
+timebaseDenom_(1),
+recorder_(NULL),
+clockSync_(NULL)
 {
-    // 各ステップの再生有無をstd::vector<bool>で記憶するトラックを4本作成
+    HostClock::GetTimebase(timebaseNumer_, timebaseDenom_);
+
+    // 各ステップの再生有無をビットで記憶するトラックを確保
     SetupTracks();
+    triggeredTracks_.reserve(maxNumberOfTracks_);
+    triggeredVelocities_.reserve(maxNumberOfTracks_);
+    triggeredPitches_.reserve(maxNumberOfTracks_);
+    delayedTrack_.reserve(1);
+    delayedVelocity_.reserve(1);
+    delayedPitch_.reserve(1);
+    //  a delay is shorter than a step : a track has at most one pending trigger(two across a tempo change)
+    delayedTriggers_.reserve(maxNumberOfTracks_ * 2);
 }
 
 //  ---------------------------------------------------------------------------
@@ -50,12 +98,41 @@ Sequencer::~Sequencer(void)
 void
 Sequencer::SetupTracks()
 {
-    seq_.clear();
-    for (int trackNo = 0; trackNo < numberOfTracks_; ++trackNo)
+    //  all the preallocated tracks, so that tracks can be added without allocation.
+    //  the buffers are swapped on commit, so they all have the same size.
+    const size_t    numOfWords = static_cast<size_t>(maxNumberOfTracks_) * kWordsPerTrack;
+    seq_.assign(numOfWords, 0);
+    latestSeq_.assign(numOfWords, 0);
+    pendingSeq_.assign(numOfWords, 0);
+
+    const size_t    numOfSteps = static_cast<size_t>(maxNumberOfTracks_) * kMaxNumberOfSteps;
+    for (StepLanes* lanes : { &lanes_, &latestLanes_, &pendingLanes_ })
     {
-        std::vector<bool>   partSeq(numberOfSteps_, false);
-        seq_.push_back(partSeq);
+        lanes->velocities.assign(numOfSteps, kVelocityUnity);
+        lanes->probabilities.assign(numOfSteps, kProbabilityAlways);
+        lanes->delays.assign(numOfSteps, 0);
+        lanes->pitches.assign(numOfSteps, 0);
+        lanes->isRandom.assign(kMaxNumberOfSteps, 0);
+        lanes->isDelayed.assign(kMaxNumberOfSteps, 0);
     }
+    randomTracks_.assign(kMaxNumberOfSteps, 0);
+    delayedTracks_.assign(kMaxNumberOfSteps, 0);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::Hash                                             [static]
+//  ---------------------------------------------------------------------------
+//  stateless 32bit integer hash(xorshift-multiply finalizer). the same input
+//  always gives the same dice on any thread, so a seeded run is reproducible.
+inline uint32_t
+Sequencer::Hash(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
 }
 
 enum
@@ -64,8 +141,20 @@ enum
     kSeqCommand_Stop,
     kSeqCommand_UpdateTempo,
     kSeqCommand_UpdateNumSteps,
+    kSeqCommand_UpdateNumTracks,
+    kSeqCommand_SyncStepLength,     //  made by the clock sync. after the others at the same frame
+    kSeqCommand_SyncPosition,
 };
 
+//  the clock sync catches up the errors in kClockCatchUpSteps steps, at most
+//  kClockMaxSlew faster or slower than the clock. larger errors are relocated.
+static const double kClockCatchUpSteps = 4.0;
+static const double kClockMaxSlew = 0.02;
+static const double kClockRelocationSteps = 0.125;
+//  step length corrections smaller than kClockMinSlew are neither applied nor recorded.
+//  the error they leave is caught up by a later one
+static const double kClockMinSlew = 0.002;
+
 //  ---------------------------------------------------------------------------
 //      Sequencer::ProcessCommand
 //  ---------------------------------------------------------------------------
@@ -83,12 +172,15 @@ Sequencer::ProcessCommand(SeqCommandEvent& event)
                 stepFrameLength_ = samplingRate_ * 60.0f / tempo / stepsPerBeat_;
                 trigger_ = true;
                 isRunning_ = true;
+                loopCount_ = 0;
+                delayedTriggers_.clear();
             }
             break;
         case kSeqCommand_Stop:
             if (isRunning_)
             {
                 isRunning_ = false;
+                delayedTriggers_.clear();
             }
             break;
         case kSeqCommand_UpdateTempo:
@@ -100,11 +192,32 @@ Sequencer::ProcessCommand(SeqCommandEvent& event)
             break;
         case kSeqCommand_UpdateNumSteps:
             if (1) {
+                //  the removed steps have been cleared by UpdateNumSteps()
                 const int numberOfSteps = static_cast<int>(event.floatValue);
-                if (numberOfSteps != numberOfSteps_) {
-                    numberOfSteps_ = numberOfSteps;
-                    SetupTracks();
-                }
+                numberOfSteps_ = std::min<int>(std::max<int>(numberOfSteps, 0), kMaxNumberOfSteps);
+            }
+            break;
+        case kSeqCommand_UpdateNumTracks:
+            //  the added tracks have been cleared by UpdateNumTracks()
+            numberOfTracks_ = std::min<int>(std::max<int>(event.floatValue, 0), maxNumberOfTracks_);
+            break;
+        case kSeqCommand_SyncStepLength:
+            if (isRunning_ && (event.floatValue > 0))
+            {
+                //  the position in the step is kept
+                currentFrame_ = currentFrame_ * event.floatValue / stepFrameLength_;
+                stepFrameLength_ = event.floatValue;
+            }
+            break;
+        case kSeqCommand_SyncPosition:
+            if (isRunning_)
+            {
+                //  the step started before this frame is not triggered
+                const float position = event.floatValue;
+                currentStep_ = static_cast<int>(position);
+                currentFrame_ = (position - currentStep_) * stepFrameLength_;
+                currentStep_ = (currentStep_ < numberOfSteps_) ? currentStep_ : 0;
+                trigger_ = (currentFrame_ <= 0);
             }
             break;
         default:
@@ -116,17 +229,16 @@ Sequencer::ProcessCommand(SeqCommandEvent& event)
 //      Sequencer::ProcessCommands
 //  ---------------------------------------------------------------------------
 inline int
-Sequencer::ProcessCommands(AudioIO* io, int offset, int length)
+Sequencer::ProcessCommands(RenderContext* io, int offset, int length)
 {
-    if (!commands_.empty())
+    if (numberOfCommands_.load(std::memory_order_acquire) > 0)
     {
         const uint64_t  hostTime = (io != NULL) ? io->GetHostTime() : 0;
         const uint64_t  latency = (io != NULL) ? io->GetLatency() : 0;
-        mach_timebase_info_data_t timeInfo;
-        ::mach_timebase_info(&timeInfo);
+        //  never wait for the UI thread. the commands are retried at the next call
+        std::unique_lock<std::mutex> lock(commandsMutex_, std::try_to_lock);
+        if (lock.owns_lock())
         {
-            std::lock_guard<std::mutex> lock(commandsMutex_);
-            std::sort(commands_.begin(), commands_.end(), Sequencer::SortEventFunctor);
             for (auto ite = commands_.begin(); ite != commands_.end();)
             {
                 bool    doProcess = false;
@@ -137,13 +249,14 @@ Sequencer::ProcessCommands(AudioIO* io, int offset, int length)
                 else if (io != NULL)
                 {
                     const int64_t   delta = ite->hostTime - hostTime;
-                    const int64_t   deltaNanosec = delta * timeInfo.numer / timeInfo.denom + latency;
+                    const int64_t   deltaNanosec = delta * timebaseNumer_ / timebaseDenom_ + latency;
                     const int32_t   sampleOffset = static_cast<int32_t>(static_cast<double>(deltaNanosec) * samplingRate_ / 1000000000);
                     if (sampleOffset < offset + length)
                     {
                         const int   eventFrame = sampleOffset - offset;
                         if (eventFrame > 0)
                         {
+                            numberOfCommands_.store(commands_.size(), std::memory_order_release);
                             return eventFrame;
                         }
                         doProcess = true;
@@ -151,6 +264,10 @@ Sequencer::ProcessCommands(AudioIO* io, int offset, int length)
                 }
                 if (doProcess)
                 {
+                    if (recorder_ != NULL)
+                    {
+                        recorder_->RecordAt(offset, TraceRecorder::kTraceType_Command, ite->command, 0, ite->floatValue);
+                    }
                     this->ProcessCommand(*ite);
                     ite = commands_.erase(ite);
                 }
@@ -159,20 +276,77 @@ Sequencer::ProcessCommands(AudioIO* io, int offset, int length)
                     ++ite;
                 }
             }
+            numberOfCommands_.store(commands_.size(), std::memory_order_release);
         }
     }
     return length;
 }
 
+//  ---------------------------------------------------------------------------
+//      Sequencer::ProcessClockSync
+//  ---------------------------------------------------------------------------
+//  follows the clock from the beginning of a callback. the corrections are
+//  commands, so that a trace replays them without the clock.
+inline void
+Sequencer::ProcessClockSync(RenderContext* io)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    if (!clockSync_->Update(io, callbackFrame_) || !isRunning_ || (numberOfSteps_ <= 0) || (stepFrameLength_ <= 0))
+    {
+        return;
+    }
+    const double    ticksPerStep = static_cast<double>(ClockSync::kTicksPerBeat) / stepsPerBeat_;
+    const double    stepLength = clockSync_->GetTickFrameLength() * ticksPerStep;
+    const double    numOfSteps = numberOfSteps_;
+    double  clock = std::fmod(clockSync_->GetPosition(callbackFrame_) / ticksPerStep, numOfSteps);
+    clock += (clock < 0) ? numOfSteps : 0;
+
+    //  steps the sequencer is behind the clock, in [-numberOfSteps / 2, numberOfSteps / 2)
+    double  error = clock - (currentStep_ + currentFrame_ / stepFrameLength_);
+    error -= numOfSteps * std::floor(error / numOfSteps + 0.5);
+    if (std::fabs(error) > kClockRelocationSteps)
+    {
+        this->ApplyCommand(kSeqCommand_SyncStepLength, static_cast<float>(stepLength));
+        this->ApplyCommand(kSeqCommand_SyncPosition, static_cast<float>(clock));
+        clockSync_->AddRelocation();
+        return;
+    }
+    clockSync_->AddError(error * stepLength);
+    const double    catchUp = error / kClockCatchUpSteps;
+    const double    slew = CLIP(catchUp, -kClockMaxSlew, kClockMaxSlew);
+    const float     length = static_cast<float>(stepLength / (1.0 + slew));
+    if (std::fabs(length - stepFrameLength_) >= kClockMinSlew * length)
+    {
+        this->ApplyCommand(kSeqCommand_SyncStepLength, length);
+    }
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ApplyCommand
+//  ---------------------------------------------------------------------------
+//  audio thread, at the frame 0 : recorded so that a trace replays it there
+inline void
+Sequencer::ApplyCommand(const int cmd, const float param0)
+{
+    SeqCommandEvent event = { 0, cmd, param0 };
+    if (recorder_ != NULL)
+    {
+        recorder_->RecordAt(0, TraceRecorder::kTraceType_Command, cmd, 0, param0);
+    }
+    this->ProcessCommand(event);
+}
+
 //  ---------------------------------------------------------------------------
 //      Sequencer::ProcessTrigger
 //  ---------------------------------------------------------------------------
 inline void
-Sequencer::ProcessTrigger(int offset, const std::vector<int> &trackIndexes)
+Sequencer::ProcessTrigger(int offset, const std::vector<int> &trackIndexes, const std::vector<int32_t> &velocities,
+                          const std::vector<int32_t> &pitches, int step)
 {
     for (auto listener : listeners_)
     {
-        listener->NoteOnViaSequencer(offset + currentFrame_, trackIndexes, currentStep_);
+        listener->NoteOnViaSequencer(offset, trackIndexes, velocities, pitches, step);
     }
 }
 
@@ -184,20 +358,95 @@ Sequencer::ProcessTrigger(int offset)
 {
     if (trigger_ && (currentFrame_ >= 0))
     {
+        if (currentStep_ == 0)
+        {
+            for (auto listener : listeners_)
+            {
+                listener->LoopStartViaSequencer(offset + currentFrame_, stepFrameLength_, currentFrame_, numberOfSteps_);
+            }
+        }
         if ((currentStep_ >= 0) && (currentStep_ < numberOfSteps_))
         {
             // ここでONトラック(int)だけを集めてProcessTriggerに渡す
-            std::vector<int> triggeredTracks;
-            const int   numOfTrack = static_cast<const int>(seq_.size());
-            for (int trackNo = 0; trackNo < numOfTrack; ++trackNo)
+            //  branch-free compaction : every track is written and only the fired ones are counted
+            const int       step = currentStep_;
+            const uint32_t* partSeq = &seq_[step / 32];
+            const int       shift = step % 32;
+            const int       numOfTracks = numberOfTracks_;      //  not reloaded through the stores below
+            std::vector<int>&   triggeredTracks = triggeredTracks_;   //  reserved : never reallocated
+            std::vector<int32_t>&   triggeredVelocities = triggeredVelocities_;
+            std::vector<int32_t>&   triggeredPitches = triggeredPitches_;
+            triggeredTracks.resize(numOfTracks);
+            int*    fired = triggeredTracks.data();     //  no track : never dereferenced
+            int     numOfFired = 0;
+            if (!lanes_.isRandom[step])
             {
-                const auto&   partSeq = seq_[trackNo];
-                if (partSeq[currentStep_])
+                for (int trackNo = 0; trackNo < numOfTracks; ++trackNo)
                 {
-                    triggeredTracks.push_back(trackNo);
+                    fired[numOfFired] = trackNo;
+                    numOfFired += (partSeq[trackNo * kWordsPerTrack] >> shift) & 1;
+                }
+            }
+            else
+            {
+                //  15bit dice of (seed, loop, step, track) against the Q15 probability
+                const uint16_t* probabilities = &lanes_.probabilities[step * maxNumberOfTracks_];
+                const uint32_t  stepHash = Sequencer::Hash(randomSeed_.load(std::memory_order_relaxed) ^
+                                                           Sequencer::Hash(loopCount_ * kMaxNumberOfSteps + step));
+                for (int trackNo = 0; trackNo < numOfTracks; ++trackNo)
+                {
+                    const uint32_t  isOn = (partSeq[trackNo * kWordsPerTrack] >> shift) & 1;
+                    const uint32_t  dice = Sequencer::Hash(stepHash + trackNo) >> 17;
+                    fired[numOfFired] = trackNo;
+                    numOfFired += isOn & static_cast<uint32_t>(dice < probabilities[trackNo]);
+                }
+            }
+            triggeredTracks.resize(numOfFired);
+            triggeredVelocities.resize(numOfFired);
+            triggeredPitches.resize(numOfFired);
+
+            //  gather the velocities & pitches of the fired tracks. the delayed ones are queued
+            const int       frame = offset + currentFrame_;
+            const uint16_t* velocities = &lanes_.velocities[step * maxNumberOfTracks_];
+            const int8_t*   pitches = &lanes_.pitches[step * maxNumberOfTracks_];
+            int32_t*    hitVelocities = triggeredVelocities.data();
+            int32_t*    hitPitches = triggeredPitches.data();
+            if (!lanes_.isDelayed[step])
+            {
+                for (int index = 0; index < numOfFired; ++index)
+                {
+                    hitVelocities[index] = velocities[fired[index]];
+                    hitPitches[index] = pitches[fired[index]];
+                }
+            }
+            else
+            {
+                const uint8_t*  delays = &lanes_.delays[step * maxNumberOfTracks_];
+                int     numOnTime = 0;
+                for (int index = 0; index < numOfFired; ++index)
+                {
+                    const int   trackNo = fired[index];
+                    const int   delay = delays[trackNo];
+                    if ((delay == 0) || (delayedTriggers_.size() >= delayedTriggers_.capacity()))
+                    {
+                        fired[numOnTime] = trackNo;
+                        hitVelocities[numOnTime] = velocities[trackNo];
+                        hitPitches[numOnTime] = pitches[trackNo];
+                        ++numOnTime;
+                    }
+                    else
+                    {
+                        const uint64_t  delayFrames = static_cast<uint64_t>(delay * stepFrameLength_ / kDelayResolution);
+                        const DelayedTrigger    trigger = { callbackFrame_ + frame + delayFrames, trackNo, step,
+                                                            velocities[trackNo], pitches[trackNo] };
+                        delayedTriggers_.push_back(trigger);
+                    }
                 }
+                triggeredTracks.resize(numOnTime);
+                triggeredVelocities.resize(numOnTime);
+                triggeredPitches.resize(numOnTime);
             }
-            this->ProcessTrigger(offset, triggeredTracks);
+            this->ProcessTrigger(frame, triggeredTracks, triggeredVelocities, triggeredPitches, step);
         }
         trigger_ = false;
     }
@@ -225,26 +474,77 @@ Sequencer::ProcessSequence(int offset, int length)
             if (currentStep_ > numberOfSteps_ - 1)
             {
                 currentStep_ = 0;
+                ++loopCount_;
             }
             trigger_ = true;
         }
     }
 }
 
+//  ---------------------------------------------------------------------------
+//      Sequencer::ProcessDelayedTriggers
+//  ---------------------------------------------------------------------------
+inline void
+Sequencer::ProcessDelayedTriggers(int offset, int length)
+{
+    const uint64_t  end = callbackFrame_ + offset + length;
+    for (size_t index = 0; index < delayedTriggers_.size();)
+    {
+        const DelayedTrigger    trigger = delayedTriggers_[index];
+        if (trigger.frame < end)
+        {
+            delayedTrack_.assign(1, trigger.trackNo);
+            delayedVelocity_.assign(1, trigger.velocity);
+            delayedPitch_.assign(1, trigger.pitch);
+            this->ProcessTrigger(static_cast<int>(trigger.frame - callbackFrame_), delayedTrack_, delayedVelocity_,
+                                 delayedPitch_, trigger.step);
+            delayedTriggers_[index] = delayedTriggers_.back();
+            delayedTriggers_.pop_back();
+        }
+        else
+        {
+            ++index;
+        }
+    }
+}
+
 //  ---------------------------------------------------------------------------
 //      Sequencer::Process
 //  ---------------------------------------------------------------------------
 int
-Sequencer::Process(AudioIO* io, int offset, int length)
+Sequencer::Process(RenderContext* io, int offset, int length)
 {
+    //  pattern edits take effect from the beginning of a callback
+    if ((offset == 0) &&
+        (hasPendingSeq_.load(std::memory_order_acquire) || hasPendingLanes_.load(std::memory_order_acquire)))
+    {
+        this->TakePendingPatterns();
+    }
+    callbackFrame_ = sequenceFrame_ - offset;
     const int   result = this->ProcessCommands(io, offset, length);
+    //  after the commands at the frame 0, in the order a trace replays them
+    if ((offset == 0) && (clockSync_ != NULL))
+    {
+        this->ProcessClockSync(io);
+    }
     if (isRunning_ && (result > 0))
     {
         this->ProcessSequence(offset, result);
+        this->ProcessDelayedTriggers(offset, result);
     }
+    sequenceFrame_ += std::max<int>(result, 0);
     return result;
 }
 
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetClockSync
+//  ---------------------------------------------------------------------------
+void
+Sequencer::SetClockSync(ClockSync* sync)
+{
+    clockSync_ = sync;
+}
+
 #pragma mark -
 //  ---------------------------------------------------------------------------
 //      Sequencer::AddListener
@@ -275,7 +575,9 @@ Sequencer::AddCommand(const uint64_t hostTime, const int cmd, const float param0
 {
     std::lock_guard<std::mutex> lock(commandsMutex_);
     const SeqCommandEvent   event = { hostTime, cmd, param0 };
-    commands_.push_back(event);
+    //  sorted here so that the audio thread never has to sort
+    commands_.insert(std::upper_bound(commands_.begin(), commands_.end(), event, Sequencer::SortEventFunctor), event);
+    numberOfCommands_.store(commands_.size(), std::memory_order_release);
 }
 
 //  ---------------------------------------------------------------------------
@@ -302,7 +604,7 @@ Sequencer::Stop(const uint64_t hostTime)
 int
 Sequencer::GetNumTracks()
 {
-    return numberOfTracks_;
+    return requestedNumberOfTracks_;
 }
 
 //  ---------------------------------------------------------------------------
@@ -320,7 +622,55 @@ Sequencer::UpdateTempo(const uint64_t hostTime, const float tempo)
 void
 Sequencer::UpdateNumSteps(const uint64_t hostTime, const int numberOfSteps)
 {
-    this->AddCommand(hostTime, kSeqCommand_UpdateNumSteps, numberOfSteps);
+    const int   numOfSteps = std::min<int>(std::max<int>(numberOfSteps, 0), kMaxNumberOfSteps);
+    {
+        //  the patterns are kept. the removed steps are cleared now, so the
+        //  steps added later are empty. only in the tracks in use : the others
+        //  are cleared by UpdateNumTracks when they are added.
+        std::lock_guard<std::mutex> lock(patternsMutex_);
+        const int   previousSteps = requestedNumberOfSteps_;
+        requestedNumberOfSteps_ = numOfSteps;
+        if (numOfSteps < previousSteps)
+        {
+            for (int trackNo = 0; trackNo < requestedNumberOfTracks_; ++trackNo)
+            {
+                uint32_t    bits[kWordsPerTrack];
+                std::copy(&latestSeq_[trackNo * kWordsPerTrack], &latestSeq_[(trackNo + 1) * kWordsPerTrack], bits);
+                this->SetTrackBits(trackNo, bits, kWordsPerTrack);
+                this->ResetTrackLanes(trackNo, numOfSteps);
+            }
+            this->CommitPatterns();
+            this->CommitLanes();
+        }
+    }
+    this->AddCommand(hostTime, kSeqCommand_UpdateNumSteps, numOfSteps);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::UpdateNumTracks
+//  ---------------------------------------------------------------------------
+void
+Sequencer::UpdateNumTracks(const uint64_t hostTime, const int numberOfTracks)
+{
+    const int   numOfTracks = std::min<int>(std::max<int>(numberOfTracks, 0), maxNumberOfTracks_);
+    {
+        //  the tracks to be added are cleared now, so their patterns can be set
+        //  before the command is processed.
+        std::lock_guard<std::mutex> lock(patternsMutex_);
+        if (numOfTracks > requestedNumberOfTracks_)
+        {
+            const uint32_t  empty[kWordsPerTrack] = {};
+            for (int trackNo = requestedNumberOfTracks_; trackNo < numOfTracks; ++trackNo)
+            {
+                this->SetTrackBits(trackNo, empty, kWordsPerTrack);
+                this->ResetTrackLanes(trackNo, 0);
+            }
+            this->CommitPatterns();
+            this->CommitLanes();
+        }
+        requestedNumberOfTracks_ = numOfTracks;
+    }
+    this->AddCommand(hostTime, kSeqCommand_UpdateNumTracks, numOfTracks);
 }
 
 //  ---------------------------------------------------------------------------
@@ -329,8 +679,542 @@ Sequencer::UpdateNumSteps(const uint64_t hostTime, const int numberOfSteps)
 void
 Sequencer::UpdateTrack(const int trackNo, const std::vector<bool> &sequence)
 {
-    if ((trackNo >= 0) && (trackNo < static_cast<int>(seq_.size())))
+    uint32_t    bits[kWordsPerTrack] = {};
+    const int   numOfSteps = std::min<int>(static_cast<int>(sequence.size()), kMaxNumberOfSteps);
+    for (int step = 0; step < numOfSteps; ++step)
+    {
+        bits[step / 32] |= (sequence[step] ? 1u : 0u) << (step % 32);
+    }
+    this->UpdateTracks(trackNo, 1, bits, kWordsPerTrack);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::UpdateTracks
+//  ---------------------------------------------------------------------------
+void
+Sequencer::UpdateTracks(const int firstTrack, const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack)
+{
+    if ((firstTrack < 0) || (numberOfTracks <= 0) || (bits == NULL) || (wordsPerTrack <= 0))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    const int   lastTrack = std::min<int>(firstTrack + numberOfTracks, maxNumberOfTracks_);
+    for (int trackNo = firstTrack; trackNo < lastTrack; ++trackNo)
+    {
+        this->SetTrackBits(trackNo, &bits[static_cast<size_t>(trackNo - firstTrack) * wordsPerTrack], wordsPerTrack);
+    }
+    this->CommitPatterns();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ImportPatterns
+//  ---------------------------------------------------------------------------
+void
+Sequencer::ImportPatterns(const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack)
+{
+    if ((numberOfTracks < 0) || ((numberOfTracks > 0) && ((bits == NULL) || (wordsPerTrack <= 0))))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    this->SetAllTrackBits(numberOfTracks, bits, wordsPerTrack);
+    this->CommitPatterns();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ImportPatterns
+//  ---------------------------------------------------------------------------
+//  a single commit : the audio thread never plays the new patterns with the
+//  old numbers of tracks and steps, or the other way around.
+void
+Sequencer::ImportPatterns(const int numberOfTracks, const int numberOfSteps, const uint32_t* bits,
+                          const int wordsPerTrack)
+{
+    if ((numberOfTracks < 0) || (numberOfTracks > maxNumberOfTracks_) ||
+        (numberOfSteps <= 0) || (numberOfSteps > kMaxNumberOfSteps) ||
+        ((numberOfTracks > 0) && ((bits == NULL) || (wordsPerTrack <= 0))))
+    {
+        return;
+    }
+    {
+        //  the numbers requested before are replaced by the import
+        std::lock_guard<std::mutex> lock(commandsMutex_);
+        commands_.erase(std::remove_if(commands_.begin(), commands_.end(), [](const SeqCommandEvent& event) {
+            return (event.command == kSeqCommand_UpdateNumSteps) || (event.command == kSeqCommand_UpdateNumTracks);
+        }), commands_.end());
+        numberOfCommands_.store(commands_.size(), std::memory_order_release);
+    }
+
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    const int   previousTracks = requestedNumberOfTracks_;
+    const int   previousSteps = requestedNumberOfSteps_;
+    requestedNumberOfSteps_ = numberOfSteps;
+    this->SetAllTrackBits(numberOfTracks, bits, wordsPerTrack);
+    requestedNumberOfTracks_ = numberOfTracks;
+
+    //  as UpdateNumTracks and UpdateNumSteps : the lanes of the added tracks
+    //  and of the removed steps of the tracks in use are reset. taken before the patterns
+    bool    isLaneReset = false;
+    const int   numOfTracks = std::max(previousTracks, numberOfTracks);
+    for (int trackNo = 0; trackNo < numOfTracks; ++trackNo)
+    {
+        if ((trackNo >= previousTracks) && (trackNo < numberOfTracks))
+        {
+            this->ResetTrackLanes(trackNo, 0);
+            isLaneReset = true;
+        }
+        else if (numberOfSteps < previousSteps)
+        {
+            this->ResetTrackLanes(trackNo, numberOfSteps);
+            isLaneReset = true;
+        }
+    }
+    if (isLaneReset)
+    {
+        this->CommitLanes();
+    }
+    this->CommitPatterns(numberOfTracks, numberOfSteps);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetAllTrackBits
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. the tracks in use after numberOfTracks are
+//  cleared. the others are cleared by UpdateNumTracks when they are added.
+void
+Sequencer::SetAllTrackBits(const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack)
+{
+    const uint32_t  empty[kWordsPerTrack] = {};
+    const int   numOfTracks = std::min<int>(std::max(numberOfTracks, requestedNumberOfTracks_), maxNumberOfTracks_);
+    for (int trackNo = 0; trackNo < numOfTracks; ++trackNo)
+    {
+        if (trackNo < numberOfTracks)
+        {
+            this->SetTrackBits(trackNo, &bits[static_cast<size_t>(trackNo) * wordsPerTrack], wordsPerTrack);
+        }
+        else
+        {
+            this->SetTrackBits(trackNo, empty, kWordsPerTrack);
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetTrackBits
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. the steps after the number of steps are dropped.
+void
+Sequencer::SetTrackBits(const int trackNo, const uint32_t* bits, const int wordsPerTrack)
+{
+    uint32_t*   dst = &latestSeq_[trackNo * kWordsPerTrack];
+    for (int word = 0; word < kWordsPerTrack; ++word)
+    {
+        const int   firstStep = word * 32;
+        const int   numOfSteps = std::min<int>(std::max<int>(requestedNumberOfSteps_ - firstStep, 0), 32);
+        const uint32_t  mask = (numOfSteps == 32) ? ~0u : ((1u << numOfSteps) - 1);
+        dst[word] = (word < wordsPerTrack) ? (bits[word] & mask) : 0;
+    }
+    if (recorder_ != NULL)
+    {
+        recorder_->RecordTrack(trackNo, requestedNumberOfSteps_, dst);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::CommitPatterns
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. the buffers have the same size : never reallocated
+void
+Sequencer::CommitPatterns(const int numberOfTracks, const int numberOfSteps)
+{
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    std::copy(latestSeq_.begin(), latestSeq_.end(), pendingSeq_.begin());
+    if (numberOfTracks >= 0)
+    {
+        pendingNumberOfTracks_ = numberOfTracks;
+    }
+    if (numberOfSteps >= 0)
+    {
+        pendingNumberOfSteps_ = numberOfSteps;
+    }
+    hasPendingSeq_.store(true, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::TakePendingPatterns
+//  ---------------------------------------------------------------------------
+inline void
+Sequencer::TakePendingPatterns(void)
+{
+    //  retried at the next callback if a commit is in progress
+    std::unique_lock<std::mutex> lock(pendingMutex_, std::try_to_lock);
+    if (lock.owns_lock())
+    {
+        if (hasPendingSeq_.load(std::memory_order_relaxed))
+        {
+            seq_.swap(pendingSeq_);
+            //  recorded as the commands, which a trace replays at the same frame
+            if (pendingNumberOfSteps_ >= 0)
+            {
+                this->ApplyCommand(kSeqCommand_UpdateNumSteps, static_cast<float>(pendingNumberOfSteps_));
+                pendingNumberOfSteps_ = -1;
+            }
+            if (pendingNumberOfTracks_ >= 0)
+            {
+                this->ApplyCommand(kSeqCommand_UpdateNumTracks, static_cast<float>(pendingNumberOfTracks_));
+                pendingNumberOfTracks_ = -1;
+            }
+            hasPendingSeq_.store(false, std::memory_order_release);
+        }
+        if (hasPendingLanes_.load(std::memory_order_relaxed))
+        {
+            lanes_.velocities.swap(pendingLanes_.velocities);
+            lanes_.probabilities.swap(pendingLanes_.probabilities);
+            lanes_.delays.swap(pendingLanes_.delays);
+            lanes_.pitches.swap(pendingLanes_.pitches);
+            lanes_.isRandom.swap(pendingLanes_.isRandom);
+            lanes_.isDelayed.swap(pendingLanes_.isDelayed);
+            //  the lanes played until now are committed to next time
+            stalePendingLanes_ = staleLanes_;
+            staleLanes_ = LaneRange();
+            hasPendingLanes_.store(false, std::memory_order_release);
+        }
+    }
+}
+
+#pragma mark - step lanes
+//  ---------------------------------------------------------------------------
+//      Sequencer::UpdateStepLanes
+//  ---------------------------------------------------------------------------
+void
+Sequencer::UpdateStepLanes(const int firstTrack, const int numberOfTracks, const uint16_t* velocities,
+                           const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches,
+                           const int stepsPerTrack)
+{
+    if ((firstTrack < 0) || (numberOfTracks <= 0) || (stepsPerTrack <= 0) ||
+        ((velocities == NULL) && (probabilities == NULL) && (delays == NULL) && (pitches == NULL)))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    //  as the patterns, the steps after the number of steps are dropped
+    const int   numOfSteps = std::min<int>(stepsPerTrack, requestedNumberOfSteps_);
+    const int   lastTrack = std::min<int>(firstTrack + numberOfTracks, maxNumberOfTracks_);
+    for (int trackNo = firstTrack; trackNo < lastTrack; ++trackNo)
+    {
+        const size_t    index = static_cast<size_t>(trackNo - firstTrack) * stepsPerTrack;
+        this->SetTrackLanes(trackNo, 0,
+                            (velocities != NULL) ? &velocities[index] : NULL,
+                            (probabilities != NULL) ? &probabilities[index] : NULL,
+                            (delays != NULL) ? &delays[index] : NULL,
+                            (pitches != NULL) ? &pitches[index] : NULL,
+                            numOfSteps);
+    }
+    this->CommitLanes();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetRandomSeed
+//  ---------------------------------------------------------------------------
+void
+Sequencer::SetRandomSeed(const uint32_t seed)
+{
+    randomSeed_.store(seed, std::memory_order_relaxed);
+    if (recorder_ != NULL)
+    {
+        recorder_->RecordNow(TraceRecorder::kTraceType_RandomState, static_cast<int32_t>(seed), 0, 0.0f);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetTrackLanes
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. sets numberOfSteps steps from firstStep. NULL lanes are kept.
+void
+Sequencer::SetTrackLanes(const int trackNo, const int firstStep, const uint16_t* velocities,
+                         const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches,
+                         const int numberOfSteps)
+{
+    const int   lastStep = std::min<int>(firstStep + numberOfSteps, kMaxNumberOfSteps);
+    if (lastStep > firstStep)
+    {
+        LaneRange   range;
+        range.firstStep = firstStep;
+        range.lastStep = lastStep;
+        range.firstTrack = trackNo;
+        range.lastTrack = trackNo + 1;
+        editedLanes_.Add(range);
+    }
+    for (int step = firstStep; step < lastStep; ++step)
+    {
+        const size_t    index = static_cast<size_t>(step) * maxNumberOfTracks_ + trackNo;
+        if (velocities != NULL)
+        {
+            latestLanes_.velocities[index] = std::min<uint16_t>(velocities[step - firstStep], kVelocityUnity);
+        }
+        if (probabilities != NULL)
+        {
+            //  counted, so that a commit does not have to scan the other tracks
+            const uint16_t  probability = std::min<uint16_t>(probabilities[step - firstStep], kProbabilityAlways);
+            randomTracks_[step] += static_cast<int>(probability < kProbabilityAlways) -
+                                   static_cast<int>(latestLanes_.probabilities[index] < kProbabilityAlways);
+            latestLanes_.probabilities[index] = probability;
+        }
+        if (delays != NULL)
+        {
+            const uint8_t   delay = delays[step - firstStep];
+            delayedTracks_[step] += static_cast<int>(delay != 0) - static_cast<int>(latestLanes_.delays[index] != 0);
+            latestLanes_.delays[index] = delay;
+        }
+        if (pitches != NULL)
+        {
+            latestLanes_.pitches[index] = std::min<int8_t>(std::max<int8_t>(pitches[step - firstStep], -kMaxPitch), kMaxPitch);
+        }
+    }
+    if (recorder_ != NULL)
+    {
+        uint16_t    trackVelocities[kMaxNumberOfSteps], trackProbabilities[kMaxNumberOfSteps];
+        uint8_t     trackDelays[kMaxNumberOfSteps];
+        int8_t      trackPitches[kMaxNumberOfSteps];
+        this->GetTrackLanes(latestLanes_, trackNo, trackVelocities, trackProbabilities, trackDelays, trackPitches);
+        recorder_->RecordLanes(trackNo, kMaxNumberOfSteps, trackVelocities, trackProbabilities, trackDelays, trackPitches);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ResetTrackLanes
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. resets the steps from firstStep
+void
+Sequencer::ResetTrackLanes(const int trackNo, const int firstStep)
+{
+    uint16_t    velocities[kMaxNumberOfSteps], probabilities[kMaxNumberOfSteps];
+    const uint8_t   delays[kMaxNumberOfSteps] = {};
+    const int8_t    pitches[kMaxNumberOfSteps] = {};
+    std::fill(velocities, velocities + kMaxNumberOfSteps, kVelocityUnity);
+    std::fill(probabilities, probabilities + kMaxNumberOfSteps, kProbabilityAlways);
+    this->SetTrackLanes(trackNo, firstStep, velocities, probabilities, delays, pitches, kMaxNumberOfSteps - firstStep);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::GetTrackLanes
+//  ---------------------------------------------------------------------------
+void
+Sequencer::GetTrackLanes(const StepLanes& lanes, const int trackNo,
+                         uint16_t* velocities, uint16_t* probabilities, uint8_t* delays, int8_t* pitches) const
+{
+    for (int step = 0; step < kMaxNumberOfSteps; ++step)
+    {
+        const size_t    index = static_cast<size_t>(step) * maxNumberOfTracks_ + trackNo;
+        velocities[step] = lanes.velocities[index];
+        probabilities[step] = lanes.probabilities[index];
+        delays[step] = lanes.delays[index];
+        pitches[step] = lanes.pitches[index];
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::CommitLanes
+//  ---------------------------------------------------------------------------
+//  patternsMutex_ must be locked. the buffers have the same size : never reallocated.
+//  only the lanes edited since the buffer was last committed are copied.
+void
+Sequencer::CommitLanes(void)
+{
+    //  the audio thread skips the dice and the delays on the steps without them
+    for (int step = editedLanes_.firstStep; step < editedLanes_.lastStep; ++step)
+    {
+        latestLanes_.isRandom[step] = (randomTracks_[step] > 0) ? 1 : 0;
+        latestLanes_.isDelayed[step] = (delayedTracks_[step] > 0) ? 1 : 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    stalePendingLanes_.Add(editedLanes_);
+    staleLanes_.Add(editedLanes_);
+    editedLanes_ = LaneRange();
+    this->CopyLanes(latestLanes_, pendingLanes_, stalePendingLanes_);
+    stalePendingLanes_ = LaneRange();
+    hasPendingLanes_.store(true, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::CopyLanes
+//  ---------------------------------------------------------------------------
+void
+Sequencer::CopyLanes(const StepLanes& source, StepLanes& destination, const LaneRange& range) const
+{
+    for (int step = range.firstStep; step < range.lastStep; ++step)
+    {
+        const size_t    first = static_cast<size_t>(step) * maxNumberOfTracks_ + range.firstTrack;
+        const size_t    last = static_cast<size_t>(step) * maxNumberOfTracks_ + range.lastTrack;
+        std::copy(source.velocities.begin() + first, source.velocities.begin() + last,
+                  destination.velocities.begin() + first);
+        std::copy(source.probabilities.begin() + first, source.probabilities.begin() + last,
+                  destination.probabilities.begin() + first);
+        std::copy(source.delays.begin() + first, source.delays.begin() + last, destination.delays.begin() + first);
+        std::copy(source.pitches.begin() + first, source.pitches.begin() + last, destination.pitches.begin() + first);
+        destination.isRandom[step] = source.isRandom[step];
+        destination.isDelayed[step] = source.isDelayed[step];
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::LaneRange::Add
+//  ---------------------------------------------------------------------------
+void
+Sequencer::LaneRange::Add(const LaneRange& range)
+{
+    if (range.IsEmpty())
+    {
+        return;
+    }
+    if (this->IsEmpty())
+    {
+        *this = range;
+        return;
+    }
+    firstStep = std::min(firstStep, range.firstStep);
+    lastStep = std::max(lastStep, range.lastStep);
+    firstTrack = std::min(firstTrack, range.firstTrack);
+    lastTrack = std::max(lastTrack, range.lastTrack);
+}
+
+#pragma mark - trace record/replay
+//  ---------------------------------------------------------------------------
+//      Sequencer::SetTraceRecorder
+//  ---------------------------------------------------------------------------
+void
+Sequencer::SetTraceRecorder(TraceRecorder* recorder)
+{
+    recorder_ = recorder;
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::RecordState
+//  ---------------------------------------------------------------------------
+void
+Sequencer::RecordState(void)
+{
+    if (recorder_ == NULL)
+    {
+        return;
+    }
+    //  the snapshot is taken at the beginning of a callback : record the patterns which will be played
+    if (hasPendingSeq_.load(std::memory_order_acquire) || hasPendingLanes_.load(std::memory_order_acquire))
+    {
+        this->TakePendingPatterns();
+    }
+    recorder_->RecordNow(TraceRecorder::kTraceType_SequencerState, isRunning_ ? 1 : 0, currentStep_, stepFrameLength_);
+    recorder_->RecordNow(TraceRecorder::kTraceType_SequencerFrame, numberOfSteps_, trigger_ ? 1 : 0, currentFrame_);
+    for (int trackNo = 0; trackNo < numberOfTracks_; ++trackNo)
+    {
+        recorder_->RecordTrack(trackNo, numberOfSteps_, &seq_[trackNo * kWordsPerTrack]);
+    }
+    recorder_->RecordNow(TraceRecorder::kTraceType_RandomState, static_cast<int32_t>(randomSeed_.load()),
+                         static_cast<int32_t>(loopCount_), 1.0f);
+    for (int trackNo = 0; trackNo < numberOfTracks_; ++trackNo)
+    {
+        uint16_t    velocities[kMaxNumberOfSteps], probabilities[kMaxNumberOfSteps];
+        uint8_t     delays[kMaxNumberOfSteps];
+        int8_t      pitches[kMaxNumberOfSteps];
+        this->GetTrackLanes(lanes_, trackNo, velocities, probabilities, delays, pitches);
+        recorder_->RecordLanes(trackNo, kMaxNumberOfSteps, velocities, probabilities, delays, pitches);
+    }
+    for (const auto& trigger : delayedTriggers_)
+    {
+        const int32_t   value0 = static_cast<int32_t>((static_cast<uint32_t>(trigger.pitch) << 24) |
+                                                      (static_cast<uint32_t>(trigger.step & 0xFF) << 16) |
+                                                      static_cast<uint32_t>(trigger.trackNo & 0xFFFF));
+        recorder_->RecordNow(TraceRecorder::kTraceType_DelayedTrigger, value0,
+                             static_cast<int32_t>(trigger.frame - sequenceFrame_), static_cast<float>(trigger.velocity));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::RestoreState
+//  ---------------------------------------------------------------------------
+void
+Sequencer::RestoreState(const bool isRunning, const int currentStep, const float currentFrame,
+                        const float stepFrameLength, const int numberOfSteps, const bool trigger)
+{
+    numberOfSteps_ = std::min<int>(std::max<int>(numberOfSteps, 0), kMaxNumberOfSteps);
+    isRunning_ = isRunning;
+    currentStep_ = currentStep;
+    currentFrame_ = currentFrame;
+    stepFrameLength_ = stepFrameLength;
+    trigger_ = trigger;
+    delayedTriggers_.clear();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::RestoreRandomState
+//  ---------------------------------------------------------------------------
+void
+Sequencer::RestoreRandomState(const uint32_t seed, const uint32_t loopCount)
+{
+    randomSeed_.store(seed, std::memory_order_relaxed);
+    loopCount_ = loopCount;
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::RestoreDelayedTrigger
+//  ---------------------------------------------------------------------------
+void
+Sequencer::RestoreDelayedTrigger(const int trackNo, const int step, const int32_t velocity, const int32_t pitch,
+                                 const uint32_t frames)
+{
+    //  frames : from the beginning of the next callback
+    if ((trackNo >= 0) && (trackNo < maxNumberOfTracks_) && (delayedTriggers_.size() < delayedTriggers_.capacity()))
+    {
+        const DelayedTrigger    trigger = { sequenceFrame_ + frames, trackNo, step, velocity, pitch };
+        delayedTriggers_.push_back(trigger);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ReplayLanes
+//  ---------------------------------------------------------------------------
+void
+Sequencer::ReplayLanes(const int trackNo, const uint16_t* velocities, const uint16_t* probabilities,
+                       const uint8_t* delays, const int8_t* pitches, const int numberOfSteps)
+{
+    if ((trackNo < 0) || (trackNo >= maxNumberOfTracks_))
     {
-        seq_[trackNo] = sequence;
+        return;
     }
+    //  all steps of the track, recorded after masked by the number of steps of that time
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    this->SetTrackLanes(trackNo, 0, velocities, probabilities, delays, pitches, numberOfSteps);
+    this->CommitLanes();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ReplayTrack
+//  ---------------------------------------------------------------------------
+void
+Sequencer::ReplayTrack(const int trackNo, const uint32_t* bits, const int numberOfWords)
+{
+    if ((trackNo < 0) || (trackNo >= maxNumberOfTracks_))
+    {
+        return;
+    }
+    //  recorded after masked by the number of steps of that time
+    std::lock_guard<std::mutex> lock(patternsMutex_);
+    uint32_t*   dst = &latestSeq_[trackNo * kWordsPerTrack];
+    for (int word = 0; word < kWordsPerTrack; ++word)
+    {
+        dst[word] = (word < numberOfWords) ? bits[word] : 0;
+    }
+    this->CommitPatterns();
+}
+
+//  ---------------------------------------------------------------------------
+//      Sequencer::ReplayCommand
+//  ---------------------------------------------------------------------------
+void
+Sequencer::ReplayCommand(const int cmd, const float param0)
+{
+    //  host time 0 : processed at the beginning of the next Process()
+    this->AddCommand(0, cmd, param0);
 }
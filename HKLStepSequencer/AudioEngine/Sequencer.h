@@ -12,12 +12,28 @@ class SequencerListener
 {
 public:
     virtual ~SequencerListener(void)    {}
-    virtual void    NoteOnViaSequencer(int frame, const std::vector<int> &parts, int step) = 0;
+    /* velocities : gain of each hit(Q15, Sequencer::kVelocityUnity = x1.0), pitches : semitones of each hit */
+    virtual void    NoteOnViaSequencer(int frame, const std::vector<int> &parts, const std::vector<int32_t> &velocities,
+                                       const std::vector<int32_t> &pitches, int step) = 0;
+    /* step 0 is about to be triggered. stepFrame : frames of step 0 already elapsed at that frame */
+    virtual void    LoopStartViaSequencer(int /*frame*/, const float /*stepFrameLength*/, const float /*stepFrame*/,
+                                          const int /*numberOfSteps*/) {}
 };
 
 class Sequencer
 {
 public:
+    enum
+    {
+        kMaxNumberOfTracks = 256,       //  preallocated. more if the initial number of tracks is larger
+        kMaxNumberOfSteps = 256,
+        kWordsPerTrack = kMaxNumberOfSteps / 32,
+        kVelocityUnity = 0x8000,        //  Q15 : x1.0
+        kProbabilityAlways = 0x8000,    //  Q15 : 1.0
+        kDelayResolution = 256,         //  the delay lane is in 1/256 steps
+        kMaxPitch = 48,                 //  the pitch lane is in semitones : -kMaxPitch - kMaxPitch
+    };
+
     Sequencer(float sampleRate, int numberOfTracks, int numberOfSteps, int stepsPerBeat);
     ~Sequencer(void);
 
@@ -31,15 +47,98 @@ public:
 
     void    UpdateTempo(const uint64_t hostTime, const float tempo);
     void    UpdateNumSteps(const uint64_t hostTime, const int numberOfSteps);
+    /* patterns of the remaining tracks are kept. added tracks are empty */
+    void    UpdateNumTracks(const uint64_t hostTime, const int numberOfTracks);
+    int     GetMaxNumTracks(void) const     { return maxNumberOfTracks_; }
     void    UpdateTrack(const int trackNo, const std::vector<bool> &sequence);
 
-    int     Process(class AudioIO* io, int offset, int length);
+    //  packed patterns : bit N of the word W of a track is the step W * 32 + N.
+    //  each call is a single transaction which the audio thread takes at the
+    //  beginning of a callback.
+    void    UpdateTracks(const int firstTrack, const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack);
+    /* replaces all patterns. the tracks after numberOfTracks are cleared. the step lanes are kept */
+    void    ImportPatterns(const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack);
+    /* as above, and the numbers of tracks and steps are taken in the same callback as the patterns */
+    void    ImportPatterns(const int numberOfTracks, const int numberOfSteps, const uint32_t* bits,
+                           const int wordsPerTrack);
+
+    //  per-step lanes : the velocity, the probability, the delay(micro-timing)
+    //  and the pitch of the notes. stepsPerTrack values for each track. a NULL
+    //  lane is kept. the tracks added and the steps removed are reset to x1.0,
+    //  always, 0 and 0.
+    void    UpdateStepLanes(const int firstTrack, const int numberOfTracks, const uint16_t* velocities,
+                            const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches,
+                            const int stepsPerTrack);
+    /* the probabilities are decided by a hash of the seed, the loop count, the step and the track */
+    void    SetRandomSeed(const uint32_t seed);
+
+    int     Process(class RenderContext* io, int offset, int length);
+
+    //  external clock : while the sync is locked, the tempo and the position
+    //  follow it from the beginning of each callback. NULL : the tempo set(not owned)
+    void    SetClockSync(class ClockSync* sync);
+
+    //  trace record/replay
+    void    SetTraceRecorder(class TraceRecorder* recorder);
+    void    RecordState(void);
+    void    RestoreState(const bool isRunning, const int currentStep, const float currentFrame,
+                         const float stepFrameLength, const int numberOfSteps, const bool trigger);
+    void    ReplayCommand(const int cmd, const float param0);
+    void    ReplayTrack(const int trackNo, const uint32_t* bits, const int numberOfWords);
+    void    ReplayLanes(const int trackNo, const uint16_t* velocities, const uint16_t* probabilities,
+                        const uint8_t* delays, const int8_t* pitches, const int numberOfSteps);
+    void    RestoreRandomState(const uint32_t seed, const uint32_t loopCount);
+    void    RestoreDelayedTrigger(const int trackNo, const int step, const int32_t velocity, const int32_t pitch,
+                                  const uint32_t frames);
 
 private:
     Sequencer(const Sequencer& other);                      //  not implemented
     const Sequencer& operator= (const Sequencer& other);    //  not implemented
 
     void    SetupTracks(void);
+    void    SetTrackBits(const int trackNo, const uint32_t* bits, const int wordsPerTrack);
+    void    SetAllTrackBits(const int numberOfTracks, const uint32_t* bits, const int wordsPerTrack);
+    /* numberOfTracks, numberOfSteps : taken with the patterns. -1 : unchanged */
+    void    CommitPatterns(const int numberOfTracks = -1, const int numberOfSteps = -1);
+    void    TakePendingPatterns(void);
+    void    SetTrackLanes(const int trackNo, const int firstStep, const uint16_t* velocities,
+                          const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches,
+                          const int numberOfSteps);
+    void    ResetTrackLanes(const int trackNo, const int firstStep);
+    void    CommitLanes(void);
+    static uint32_t Hash(uint32_t value);
+
+    typedef struct {
+        uint64_t    frame;          //  since the sequencer was created
+        int         trackNo;
+        int         step;
+        int32_t     velocity;
+        int32_t     pitch;
+    } DelayedTrigger;
+
+    //  step-major([step * maxNumberOfTracks_ + track]) so that a step reads
+    //  the lanes of all tracks contiguously
+    struct StepLanes {
+        std::vector<uint16_t>   velocities;
+        std::vector<uint16_t>   probabilities;
+        std::vector<uint8_t>    delays;
+        std::vector<int8_t>     pitches;
+        std::vector<uint8_t>    isRandom;       //  per step : any probability below kProbabilityAlways
+        std::vector<uint8_t>    isDelayed;      //  per step : any delay
+    };
+    //  steps [firstStep, lastStep) x tracks [firstTrack, lastTrack) of the lanes
+    struct LaneRange {
+        int     firstStep = 0;
+        int     lastStep = 0;           //  empty if not after firstStep
+        int     firstTrack = 0;
+        int     lastTrack = 0;
+
+        bool    IsEmpty(void) const     { return lastStep <= firstStep; }
+        void    Add(const LaneRange& range);    //  the range covering both
+    };
+    void    CopyLanes(const StepLanes& source, StepLanes& destination, const LaneRange& range) const;
+    void    GetTrackLanes(const StepLanes& lanes, const int trackNo,
+                          uint16_t* velocities, uint16_t* probabilities, uint8_t* delays, int8_t* pitches) const;
 
     typedef struct {
         uint64_t    hostTime;
@@ -51,24 +150,63 @@ private:
         return (left.hostTime == right.hostTime) ? (left.command < right.command) : (left.hostTime < right.hostTime);
     }
 
-    int     ProcessCommands(class AudioIO* io, int offset, int length);
+    int     ProcessCommands(class RenderContext* io, int offset, int length);
     void    ProcessCommand(SeqCommandEvent& event);
-    void    ProcessTrigger(int offset, const std::vector<int> &trackIndexes);
+    void    ProcessClockSync(class RenderContext* io);
+    void    ApplyCommand(const int cmd, const float param0);
+    void    ProcessTrigger(int offset, const std::vector<int> &trackIndexes, const std::vector<int32_t> &velocities,
+                           const std::vector<int32_t> &pitches, int step);
     void    ProcessTrigger(int offset);
     void    ProcessSequence(int offset, int length);
+    void    ProcessDelayedTriggers(int offset, int length);
     void    AddCommand(const uint64_t hostTime, const int cmd, const float param0);
 
     const float samplingRate_;
-    int     numberOfTracks_;
-    int     numberOfSteps_;
+    int     numberOfTracks_;        //  audio thread
+    int     requestedNumberOfTracks_;
+    int     numberOfSteps_;         //  audio thread
+    int     requestedNumberOfSteps_;
     const int stepsPerBeat_;
     bool    isRunning_;
     int     currentStep_;
     float   stepFrameLength_;
     float   currentFrame_;
     bool    trigger_;
-    std::vector< std::vector<bool> >   seq_;
-    std::vector<SeqCommandEvent>   commands_;
+    const int   maxNumberOfTracks_;
+    std::vector<uint32_t>   seq_;               //  audio thread. kWordsPerTrack words per track
+    std::vector<uint32_t>   latestSeq_;         //  non real-time : edited under patternsMutex_
+    std::vector<uint32_t>   pendingSeq_;        //  committed, not yet taken by the audio thread
+    std::atomic<bool>   hasPendingSeq_;
+    int     pendingNumberOfTracks_;     //  under pendingMutex_. -1 : unchanged
+    int     pendingNumberOfSteps_;
+    std::mutex  patternsMutex_;
+    std::mutex  pendingMutex_;          //  the audio thread only try_locks
+    StepLanes   lanes_;                 //  audio thread
+    StepLanes   latestLanes_;           //  non real-time : edited under patternsMutex_
+    StepLanes   pendingLanes_;
+    std::atomic<bool>   hasPendingLanes_;
+    std::vector<int>    randomTracks_;      //  per step of latestLanes_ : tracks with a probability
+    std::vector<int>    delayedTracks_;     //  per step of latestLanes_ : tracks with a delay
+    LaneRange   editedLanes_;           //  under patternsMutex_ : not committed yet
+    LaneRange   stalePendingLanes_;     //  under pendingMutex_ : pendingLanes_ may differ from latestLanes_
+    LaneRange   staleLanes_;            //  under pendingMutex_ : lanes_ may differ from latestLanes_
+    std::atomic<uint32_t>   randomSeed_;
+    uint32_t    loopCount_;             //  audio thread : since the start
+    uint64_t    sequenceFrame_;         //  audio thread : frames processed at the current offset
+    uint64_t    callbackFrame_;         //  audio thread : frames processed at the offset 0
+    std::vector<DelayedTrigger> delayedTriggers_;   //  reserved : never reallocated
+    std::vector<int>    triggeredTracks_;   //  reserved for all tracks : written branch-free
+    std::vector<int32_t>    triggeredVelocities_;
+    std::vector<int32_t>    triggeredPitches_;
+    std::vector<int>    delayedTrack_;      //  a delayed trigger is notified alone
+    std::vector<int32_t>    delayedVelocity_;
+    std::vector<int32_t>    delayedPitch_;
+    std::vector<SeqCommandEvent>   commands_;      //  kept sorted by AddCommand
     std::vector<SequencerListener*>  listeners_;
     std::mutex     commandsMutex_;
+    std::atomic<size_t>    numberOfCommands_;  //  lets the audio thread skip the lock when idle
+    uint32_t    timebaseNumer_;     //  HostClock::GetTimebase, cached
+    uint32_t    timebaseDenom_;
+    class TraceRecorder*    recorder_;
+    class ClockSync*    clockSync_;
 };
@@ -0,0 +1,228 @@
+//
+//  StemWriter.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include "StemWriter.h"
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::StemWriter
+//  ---------------------------------------------------------------------------
+StemWriter::StemWriter(void) :
+stems_(),
+writers_(),
+samplingRate_(0),
+filledFrames_(0),
+numberOfFrames_(0),
+isValid_(false)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::~StemWriter
+//  ---------------------------------------------------------------------------
+StemWriter::~StemWriter(void)
+{
+    this->Close();
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::Open
+//  ---------------------------------------------------------------------------
+bool
+StemWriter::Open(const std::vector<std::string>& paths, const uint32_t samplingRate)
+{
+    this->Close();
+    if (paths.empty())
+    {
+        return false;
+    }
+
+    samplingRate_ = samplingRate;
+    filledFrames_ = 0;
+    numberOfFrames_ = 0;
+    stems_.resize(paths.size());
+    bool    result = true;
+    for (size_t busNo = 0; busNo < paths.size(); ++busNo)
+    {
+        Stem&   stem = stems_[busNo];
+        stem.fp = ::fopen(paths[busNo].c_str(), "wb");
+        //  the sizes are written by Close
+        result = result && (stem.fp != NULL) && StemWriter::WriteHeader(stem.fp, samplingRate_, 0);
+        stem.left.resize(kChunkFrames);
+        stem.right.resize(kChunkFrames);
+        stem.writingLeft.resize(kChunkFrames);
+        stem.writingRight.resize(kChunkFrames);
+        stem.interleaved.resize(kChunkFrames * 2);
+    }
+    writers_.reserve(stems_.size());
+    isValid_ = result;
+    if (!result)
+    {
+        this->Close();
+    }
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::Write
+//  ---------------------------------------------------------------------------
+bool
+StemWriter::Write(int16_t** buffer, const uint32_t length)
+{
+    if (!isValid_)
+    {
+        return false;
+    }
+    const int   numOfBuses = static_cast<int>(stems_.size());
+    uint32_t    done = 0;
+    while (done < length)
+    {
+        const uint32_t  frames = std::min<uint32_t>(length - done, kChunkFrames - filledFrames_);
+        for (int busNo = 0; busNo < numOfBuses; ++busNo)
+        {
+            Stem&   stem = stems_[busNo];
+            ::memcpy(&stem.left[filledFrames_], buffer[busNo * 2] + done, frames * sizeof(int16_t));
+            ::memcpy(&stem.right[filledFrames_], buffer[busNo * 2 + 1] + done, frames * sizeof(int16_t));
+        }
+        filledFrames_ += frames;
+        numberOfFrames_ += frames;
+        done += frames;
+        if ((filledFrames_ == kChunkFrames) && !this->Flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::Close
+//  ---------------------------------------------------------------------------
+bool
+StemWriter::Close(void)
+{
+    if (stems_.empty())
+    {
+        return false;
+    }
+
+    bool    result = isValid_;
+    if (result && (filledFrames_ > 0))
+    {
+        result = this->Flush();
+    }
+    result = this->Wait() && result;
+    for (auto& stem : stems_)
+    {
+        if (stem.fp == NULL)
+        {
+            result = false;
+            continue;
+        }
+        if (result)
+        {
+            result = (::fseek(stem.fp, 0, SEEK_SET) == 0) &&
+                     StemWriter::WriteHeader(stem.fp, samplingRate_, numberOfFrames_);
+        }
+        result = (::fclose(stem.fp) == 0) && result;
+    }
+    stems_.clear();
+    filledFrames_ = 0;
+    isValid_ = false;
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::Flush
+//  ---------------------------------------------------------------------------
+//  hands the chunk filled to the writers once they have written the previous one
+bool
+StemWriter::Flush(void)
+{
+    if (!this->Wait())
+    {
+        isValid_ = false;
+        return false;
+    }
+    const uint32_t  frames = filledFrames_;
+    for (auto& stem : stems_)
+    {
+        stem.left.swap(stem.writingLeft);
+        stem.right.swap(stem.writingRight);
+        writers_.push_back(std::async(std::launch::async, &StemWriter::WriteChunk, std::ref(stem), frames));
+    }
+    filledFrames_ = 0;
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::Wait
+//  ---------------------------------------------------------------------------
+bool
+StemWriter::Wait(void)
+{
+    bool    result = true;
+    for (auto& writer : writers_)
+    {
+        result = writer.get() && result;
+    }
+    writers_.clear();
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::WriteChunk                          [writer thread]
+//  ---------------------------------------------------------------------------
+bool
+StemWriter::WriteChunk(Stem& stem, const uint32_t frames)
+{
+    //  little-endian samples, as the trace files are
+    const int16_t*  left = &stem.writingLeft[0];
+    const int16_t*  right = &stem.writingRight[0];
+    int16_t*    dest = &stem.interleaved[0];
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        dest[i * 2] = left[i];
+        dest[i * 2 + 1] = right[i];
+    }
+    return ::fwrite(dest, sizeof(int16_t), frames * 2, stem.fp) == frames * 2;
+}
+
+//  ---------------------------------------------------------------------------
+//      StemWriter::WriteHeader
+//  ---------------------------------------------------------------------------
+//  RIFF WAVE, 16bit linear PCM, stereo
+bool
+StemWriter::WriteHeader(FILE* fp, const uint32_t samplingRate, const uint64_t frames)
+{
+    const uint32_t  dataBytes = static_cast<uint32_t>(std::min<uint64_t>(frames * 4, 0xFFFFFFFFULL - 36));
+    uint8_t     header[44];
+    const auto  put = [&header](const int offset, const uint32_t value, const int bytes) {
+        for (int byte = 0; byte < bytes; ++byte)
+        {
+            header[offset + byte] = static_cast<uint8_t>(value >> (byte * 8));
+        }
+    };
+    ::memcpy(&header[0], "RIFF", 4);
+    put(4, 36 + dataBytes, 4);
+    ::memcpy(&header[8], "WAVE", 4);
+    ::memcpy(&header[12], "fmt ", 4);
+    put(16, 16, 4);                     //  size of fmt
+    put(20, 1, 2);                      //  linear PCM
+    put(22, 2, 2);                      //  channels
+    put(24, samplingRate, 4);
+    put(28, samplingRate * 4, 4);       //  bytes per second
+    put(32, 4, 2);                      //  bytes per frame
+    put(34, 16, 2);                     //  bits per sample
+    ::memcpy(&header[36], "data", 4);
+    put(40, dataBytes, 4);
+    return ::fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+}
@@ -0,0 +1,67 @@
+//
+//  StemWriter.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <vector>
+
+//  Writes the buses rendered by Synthesizer::ProcessStems to 16bit stereo WAV
+//  files, one file per bus.
+//
+//  The blocks passed to Write are gathered into chunks. A full chunk is
+//  interleaved and written to all the files concurrently(a writer thread per
+//  file) while the next chunk is being rendered, so the files cost the render
+//  thread little more than a copy.
+class StemWriter
+{
+public:
+    enum
+    {
+        kChunkFrames = 32768,
+    };
+
+    StemWriter(void);
+    ~StemWriter(void);          //  closes the files
+
+    bool    Open(const std::vector<std::string>& paths, const uint32_t samplingRate);
+    /* buffer : L & R of each bus(GetNumberOfBuses() * 2 channels) */
+    bool    Write(int16_t** buffer, const uint32_t length);
+    /* writes the rest and completes the headers. false if any write has failed */
+    bool    Close(void);
+
+    int     GetNumberOfBuses(void) const        { return static_cast<int>(stems_.size()); }
+    uint64_t    GetNumberOfFrames(void) const   { return numberOfFrames_; }
+
+private:
+    StemWriter(const StemWriter& other) = delete;
+    const StemWriter& operator= (const StemWriter& other) = delete;
+
+    typedef struct {
+        FILE*       fp;
+        std::vector<int16_t>    left;           //  the chunk being filled
+        std::vector<int16_t>    right;
+        std::vector<int16_t>    writingLeft;    //  the chunk being written
+        std::vector<int16_t>    writingRight;
+        std::vector<int16_t>    interleaved;
+    } Stem;
+
+    bool    Flush(void);
+    bool    Wait(void);
+    static bool WriteChunk(Stem& stem, const uint32_t frames);
+    static bool WriteHeader(FILE* fp, const uint32_t samplingRate, const uint64_t frames);
+
+    std::vector<Stem>   stems_;
+    std::vector< std::future<bool> >    writers_;
+    uint32_t    samplingRate_;
+    uint32_t    filledFrames_;          //  of the chunk being filled
+    uint64_t    numberOfFrames_;
+    bool        isValid_;
+};
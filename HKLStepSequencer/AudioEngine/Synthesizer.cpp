@@ -7,26 +7,67 @@
 //
 
 #include <string>
+#include <cstring>
 #include <vector>
 #include <algorithm>
 #include <mutex>
 
-#include "AudioIO.h"
+#include "RenderContext.h"
+#include "PerformanceMonitor.h"
 #include "Sequencer.h"
 #include "DrumOscillator.h"
+#include "LevelMeter.h"
+#include "LoopCache.h"
+#include "TraceRecorder.h"
+#include "SampleLoader.h"
+#include "WavSampleLoader.h"
 
 #include "Synthesizer.h"
 
 //  ---------------------------------------------------------------------------
 //      Synthesizer::Synthesizer
 //  ---------------------------------------------------------------------------
-Synthesizer::Synthesizer(float samplingRate) :
+Synthesizer::Synthesizer(float samplingRate, const SampleLoader* loader) :
     samplingRate_(samplingRate),
+    sampleLoader_(loader),
     seq_(nullptr),
     seqEvents_(),
-    oscillators_()
+    oscillators_(),
+    latestOscillators_(),
+    pendingOscillators_(),
+    retiredOscillators_(),
+    hasPendingOscillators_(false),
+    pendingMutex_(),
+    soundfiles_(),
+    renderKernel_(DrumOscillator::kRenderKernel_Scalar),
+    silenceLevel_(0),
+    releaseLevel_(0),
+    levelMeter_(kMaxNumberOfMeteredTracks),
+    mixLevel_(),
+    recorder_(nullptr),
+    loopCache_(samplingRate),
+    isLoopCacheActive_(false),
+    loopStarts_(),
+    loopPosition_(0),
+    isLoopPositionValid_(false),
+    paramVersions_(LoopCache::kMaxNumberOfTracks),
+    trackBuses_(Sequencer::kMaxNumberOfTracks),
+    soundVersion_(0),
+    latestSoundVersion_(0),
+    pendingSoundVersion_(0),
+    oscillatorsMutex_()
 {
     seqEvents_.reserve(100);
+    //  swapped on the audio thread : never reallocated there
+    oscillators_.reserve(Sequencer::kMaxNumberOfTracks);
+    pendingOscillators_.reserve(Sequencer::kMaxNumberOfTracks);
+    loopStarts_.reserve(kMaxNumberOfLoopStarts);
+
+    if (sampleLoader_ == nullptr)
+    {
+        static const WavSampleLoader    sWavLoader;
+        sampleLoader_ = &sWavLoader;
+    }
 }
 
 //  ---------------------------------------------------------------------------
@@ -34,6 +75,7 @@ Synthesizer::Synthesizer(float samplingRate) :
 //  ---------------------------------------------------------------------------
 Synthesizer::~Synthesizer(void)
 {
+    loopCache_.Stop();
     CleanupOscillators();
 
     delete seq_;
@@ -46,22 +88,44 @@ Synthesizer::~Synthesizer(void)
 //
 enum
 {
-    kSeqEventParamType_Trigger = 0,
+    kSeqEventParamType_LoopStart = 0,   //  precedes the triggers at the same frame
+    kSeqEventParamType_Trigger,
 };
 
 //  ---------------------------------------------------------------------------
 //      Synthesizer::NoteOnViaSequencer
 //  ---------------------------------------------------------------------------
 void
-Synthesizer::NoteOnViaSequencer(int frame, const std::vector<int> &parts, int step)
+Synthesizer::NoteOnViaSequencer(int frame, const std::vector<int> &parts, const std::vector<int32_t> &velocities,
+                                const std::vector<int32_t> &pitches, int /*step*/)
 {
-    for (const auto partNo : parts)
+    for (size_t index = 0; index < parts.size(); ++index)
     {
-        const SequencerEvent    param = { frame, kSeqEventParamType_Trigger, partNo, step };
+        const SequencerEvent    param = { frame, kSeqEventParamType_Trigger, parts[index], velocities[index], pitches[index] };
         seqEvents_.push_back(param);
     }
 }
 
+//  ---------------------------------------------------------------------------
+//      Synthesizer::LoopStartViaSequencer
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::LoopStartViaSequencer(int frame, const float stepFrameLength, const float stepFrame, const int numberOfSteps)
+{
+    if (!isLoopCacheActive_ || (loopStarts_.size() >= kMaxNumberOfLoopStarts))
+    {
+        return;
+    }
+    LoopCache::Key  key = { stepFrameLength, stepFrame, numberOfSteps, 0, 0, 0 };
+    if (!loopCache_.GetLoopFrames(stepFrameLength, numberOfSteps, key.loopFrames))
+    {
+        key.loopFrames = 0;
+    }
+    const SequencerEvent    param = { frame, kSeqEventParamType_LoopStart, static_cast<int>(loopStarts_.size()), 0, 0 };
+    loopStarts_.push_back(key);
+    seqEvents_.push_back(param);
+}
+
 //  ---------------------------------------------------------------------------
 //      Synthesizer::DecodeSeqEvent
 //  ---------------------------------------------------------------------------
@@ -73,10 +137,38 @@ Synthesizer::DecodeSeqEvent(const SequencerEvent* event)
         case kSeqEventParamType_Trigger:
             {
                 const int   oscNo = event->value0;
+                const int32_t   velocity = event->value1;
+                const int32_t   pitch = event->value2;
                 if ((oscNo >= 0) && (oscNo < static_cast<int>(oscillators_.size())))
                 {
-                    oscillators_[oscNo]->TriggerOn();
+                    oscillators_[oscNo]->TriggerOn(velocity, pitch);
+                    if (isLoopCacheActive_)
+                    {
+                        loopCache_.Trigger(oscNo, loopPosition_, velocity, pitch);
+                    }
+                }
+            }
+            break;
+        case kSeqEventParamType_LoopStart:
+            {
+                //  observed frames : the length of the loop which has just finished
+                const uint32_t  observedFrames = isLoopPositionValid_ ? loopPosition_ : 0;
+                const uint32_t  soundVersion = soundVersion_;
+                const int   numOfTracks = std::min<int>(static_cast<int>(oscillators_.size()), LoopCache::kMaxNumberOfTracks);
+                for (int oscNo = 0; oscNo < numOfTracks; ++oscNo)
+                {
+                    LoopCache::Key  key = loopStarts_[event->value0];
+                    key.paramVersion = paramVersions_[oscNo].load(std::memory_order_acquire);
+                    key.soundVersion = soundVersion;
+                    bool        isRunning;
+                    uint32_t    address;
+                    int32_t     velocity;
+                    int32_t     pitch;
+                    oscillators_[oscNo]->GetVoiceState(isRunning, address, velocity, pitch);
+                    loopCache_.StartTrack(oscNo, observedFrames, key, isRunning, address, velocity, pitch);
                 }
+                loopPosition_ = 0;
+                isLoopPositionValid_ = true;
             }
             break;
         default:
@@ -84,40 +176,163 @@ Synthesizer::DecodeSeqEvent(const SequencerEvent* event)
     }
 }
 
+//  ---------------------------------------------------------------------------
+//      Synthesizer::GetBus
+//  ---------------------------------------------------------------------------
+//  bus of the track. -1 if the track is routed to no bus
+inline int
+Synthesizer::GetBus(const int numberOfBuses, const int oscNo) const
+{
+    if (numberOfBuses == kMasterBus)
+    {
+        return 0;
+    }
+    const int   bus = (oscNo < static_cast<int>(trackBuses_.size())) ?
+                      trackBuses_[oscNo].load(std::memory_order_relaxed) : 0;
+    return ((bus >= 0) && (bus < numberOfBuses)) ? bus : -1;
+}
+
 //  ---------------------------------------------------------------------------
 //      Synthesizer::RenderAudio
 //  ---------------------------------------------------------------------------
+//  The master level is measured while mixing : the last voice mixed into each
+//  bus measures the mix of the bus in its own pass.
 inline void
-Synthesizer::RenderAudio(AudioIO* /*io*/, int16_t** buffer, int length)
+Synthesizer::RenderAudio(RenderContext* /*io*/, int16_t** buffer, const int numberOfBuses, int length)
 {
-    for (auto oscillator: oscillators_) {
-        oscillator->Process(buffer, length);
+    const int   numOfOscillators = static_cast<int>(oscillators_.size());
+    const int   numOfBuses = (numberOfBuses == kMasterBus) ? 1 : numberOfBuses;
+    int     lastVoices[kMaxNumberOfBuses];
+    std::fill(lastVoices, lastVoices + numOfBuses, -1);
+    for (int oscNo = 0; oscNo < numOfOscillators; ++oscNo)
+    {
+        const int   bus = this->GetBus(numberOfBuses, oscNo);
+        if ((bus >= 0) && oscillators_[oscNo]->IsActive())
+        {
+            lastVoices[bus] = oscNo;
+        }
+    }
+
+    if (!isLoopCacheActive_)
+    {
+        //  each voice is rendered once, into its bus
+        for (int oscNo = 0; oscNo < numOfOscillators; ++oscNo)
+        {
+            const int   bus = this->GetBus(numberOfBuses, oscNo);
+            if (bus >= 0)
+            {
+                oscillators_[oscNo]->Process(&buffer[bus * 2], length, (lastVoices[bus] == oscNo) ? &mixLevel_ : NULL);
+            }
+            else
+            {
+                oscillators_[oscNo]->Skip(length);
+            }
+        }
+        return;
     }
+
+    //  a cached track only advances its voice
+    const uint32_t  soundVersion = soundVersion_;
+    for (int oscNo = 0; oscNo < numOfOscillators; ++oscNo)
+    {
+        DrumOscillator* oscillator = oscillators_[oscNo];
+        const uint32_t  paramVersion = (oscNo < LoopCache::kMaxNumberOfTracks) ?
+                                       paramVersions_[oscNo].load(std::memory_order_acquire) : 0;
+        const int   bus = this->GetBus(numberOfBuses, oscNo);
+        if (bus < 0)
+        {
+            oscillator->Skip(length);
+            continue;
+        }
+        int16_t**   output = &buffer[bus * 2];
+        LevelMeter::BlockLevel* mixLevel = (lastVoices[bus] == oscNo) ? &mixLevel_ : NULL;
+        if (isLoopPositionValid_ && loopCache_.Play(oscNo, output, loopPosition_, length, paramVersion, soundVersion, mixLevel))
+        {
+            oscillator->Skip(length);
+        }
+        else
+        {
+            oscillator->Process(output, length, mixLevel);
+        }
+    }
+    loopPosition_ += length;
 }
 
 //  ---------------------------------------------------------------------------
 //      Synthesizer::ProcessReplacing
 //  ---------------------------------------------------------------------------
 void
-Synthesizer::ProcessReplacing(AudioIO* io, int16_t** buffer, const uint32_t length)
+Synthesizer::ProcessReplacing(RenderContext* io, int16_t** buffer, const uint32_t length)
+{
+    this->Process(io, buffer, kMasterBus, length);
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::ProcessStems
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::ProcessStems(int16_t** buffer, const int numberOfBuses, const uint32_t length)
+{
+#define CLIP(x, min, max)   (x < min ? min : (x > max ? max : x))
+    this->Process(NULL, buffer, CLIP(numberOfBuses, 1, static_cast<int>(kMaxNumberOfBuses)), length);
+#undef CLIP
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::Process
+//  ---------------------------------------------------------------------------
+//  numberOfBuses : kMasterBus mixes all the tracks into a stereo buffer
+inline void
+Synthesizer::Process(RenderContext* io, int16_t** buffer, const int numberOfBuses, const uint32_t length)
 {
     //  clear buffer
-    ::memset(buffer[0], 0, length * sizeof(int16_t));
-    ::memset(buffer[1], 0, length * sizeof(int16_t));
+    const int   numOfChannels = (numberOfBuses == kMasterBus) ? 2 : numberOfBuses * 2;
+    for (int ch = 0; ch < numOfChannels; ++ch)
+    {
+        ::memset(buffer[ch], 0, length * sizeof(int16_t));
+    }
+    mixLevel_ = { 0, 0 };
+
+    if (hasPendingOscillators_.load(std::memory_order_acquire))
+    {
+        this->TakePendingOscillators();
+    }
+
+    isLoopCacheActive_ = loopCache_.BeginCallback();
+    if (!isLoopCacheActive_)
+    {
+        isLoopPositionValid_ = false;
+    }
 
+    if (recorder_ != nullptr)
+    {
+        if (recorder_->TakeSnapshotRequest())
+        {
+            this->RecordState();
+        }
+        recorder_->BeginCallback(length);
+    }
+
+    PerformanceMonitor* monitor = (io != NULL) ? &io->GetPerformanceMonitor() : NULL;
     int rest = static_cast<int>(length);
     int offset = 0;
     while (rest > 0)
     {            
         const int    frames = rest;
         const size_t numOfEvents = seqEvents_.size();
+        const uint64_t  seqStart = (monitor != NULL) ? PerformanceMonitor::Now() : 0;
         const int    processed = (seq_ != NULL) ? seq_->Process(io, offset, frames) : frames;
+        if (monitor != NULL)
+        {
+            monitor->AddSequencerTime(PerformanceMonitor::Now() - seqStart);
+        }
         if (seqEvents_.size() > numOfEvents)
         {
             std::sort(seqEvents_.begin(), seqEvents_.end(), Synthesizer::SortEventFunctor);
         }
         if (processed > 0)
         {
+            const uint64_t  renderStart = (monitor != NULL) ? PerformanceMonitor::Now() : 0;
             auto procLen = processed;
             auto curPos = offset;
             auto ite = seqEvents_.begin();
@@ -137,8 +352,12 @@ Synthesizer::ProcessReplacing(AudioIO* io, int16_t** buffer, const uint32_t leng
                 }
                 if (renderLen > 0)
                 {
-                    int16_t*    output[] = { buffer[0] + curPos , buffer[1] + curPos };
-                    this->RenderAudio(io, output, renderLen);
+                    int16_t*    output[kMaxNumberOfBuses * 2];
+                    for (int ch = 0; ch < numOfChannels; ++ch)
+                    {
+                        output[ch] = buffer[ch] + curPos;
+                    }
+                    this->RenderAudio(io, output, numberOfBuses, renderLen);
                 }
                 if (iteIsValid)
                 {
@@ -151,12 +370,63 @@ Synthesizer::ProcessReplacing(AudioIO* io, int16_t** buffer, const uint32_t leng
                 curPos += renderLen;
                 procLen -= renderLen;
             }
+            if (monitor != NULL)
+            {
+                monitor->AddRenderTime(PerformanceMonitor::Now() - renderStart);
+                monitor->AddEvents(static_cast<uint32_t>(seqEvents_.size()));
+            }
             seqEvents_.clear();
+            loopStarts_.clear();
         }
 
         offset += processed;
         rest -= processed;
     }
+
+    this->UpdateLevelMeter(length);
+    loopCache_.EndCallback();
+
+    if (recorder_ != nullptr)
+    {
+        recorder_->EndCallback(length);
+    }
+
+    if (monitor != NULL)
+    {
+        uint32_t    activeVoices = 0;
+        for (auto oscillator: oscillators_) {
+            activeVoices += oscillator->IsRunning() ? 1 : 0;
+        }
+        monitor->SetActiveVoices(activeVoices);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::UpdateLevelMeter
+//  ---------------------------------------------------------------------------
+inline void
+Synthesizer::UpdateLevelMeter(const uint32_t length)
+{
+    levelMeter_.BeginUpdate(length, samplingRate_);
+
+    //  tracks : measured by each oscillator while mixing
+    const int   numOfMeters = std::min<int>(static_cast<int>(oscillators_.size()), levelMeter_.GetMaxNumberOfTracks());
+    for (int oscNo = 0; oscNo < numOfMeters; ++oscNo)
+    {
+        int32_t     peak;
+        uint64_t    sumOfSquares;
+        oscillators_[oscNo]->GetLevel(peak, sumOfSquares);
+        if (isLoopCacheActive_)
+        {
+            loopCache_.TakeLevel(oscNo, peak, sumOfSquares);
+        }
+        levelMeter_.UpdateTrack(oscNo, peak, sumOfSquares);
+    }
+
+    //  master : measured while mixing. all the buses of the stems
+    levelMeter_.UpdateMaster(mixLevel_.peak, mixLevel_.sumOfSquares);
+
+    levelMeter_.EndUpdate();
 }
 
 #pragma mark -
@@ -168,6 +438,7 @@ Synthesizer::SetSequencer(Sequencer *seq)
 {
     seq_ = seq;
     seq_->AddListener(this);
+    seq_->SetTraceRecorder(recorder_);
 }
 
 //  ---------------------------------------------------------------------------
@@ -200,26 +471,124 @@ Synthesizer::StopSequence(uint64_t hostTime)
 void
 Synthesizer::CleanupOscillators()
 {
-    for (size_t oscNo = 0; oscNo < oscillators_.size(); ++oscNo)
+    //  the audio thread must have been stopped
+    for (size_t oscNo = 0; oscNo < latestOscillators_.size(); ++oscNo)
     {
-        delete oscillators_[oscNo];
+        delete latestOscillators_[oscNo];
     }
+    for (auto oscillator: retiredOscillators_) {
+        delete oscillator;
+    }
+    latestOscillators_.clear();
+    retiredOscillators_.clear();
+    pendingOscillators_.clear();
     oscillators_.clear();
 }
 
+//  ---------------------------------------------------------------------------
+//      Synthesizer::TakePendingOscillators
+//  ---------------------------------------------------------------------------
+//  called at the beginning of a callback. both vectors are reserved, so the
+//  swap never allocates.
+inline void
+Synthesizer::TakePendingOscillators(void)
+{
+    std::unique_lock<std::mutex> lock(pendingMutex_, std::try_to_lock);
+    if (lock.owns_lock())
+    {
+        oscillators_.swap(pendingOscillators_);
+        soundVersion_ = pendingSoundVersion_;
+        hasPendingOscillators_.store(false, std::memory_order_release);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::CollectRetiredOscillators
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::CollectRetiredOscillators(void)
+{
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    if (!hasPendingOscillators_.load(std::memory_order_acquire))
+    {
+        for (auto oscillator: retiredOscillators_) {
+            delete oscillator;
+        }
+        retiredOscillators_.clear();
+    }
+}
+
 //  ---------------------------------------------------------------------------
 //      Synthesizer::SetSoundSet
 //  ---------------------------------------------------------------------------
 void
 Synthesizer::SetSoundSet(const std::vector<std::string> &soundfiles)
 {
-    CleanupOscillators();
+    this->CollectRetiredOscillators();
+    loopCache_.Clear();
 
-    for (const auto &soundfile: soundfiles) {
+    //  a track keeps its oscillator(voice, amp & pan) if its sound is unchanged,
+    //  so tracks can be added or removed while playing.
+    std::vector<DrumOscillator*>    oscillators;
+    oscillators.reserve(std::max<size_t>(soundfiles.size(), Sequencer::kMaxNumberOfTracks));
+    std::vector<bool>   isReused(latestOscillators_.size(), false);
+    for (size_t trackNo = 0; trackNo < soundfiles.size(); ++trackNo) {
+        const bool  isSameSound = (trackNo < latestOscillators_.size()) && (soundfiles_[trackNo] == soundfiles[trackNo]);
+        if (isSameSound && (latestOscillators_[trackNo]->GetSilenceLevel() == silenceLevel_)) {
+            oscillators.push_back(latestOscillators_[trackNo]);
+            isReused[trackNo] = true;
+            continue;
+        }
         DrumOscillator* osc = new DrumOscillator(samplingRate_);
-        osc->LoadAudioFileInResourceFolder(soundfile);
-        osc->SetPanPosition(64);
-        oscillators_.push_back(osc);
+        osc->SetSilenceLevel(silenceLevel_);
+        osc->LoadAudioFile(*sampleLoader_, soundfiles[trackNo]);
+        if (isSameSound) {
+            //  trimmed again : the amp, pan & pitch are kept
+            osc->SetAmpCoefficient(latestOscillators_[trackNo]->GetAmpCoefficient());
+            osc->SetPanPosition(latestOscillators_[trackNo]->GetPanPosition());
+            osc->SetTranspose(latestOscillators_[trackNo]->GetTranspose());
+            osc->SetTune(latestOscillators_[trackNo]->GetTune());
+        } else {
+            osc->SetPanPosition(64);
+        }
+        osc->SetReleaseLevel(releaseLevel_);
+        osc->SetRenderKernel(renderKernel_);
+        oscillators.push_back(osc);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(oscillatorsMutex_);
+        latestOscillators_.swap(oscillators);
+        ++latestSoundVersion_;  //  the loops observed with the previous set are never rendered with this one
+    }
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pendingOscillators_.assign(latestOscillators_.begin(), latestOscillators_.end());
+        pendingSoundVersion_ = latestSoundVersion_;
+        for (size_t trackNo = 0; trackNo < oscillators.size(); ++trackNo) {
+            if (!isReused[trackNo]) {
+                retiredOscillators_.push_back(oscillators[trackNo]);
+            }
+        }
+        hasPendingOscillators_.store(true, std::memory_order_release);
+    }
+
+    soundfiles_ = soundfiles;
+    if (recorder_ != nullptr)
+    {
+        recorder_->RecordSoundSet(soundfiles);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetRenderKernel
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetRenderKernel(const int kernel)
+{
+    renderKernel_ = kernel;
+    for (auto oscillator: latestOscillators_) {
+        oscillator->SetRenderKernel(kernel);
     }
 }
 
@@ -229,8 +598,12 @@ Synthesizer::SetSoundSet(const std::vector<std::string> &soundfiles)
 void
 Synthesizer::SetAmpCoefficient(const int partNo, const int32_t ampCoef)
 {
-    if (static_cast<size_t>(partNo) < oscillators_.size()) {
-        oscillators_[partNo]->SetAmpCoefficient(ampCoef);
+    if (static_cast<size_t>(partNo) < latestOscillators_.size()) {
+        latestOscillators_[partNo]->SetAmpCoefficient(ampCoef);
+        this->UpdateParamVersion(partNo);
+        if (recorder_ != nullptr) {
+            recorder_->RecordNow(TraceRecorder::kTraceType_AmpCoefficient, partNo, ampCoef, 0.0f);
+        }
     }
 }
 
@@ -240,7 +613,290 @@ Synthesizer::SetAmpCoefficient(const int partNo, const int32_t ampCoef)
 void
 Synthesizer::SetPanPosition(const int partNo, const int pan)
 {
-    if (static_cast<size_t>(partNo) < oscillators_.size()) {
-        oscillators_[partNo]->SetPanPosition(pan);
+    if (static_cast<size_t>(partNo) < latestOscillators_.size()) {
+        latestOscillators_[partNo]->SetPanPosition(pan);
+        this->UpdateParamVersion(partNo);
+        if (recorder_ != nullptr) {
+            recorder_->RecordNow(TraceRecorder::kTraceType_PanPosition, partNo, pan, 0.0f);
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetTranspose
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetTranspose(const int partNo, const int32_t semitones)
+{
+    if (static_cast<size_t>(partNo) < latestOscillators_.size()) {
+        latestOscillators_[partNo]->SetTranspose(semitones);
+        this->UpdateParamVersion(partNo);
+        if (recorder_ != nullptr) {
+            recorder_->RecordNow(TraceRecorder::kTraceType_Transpose, partNo, semitones, 0.0f);
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetTune
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetTune(const int partNo, const int32_t cents)
+{
+    if (static_cast<size_t>(partNo) < latestOscillators_.size()) {
+        latestOscillators_[partNo]->SetTune(cents);
+        this->UpdateParamVersion(partNo);
+        if (recorder_ != nullptr) {
+            recorder_->RecordNow(TraceRecorder::kTraceType_Tune, partNo, cents, 0.0f);
+        }
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetTrackBus
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetTrackBus(const int partNo, const int bus)
+{
+    if ((partNo >= 0) && (static_cast<size_t>(partNo) < trackBuses_.size())) {
+        trackBuses_[partNo].store(bus, std::memory_order_relaxed);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::GetTrackBus
+//  ---------------------------------------------------------------------------
+int
+Synthesizer::GetTrackBus(const int partNo) const
+{
+    if ((partNo >= 0) && (static_cast<size_t>(partNo) < trackBuses_.size())) {
+        return trackBuses_[partNo].load(std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetSilenceLevel
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetSilenceLevel(const int32_t level)
+{
+    const int32_t   silenceLevel = std::min<int32_t>(std::max<int32_t>(level, 0), 0x7FFF);
+    if (silenceLevel == silenceLevel_) {
+        return;
+    }
+    silenceLevel_ = silenceLevel;
+    if (recorder_ != nullptr) {
+        recorder_->RecordNow(TraceRecorder::kTraceType_SilenceLevel, silenceLevel, 0, 0.0f);
+    }
+    if (!soundfiles_.empty()) {
+        const std::vector<std::string>  soundfiles(soundfiles_);
+        this->SetSoundSet(soundfiles);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetReleaseLevel
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetReleaseLevel(const int32_t level)
+{
+    releaseLevel_ = std::min<int32_t>(std::max<int32_t>(level, 0), 0x7FFF);
+    for (size_t partNo = 0; partNo < latestOscillators_.size(); ++partNo) {
+        latestOscillators_[partNo]->SetReleaseLevel(releaseLevel_);
+        this->UpdateParamVersion(static_cast<int>(partNo));
+    }
+    if (recorder_ != nullptr) {
+        recorder_->RecordNow(TraceRecorder::kTraceType_ReleaseLevel, releaseLevel_, 0, 0.0f);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::GetSampleInfo
+//  ---------------------------------------------------------------------------
+bool
+Synthesizer::GetSampleInfo(const int partNo, DrumOscillator::SampleInfo& info) const
+{
+    if (static_cast<size_t>(partNo) >= latestOscillators_.size()) {
+        return false;
+    }
+    info = latestOscillators_[partNo]->GetSampleInfo();
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::GetTrackLevel
+//  ---------------------------------------------------------------------------
+bool
+Synthesizer::GetTrackLevel(const int partNo, LevelMeter::Level& level) const
+{
+    if (static_cast<size_t>(partNo) >= latestOscillators_.size()) {
+        return false;
+    }
+    return levelMeter_.GetTrackLevel(partNo, level);
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::GetMasterLevel
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::GetMasterLevel(LevelMeter::Level& level) const
+{
+    levelMeter_.GetMasterLevel(level);
+}
+
+#pragma mark - trace record/replay
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetTraceRecorder
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetTraceRecorder(TraceRecorder* recorder)
+{
+    recorder_ = recorder;
+    if (seq_ != nullptr)
+    {
+        seq_->SetTraceRecorder(recorder);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::RecordState
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::RecordState(void)
+{
+    if (seq_ != nullptr)
+    {
+        seq_->RecordState();
+    }
+    recorder_->RecordNow(TraceRecorder::kTraceType_SilenceLevel, silenceLevel_, 0, 0.0f);
+    recorder_->RecordNow(TraceRecorder::kTraceType_ReleaseLevel, releaseLevel_, 0, 0.0f);
+    //  a set swapped while the snapshot was pending has not been recorded yet.
+    //  recorded before the oscillators, which it replaces
+    const int   soundSet = recorder_->GetSoundSet();
+    if (soundSet > 0)
+    {
+        recorder_->RecordNow(TraceRecorder::kTraceType_SoundSet, soundSet, 0, 0.0f);
+    }
+    const int   numOfOscillators = static_cast<int>(oscillators_.size());
+    for (int oscNo = 0; oscNo < numOfOscillators; ++oscNo)
+    {
+        recorder_->RecordNow(TraceRecorder::kTraceType_AmpCoefficient, oscNo, oscillators_[oscNo]->GetAmpCoefficient(), 0.0f);
+        recorder_->RecordNow(TraceRecorder::kTraceType_PanPosition, oscNo, oscillators_[oscNo]->GetPanPosition(), 0.0f);
+        recorder_->RecordNow(TraceRecorder::kTraceType_Transpose, oscNo, oscillators_[oscNo]->GetTranspose(), 0.0f);
+        recorder_->RecordNow(TraceRecorder::kTraceType_Tune, oscNo, oscillators_[oscNo]->GetTune(), 0.0f);
+        bool        isRunning;
+        uint32_t    address;
+        int32_t     velocity;
+        int32_t     pitch;
+        oscillators_[oscNo]->GetVoiceState(isRunning, address, velocity, pitch);
+        recorder_->RecordNow(TraceRecorder::kTraceType_VoiceState, oscNo, static_cast<int32_t>(address), isRunning ? 1.0f : 0.0f);
+        recorder_->RecordNow(TraceRecorder::kTraceType_VoiceVelocity, oscNo, velocity, static_cast<float>(pitch));
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::RestoreVoiceState
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::RestoreVoiceState(const int partNo, const bool isRunning, const uint32_t address, const int32_t velocity,
+                               const int32_t pitch)
+{
+    if (static_cast<size_t>(partNo) < latestOscillators_.size()) {
+        latestOscillators_[partNo]->SetVoiceState(isRunning, address, velocity, pitch);
+        this->UpdateParamVersion(partNo);
+    }
+}
+
+#pragma mark - loop cache
+//  ---------------------------------------------------------------------------
+//      Synthesizer::SetLoopCacheEnabled
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::SetLoopCacheEnabled(const bool enabled, const bool background)
+{
+    if (enabled)
+    {
+        loopCache_.Start(this, background);
+    }
+    else
+    {
+        loopCache_.Stop();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::UpdateLoopCache
+//  ---------------------------------------------------------------------------
+void
+Synthesizer::UpdateLoopCache(void)
+{
+    loopCache_.Update();
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::UpdateParamVersion
+//  ---------------------------------------------------------------------------
+//  called after the parameter is changed, so a loop rendered with the new
+//  value is never played as the old one.
+inline void
+Synthesizer::UpdateParamVersion(const int partNo)
+{
+    if (partNo < LoopCache::kMaxNumberOfTracks)
+    {
+        paramVersions_[partNo].fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Synthesizer::RenderLoop                         [worker thread]
+//  ---------------------------------------------------------------------------
+bool
+Synthesizer::RenderLoop(const int trackNo, LoopCache::LoopInfo& info, int16_t* left, int16_t* right)
+{
+    std::lock_guard<std::mutex> lock(oscillatorsMutex_);
+    if ((trackNo >= static_cast<int>(latestOscillators_.size())) ||
+        (paramVersions_[trackNo].load(std::memory_order_acquire) != info.key.paramVersion) ||
+        (latestSoundVersion_ != info.key.soundVersion))
+    {
+        return false;
+    }
+
+    //  a voice of the track is played from the voice state at the loop start.
+    //  only the parameters are read from the track : the audio thread plays it
+    const DrumOscillator&   track = *latestOscillators_[trackNo];
+    DrumOscillator  voice(samplingRate_);
+    voice.SetRenderKernel(track.GetRenderKernel());
+    voice.SetSilenceLevel(track.GetSilenceLevel());
+    voice.SetReleaseLevel(track.GetReleaseLevel());
+    voice.SetAmpCoefficient(track.GetAmpCoefficient());
+    voice.SetPanPosition(track.GetPanPosition());
+    voice.SetTranspose(track.GetTranspose());
+    voice.SetTune(track.GetTune());
+    voice.SetSample(track.GetSample());
+    voice.SetVoiceState(info.isRunning, info.address, info.velocity, info.pitch);
+    ::memset(left, 0, info.key.loopFrames * sizeof(int16_t));
+    ::memset(right, 0, info.key.loopFrames * sizeof(int16_t));
+
+    uint32_t    position = 0;
+    for (uint32_t triggerNo = 0; triggerNo <= info.numberOfTriggers; ++triggerNo)
+    {
+        const uint32_t  end = (triggerNo < info.numberOfTriggers) ? info.triggers[triggerNo] : info.key.loopFrames;
+        if ((end < position) || (end > info.key.loopFrames))
+        {
+            return false;
+        }
+        if (end > position)
+        {
+            int16_t*    output[] = { left + position, right + position };
+            voice.Process(output, static_cast<int>(end - position));
+            position = end;
+        }
+        if (triggerNo < info.numberOfTriggers)
+        {
+            voice.TriggerOn(info.velocities[triggerNo], info.pitches[triggerNo]);
+        }
     }
+    voice.GetVoiceState(info.isRunning, info.address, info.velocity, info.pitch);
+    return true;
 }
@@ -8,27 +8,73 @@
 
 #pragma once
 
-class Synthesizer : public AudioIOListener, SequencerListener
+class Synthesizer : public AudioIOListener, SequencerListener, LoopCacheRenderer
 {
 public:
-    Synthesizer(float samplingRate);
+    enum
+    {
+        kMaxNumberOfBuses = 64,     //  stereo buses of ProcessStems
+    };
+
+    /* loader : reads the sounds of SetSoundSet(not owned). NULL : WAV files by their names */
+    Synthesizer(float samplingRate, const class SampleLoader* loader = NULL);
     ~Synthesizer(void);
 
     void    SetSequencer(Sequencer *seq);
 
     //  AudioIOListener
-    void    ProcessReplacing(AudioIO* io, int16_t** buffer, const uint32_t length);
+    void    ProcessReplacing(RenderContext* io, int16_t** buffer, const uint32_t length);
+
+    //  stems : renders each track into its bus in a single pass(offline).
+    //  buffer : L & R of each bus(numberOfBuses * 2 channels). a track routed to
+    //  no bus(-1 or numberOfBuses or more) is advanced without being rendered.
+    void    ProcessStems(int16_t** buffer, const int numberOfBuses, const uint32_t length);
+    /* bus 0 by default. ProcessReplacing mixes all the tracks regardless of it */
+    void    SetTrackBus(const int partNo, const int bus);
+    int     GetTrackBus(const int partNo) const;
 
     //  SequencerListener
-    void    NoteOnViaSequencer(int frame, const std::vector<int> &parts, int step);
+    void    NoteOnViaSequencer(int frame, const std::vector<int> &parts, const std::vector<int32_t> &velocities,
+                               const std::vector<int32_t> &pitches, int step);
+    void    LoopStartViaSequencer(int frame, const float stepFrameLength, const float stepFrame, const int numberOfSteps);
 
     void    StartSequence(uint64_t hostTime, float tempo);
     void    StopSequence(uint64_t hostTime);
 
     void    SetSoundSet(const std::vector<std::string> &soundfiles);
+    const std::vector<std::string>&   GetSoundSet(void) const     { return soundfiles_; }
+
+    void    SetRenderKernel(const int kernel);  //  DrumOscillator::kRenderKernel_xxx
 
     void    SetAmpCoefficient(const int partNo, const int32_t ampCoef);
     void    SetPanPosition(const int partNo, const int pan);
+    /* DrumOscillator::kMaxTranspose semitones & DrumOscillator::kMaxTune cents at most */
+    void    SetTranspose(const int partNo, const int32_t semitones);
+    void    SetTune(const int partNo, const int32_t cents);
+
+    /* 0 - 0x7FFF : the silence at the end of the sounds is trimmed. the sounds are reloaded if changed */
+    void    SetSilenceLevel(const int32_t level);
+    int32_t GetSilenceLevel(void) const         { return silenceLevel_; }
+    /* 0(off) - 0x7FFF : the voices end when the rest of their sounds is below it */
+    void    SetReleaseLevel(const int32_t level);
+    int32_t GetReleaseLevel(void) const         { return releaseLevel_; }
+    bool    GetSampleInfo(const int partNo, DrumOscillator::SampleInfo& info) const;
+
+    bool    GetTrackLevel(const int partNo, LevelMeter::Level& level) const;
+    void    GetMasterLevel(LevelMeter::Level& level) const;
+
+    void    SetTraceRecorder(class TraceRecorder* recorder);
+    void    RestoreVoiceState(const int partNo, const bool isRunning, const uint32_t address,
+                              const int32_t velocity = DrumOscillator::kVelocityUnity, const int32_t pitch = 0);
+
+    /* background : false to render the loops only in UpdateLoopCache */
+    void    SetLoopCacheEnabled(const bool enabled, const bool background = true);
+    bool    IsLoopCacheEnabled(void) const      { return loopCache_.IsEnabled(); }
+    void    UpdateLoopCache(void);
+    /* total size of the loops(default LoopCache::kDefaultMaxBytes). the tracks beyond it are rendered live */
+    void    SetLoopCacheMaxBytes(const size_t bytes)    { loopCache_.SetMaxBytes(bytes); }
+    uint64_t    GetNumberOfCachedFrames(void) const     { return loopCache_.GetNumberOfCachedFrames(); }
+    size_t  GetNumberOfCachedBytes(void) const  { return loopCache_.GetNumberOfBytes(); }
 
 private:
     Synthesizer(const Synthesizer& other) = delete;
@@ -38,7 +84,8 @@ private:
         int32_t frame;
         int     paramType;
         int     value0;
-        int     value1;
+        int     value1;     //  trigger : velocity
+        int     value2;     //  trigger : pitch
     } SequencerEvent;
     static inline bool SortEventFunctor(const Synthesizer::SequencerEvent& left,
                                         const Synthesizer::SequencerEvent& right)
@@ -46,13 +93,51 @@ private:
         return (left.frame == right.frame) ? (left.paramType < right.paramType) : (left.frame < right.frame);
     }
 
-    void    RenderAudio(AudioIO* io, int16_t** buffer, int length);
+    void    Process(RenderContext* io, int16_t** buffer, const int numberOfBuses, const uint32_t length);
+    void    RenderAudio(RenderContext* io, int16_t** buffer, const int numberOfBuses, int length);
+    int     GetBus(const int numberOfBuses, const int oscNo) const;
     void    DecodeSeqEvent(const SequencerEvent* event);
+    void    UpdateLevelMeter(const uint32_t length);
+    void    RecordState(void);
+
+    void    UpdateParamVersion(const int partNo);
 
+    //  LoopCacheRenderer
+    bool    RenderLoop(const int trackNo, LoopCache::LoopInfo& info, int16_t* left, int16_t* right);
+
+    void    TakePendingOscillators(void);
+    void    CollectRetiredOscillators(void);
     void    CleanupOscillators();
 
+    enum { kMaxNumberOfMeteredTracks = 256, kMaxNumberOfLoopStarts = 16 };
+    enum { kMasterBus = 0 };    //  numberOfBuses of ProcessReplacing
+
     const float samplingRate_;
+    const class SampleLoader*   sampleLoader_;
     Sequencer*  seq_;
     std::vector<SequencerEvent> seqEvents_;
-    std::vector<DrumOscillator*> oscillators_;
+    std::vector<DrumOscillator*> oscillators_;          //  audio thread
+    std::vector<DrumOscillator*> latestOscillators_;    //  non real-time : taken by the audio thread at the next callback
+    std::vector<DrumOscillator*> pendingOscillators_;
+    std::vector<DrumOscillator*> retiredOscillators_;   //  deleted once the audio thread has switched
+    std::atomic<bool>   hasPendingOscillators_;
+    std::mutex  pendingMutex_;          //  the audio thread only try_locks
+    std::vector<std::string>    soundfiles_;
+    int         renderKernel_;
+    int32_t     silenceLevel_;          //  of the sounds loaded next
+    int32_t     releaseLevel_;
+    LevelMeter  levelMeter_;
+    LevelMeter::BlockLevel  mixLevel_;      //  audio thread : master of the callback
+    class TraceRecorder*    recorder_;
+    LoopCache   loopCache_;
+    bool        isLoopCacheActive_;     //  in this callback
+    std::vector<LoopCache::Key> loopStarts_;    //  referred by the seq events
+    uint32_t    loopPosition_;          //  frames since the last loop start
+    bool        isLoopPositionValid_;
+    std::vector< std::atomic<uint32_t> >    paramVersions_;     //  amp & pan of each track
+    std::vector< std::atomic<int> >     trackBuses_;            //  of ProcessStems
+    uint32_t    soundVersion_;          //  of oscillators_
+    uint32_t    latestSoundVersion_;    //  of latestOscillators_
+    uint32_t    pendingSoundVersion_;
+    std::mutex  oscillatorsMutex_;      //  latestOscillators_ : non real-time threads
 };
@@ -0,0 +1,325 @@
+//
+//  TraceRecorder.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+
+#include "TraceRecorder.h"
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::TraceRecorder
+//  ---------------------------------------------------------------------------
+TraceRecorder::TraceRecorder(const size_t capacity) :
+header_(),
+records_(capacity),
+isRecording_(false),
+snapshotRequested_(false),
+reserved_(0),
+end_(capacity),
+writers_(0),
+dropped_(0),
+soundSet_(0),
+renderedFrames_(0),
+callbackStart_(0),
+soundSets_(),
+soundSetsMutex_()
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::~TraceRecorder
+//  ---------------------------------------------------------------------------
+TraceRecorder::~TraceRecorder(void)
+{
+}
+
+#pragma mark - non real-time
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::Start
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::Start(const float samplingRate, const int numberOfTracks, const int numberOfSteps, const int stepsPerBeat,
+                     const std::vector<std::string>& soundfiles)
+{
+    //  no slot of the previous recording is written after the reset
+    isRecording_.store(false, std::memory_order_seq_cst);
+    this->WaitForWriters();
+
+    header_.magic = kFileMagic;
+    header_.version = kFileVersion;
+    header_.samplingRate = samplingRate;
+    header_.numberOfTracks = numberOfTracks;
+    header_.numberOfSteps = numberOfSteps;
+    header_.stepsPerBeat = stepsPerBeat;
+    header_.numberOfSoundSets = 0;
+    header_.reserved = 0;
+    header_.numberOfRecords = 0;
+    {
+        std::lock_guard<std::mutex> lock(soundSetsMutex_);
+        soundSets_.clear();
+        soundSets_.push_back(soundfiles);
+        soundSet_.store(0, std::memory_order_relaxed);
+    }
+    reserved_.store(0, std::memory_order_relaxed);
+    end_.store(records_.size(), std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+
+    //  nothing is recorded until the audio thread takes the initial snapshot
+    snapshotRequested_.store(true, std::memory_order_relaxed);
+    isRecording_.store(true, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::Stop
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::Stop(void)
+{
+    isRecording_.store(false, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::WriteToFile
+//  ---------------------------------------------------------------------------
+bool
+TraceRecorder::WriteToFile(const std::string& path)
+{
+    isRecording_.store(false, std::memory_order_seq_cst);
+    this->WaitForWriters();
+
+    //  every slot before the first overflow has been written
+    const size_t    numOfValidRecords = std::min(reserved_.load(std::memory_order_acquire), end_.load(std::memory_order_acquire));
+
+    FILE*   fp = ::fopen(path.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(soundSetsMutex_);
+    FileHeader  header = header_;
+    header.numberOfSoundSets = static_cast<uint32_t>(soundSets_.size());
+    header.numberOfRecords = numOfValidRecords;
+    bool    result = (::fwrite(&header, sizeof(header), 1, fp) == 1);
+    for (const auto& soundSet : soundSets_)
+    {
+        const uint32_t  numOfSounds = static_cast<uint32_t>(soundSet.size());
+        result = result && (::fwrite(&numOfSounds, sizeof(numOfSounds), 1, fp) == 1);
+        for (const auto& soundfile : soundSet)
+        {
+            const uint32_t  length = static_cast<uint32_t>(soundfile.size());
+            result = result && (::fwrite(&length, sizeof(length), 1, fp) == 1);
+            result = result && (::fwrite(soundfile.data(), 1, length, fp) == length);
+        }
+    }
+    if (numOfValidRecords > 0)
+    {
+        result = result && (::fwrite(&records_[0], sizeof(Record), numOfValidRecords, fp) == numOfValidRecords);
+    }
+    result = (::fclose(fp) == 0) && result;
+    return result;
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::RecordSoundSet
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::RecordSoundSet(const std::vector<std::string>& soundfiles)
+{
+    if (!this->IsRecording())
+    {
+        return;
+    }
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(soundSetsMutex_);
+        index = static_cast<int>(soundSets_.size());
+        soundSets_.push_back(soundfiles);
+        soundSet_.store(index, std::memory_order_release);
+    }
+    //  dropped while the initial snapshot is pending : recorded with the snapshot
+    this->RecordNow(kTraceType_SoundSet, index, 0, 0.0f);
+}
+
+#pragma mark - slots
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::Reserve
+//  ---------------------------------------------------------------------------
+//  NULL : not recorded. otherwise Commit() must be called once the slots are written
+inline TraceRecorder::Record*
+TraceRecorder::Reserve(const size_t count)
+{
+    if (!isRecording_.load(std::memory_order_relaxed))
+    {
+        return NULL;
+    }
+    //  announced before isRecording_ is checked again : either Start() waits
+    //  for this writer, or this writer sees that the recording has been stopped
+    writers_.fetch_add(1, std::memory_order_seq_cst);
+    if (!isRecording_.load(std::memory_order_seq_cst) || snapshotRequested_.load(std::memory_order_relaxed))
+    {
+        writers_.fetch_sub(1, std::memory_order_release);
+        return NULL;
+    }
+    const size_t    index = reserved_.fetch_add(count, std::memory_order_relaxed);
+    if (index + count > records_.size())
+    {
+        //  keep the records contiguous : nothing after the first overflow is valid
+        size_t  end = end_.load(std::memory_order_relaxed);
+        while ((index < end) && !end_.compare_exchange_weak(end, index, std::memory_order_relaxed))
+        {
+        }
+        dropped_.fetch_add(count, std::memory_order_relaxed);
+        writers_.fetch_sub(1, std::memory_order_release);
+        return NULL;
+    }
+    return &records_[index];
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::Commit
+//  ---------------------------------------------------------------------------
+inline void
+TraceRecorder::Commit(void)
+{
+    writers_.fetch_sub(1, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::WaitForWriters
+//  ---------------------------------------------------------------------------
+//  non real-time. the writers never block, so this is short
+void
+TraceRecorder::WaitForWriters(void) const
+{
+    while (writers_.load(std::memory_order_acquire) > 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+#pragma mark - audio thread
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::TakeSnapshotRequest
+//  ---------------------------------------------------------------------------
+bool
+TraceRecorder::TakeSnapshotRequest(void)
+{
+    if (isRecording_.load(std::memory_order_acquire) && snapshotRequested_.load(std::memory_order_relaxed))
+    {
+        renderedFrames_.store(0, std::memory_order_relaxed);
+        callbackStart_ = 0;
+        snapshotRequested_.store(false, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::BeginCallback
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::BeginCallback(const uint32_t length)
+{
+    callbackStart_ = renderedFrames_.load(std::memory_order_relaxed);
+    this->RecordAt(0, kTraceType_Callback, static_cast<int32_t>(length), 0, 0.0f);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::EndCallback
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::EndCallback(const uint32_t length)
+{
+    renderedFrames_.store(callbackStart_ + length, std::memory_order_relaxed);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::RecordAt
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::RecordAt(const int offset, const int type, const int32_t value0, const int32_t value1, const float floatValue)
+{
+    Record* record = this->Reserve(1);
+    if (record != NULL)
+    {
+        *record = { callbackStart_ + offset, type, value0, value1, floatValue };
+        this->Commit();
+    }
+}
+
+#pragma mark - any thread
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::RecordNow
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::RecordNow(const int type, const int32_t value0, const int32_t value1, const float floatValue)
+{
+    Record* record = this->Reserve(1);
+    if (record != NULL)
+    {
+        *record = { renderedFrames_.load(std::memory_order_relaxed), type, value0, value1, floatValue };
+        this->Commit();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::RecordTrack
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::RecordTrack(const int trackNo, const int numberOfSteps, const uint32_t* bits)
+{
+    const int   numOfWords = (numberOfSteps + 31) / 32;
+    Record*     record = this->Reserve(1 + numOfWords);
+    if (record != NULL)
+    {
+        const uint64_t  sampleTime = renderedFrames_.load(std::memory_order_relaxed);
+        *(record++) = { sampleTime, kTraceType_TrackUpdate, trackNo, numberOfSteps, 0.0f };
+        for (int word = 0; word < numOfWords; ++word)
+        {
+            *(record++) = { sampleTime, kTraceType_TrackBits, word, static_cast<int32_t>(bits[word]), 0.0f };
+        }
+        this->Commit();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceRecorder::RecordLanes
+//  ---------------------------------------------------------------------------
+void
+TraceRecorder::RecordLanes(const int trackNo, const int numberOfSteps, const uint16_t* velocities,
+                           const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches)
+{
+    //  only the steps which are not x1.0(Q15), always(Q15), on time and at the pitch of the track
+    const auto  isChanged = [&](const int step) {
+        return (velocities[step] != 0x8000) || (probabilities[step] != 0x8000) || (delays[step] != 0) || (pitches[step] != 0);
+    };
+    int     numOfChanged = 0;
+    for (int step = 0; step < numberOfSteps; ++step)
+    {
+        numOfChanged += isChanged(step) ? 1 : 0;
+    }
+    Record*     record = this->Reserve(1 + numOfChanged);
+    if (record != NULL)
+    {
+        const uint64_t  sampleTime = renderedFrames_.load(std::memory_order_relaxed);
+        *(record++) = { sampleTime, kTraceType_LaneUpdate, trackNo, numOfChanged, 0.0f };
+        for (int step = 0; step < numberOfSteps; ++step)
+        {
+            if (isChanged(step))
+            {
+                *(record++) = { sampleTime, kTraceType_LaneStep,
+                                static_cast<int32_t>(static_cast<uint32_t>(step) | (static_cast<uint32_t>(pitches[step]) << 16)),
+                                static_cast<int32_t>(velocities[step] | (static_cast<uint32_t>(probabilities[step]) << 16)),
+                                static_cast<float>(delays[step]) };
+            }
+        }
+        this->Commit();
+    }
+}
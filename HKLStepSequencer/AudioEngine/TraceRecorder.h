@@ -0,0 +1,121 @@
+//
+//  TraceRecorder.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//  Records every command, pattern edit, parameter change and render callback
+//  boundary with sample timestamps so that TraceReplayer can drive the same
+//  Synthesizer/Sequencer deterministically offline.
+//
+//  Records are written into a buffer preallocated by Start(). Reserving a slot
+//  is a single atomic add, so it is safe to record from the audio thread and
+//  from UI threads at the same time. When the buffer is full, further records
+//  are dropped and counted. Start() and WriteToFile() wait for the writers
+//  which have already reserved their slots, so a recording restarted while
+//  they write is never mixed with records of the previous one.
+class TraceRecorder
+{
+public:
+    enum
+    {
+        kTraceType_Callback = 0,        //  value0 : length
+        kTraceType_Command,             //  value0 : command, floatValue : parameter
+        kTraceType_TrackUpdate,         //  value0 : track, value1 : number of steps. followed by TrackBits
+        kTraceType_TrackBits,           //  value0 : index of 32 steps, value1 : bits(LSB first)
+        kTraceType_SoundSet,            //  value0 : index in the sound set table
+        kTraceType_AmpCoefficient,      //  value0 : track, value1 : coefficient
+        kTraceType_PanPosition,         //  value0 : track, value1 : position
+        kTraceType_SequencerState,      //  value0 : running, value1 : current step, floatValue : step length
+        kTraceType_SequencerFrame,      //  value0 : number of steps, value1 : trigger, floatValue : current frame
+        kTraceType_VoiceState,          //  value0 : track, value1 : address, floatValue : 1 if running
+        kTraceType_LaneUpdate,          //  value0 : track, value1 : number of LaneSteps following(the others : default)
+        kTraceType_LaneStep,            //  value0 : step | pitch << 16, value1 : velocity | probability << 16, floatValue : delay
+        kTraceType_RandomState,         //  value0 : seed, value1 : loop count, floatValue : 1 if the loop count is valid
+        kTraceType_DelayedTrigger,      //  value0 : track | step << 16 | pitch << 24, value1 : frames, floatValue : velocity
+        kTraceType_VoiceVelocity,       //  value0 : track, value1 : velocity, floatValue : pitch. follows VoiceState
+        kTraceType_SilenceLevel,        //  value0 : level
+        kTraceType_ReleaseLevel,        //  value0 : level
+        kTraceType_Transpose,           //  value0 : track, value1 : semitones
+        kTraceType_Tune,                //  value0 : track, value1 : cents
+    };
+
+    typedef struct {
+        uint64_t    sampleTime;
+        int32_t     type;
+        int32_t     value0;
+        int32_t     value1;
+        float       floatValue;
+    } Record;
+
+    typedef struct {
+        uint32_t    magic;
+        uint32_t    version;
+        float       samplingRate;
+        int32_t     numberOfTracks;
+        int32_t     numberOfSteps;
+        int32_t     stepsPerBeat;
+        uint32_t    numberOfSoundSets;
+        uint32_t    reserved;
+        uint64_t    numberOfRecords;
+    } FileHeader;
+
+    enum { kFileMagic = 0x544C4B48 /* 'HKLT' */, kFileVersion = 1 };
+
+    TraceRecorder(const size_t capacity);
+    ~TraceRecorder(void);
+
+    //  non real-time
+    void    Start(const float samplingRate, const int numberOfTracks, const int numberOfSteps, const int stepsPerBeat,
+                  const std::vector<std::string>& soundfiles);
+    void    Stop(void);
+    bool    IsRecording(void) const     { return isRecording_.load(std::memory_order_acquire); }
+    bool    WriteToFile(const std::string& path);
+    uint64_t    GetNumberOfDroppedRecords(void) const   { return dropped_.load(std::memory_order_relaxed); }
+    void    RecordSoundSet(const std::vector<std::string>& soundfiles);
+
+    //  audio thread
+    bool    TakeSnapshotRequest(void);
+    /* index of the latest set in the file. 0 : the set given to Start() */
+    int     GetSoundSet(void) const     { return soundSet_.load(std::memory_order_acquire); }
+    void    BeginCallback(const uint32_t length);
+    void    EndCallback(const uint32_t length);
+    void    RecordAt(const int offset, const int type, const int32_t value0, const int32_t value1, const float floatValue);
+
+    //  any thread. stamped with the beginning of the next callback
+    void    RecordNow(const int type, const int32_t value0, const int32_t value1, const float floatValue);
+    void    RecordTrack(const int trackNo, const int numberOfSteps, const uint32_t* bits);  //  LSB first
+    void    RecordLanes(const int trackNo, const int numberOfSteps, const uint16_t* velocities,
+                        const uint16_t* probabilities, const uint8_t* delays, const int8_t* pitches);
+
+private:
+    TraceRecorder(const TraceRecorder& other) = delete;
+    const TraceRecorder& operator= (const TraceRecorder& other) = delete;
+
+    Record* Reserve(const size_t count);
+    void    Commit(void);
+    void    WaitForWriters(void) const;
+
+    FileHeader  header_;
+    std::vector<Record>     records_;
+    std::atomic<bool>       isRecording_;
+    std::atomic<bool>       snapshotRequested_;
+    std::atomic<size_t>     reserved_;
+    std::atomic<size_t>     end_;           //  first slot which could not be reserved
+    std::atomic<uint32_t>   writers_;       //  between Reserve() and Commit()
+    std::atomic<uint64_t>   dropped_;
+    std::atomic<int32_t>    soundSet_;      //  written under soundSetsMutex_
+    std::atomic<uint64_t>   renderedFrames_;
+    uint64_t    callbackStart_;     //  audio thread only
+    std::vector< std::vector<std::string> > soundSets_;
+    std::mutex  soundSetsMutex_;
+};
@@ -0,0 +1,358 @@
+//
+//  TraceReplayer.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+
+#include "RenderContext.h"
+#include "Sequencer.h"
+#include "DrumOscillator.h"
+#include "LevelMeter.h"
+#include "LoopCache.h"
+#include "Synthesizer.h"
+
+#include "TraceReplayer.h"
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::TraceReplayer
+//  ---------------------------------------------------------------------------
+TraceReplayer::TraceReplayer(const SampleLoader* loader) :
+sampleLoader_(loader),
+header_(),
+soundSets_(),
+records_()
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::~TraceReplayer
+//  ---------------------------------------------------------------------------
+TraceReplayer::~TraceReplayer(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::Load
+//  ---------------------------------------------------------------------------
+bool
+TraceReplayer::Load(const std::string& path)
+{
+    soundSets_.clear();
+    records_.clear();
+
+    FILE*   fp = ::fopen(path.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    bool    result = (::fread(&header_, sizeof(header_), 1, fp) == 1) &&
+                     (header_.magic == TraceRecorder::kFileMagic) &&
+                     (header_.version == TraceRecorder::kFileVersion);
+    for (uint32_t setNo = 0; result && (setNo < header_.numberOfSoundSets); ++setNo)
+    {
+        uint32_t    numOfSounds = 0;
+        result = (::fread(&numOfSounds, sizeof(numOfSounds), 1, fp) == 1);
+        std::vector<std::string>    soundSet;
+        for (uint32_t soundNo = 0; result && (soundNo < numOfSounds); ++soundNo)
+        {
+            uint32_t    length = 0;
+            result = (::fread(&length, sizeof(length), 1, fp) == 1);
+            std::string soundfile(length, '\0');
+            result = result && ((length == 0) || (::fread(&soundfile[0], 1, length, fp) == length));
+            soundSet.push_back(soundfile);
+        }
+        soundSets_.push_back(soundSet);
+    }
+    if (result && (header_.numberOfRecords > 0))
+    {
+        records_.resize(header_.numberOfRecords);
+        result = (::fread(&records_[0], sizeof(TraceRecorder::Record), records_.size(), fp) == records_.size());
+    }
+    ::fclose(fp);
+
+    if (!result || soundSets_.empty())
+    {
+        soundSets_.clear();
+        records_.clear();
+        return false;
+    }
+    return true;
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::GetNumberOfCallbacks
+//  ---------------------------------------------------------------------------
+size_t
+TraceReplayer::GetNumberOfCallbacks(void) const
+{
+    return std::count_if(records_.begin(), records_.end(), [](const TraceRecorder::Record& record) {
+        return record.type == TraceRecorder::kTraceType_Callback;
+    });
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::ApplyRecord
+//  ---------------------------------------------------------------------------
+size_t
+TraceReplayer::ApplyRecord(Synthesizer& synth, Sequencer& seq, const size_t index) const
+{
+    const TraceRecorder::Record&    record = records_[index];
+    size_t  consumed = 1;
+    switch (record.type)
+    {
+        case TraceRecorder::kTraceType_Command:
+            seq.ReplayCommand(record.value0, record.floatValue);
+            break;
+        case TraceRecorder::kTraceType_TrackUpdate:
+            {
+                uint32_t    words[Sequencer::kWordsPerTrack] = {};
+                while ((index + consumed < records_.size()) &&
+                       (records_[index + consumed].type == TraceRecorder::kTraceType_TrackBits))
+                {
+                    const TraceRecorder::Record&    bits = records_[index + consumed];
+                    if ((bits.value0 >= 0) && (bits.value0 < Sequencer::kWordsPerTrack))
+                    {
+                        words[bits.value0] = static_cast<uint32_t>(bits.value1);
+                    }
+                    ++consumed;
+                }
+                seq.ReplayTrack(record.value0, words, Sequencer::kWordsPerTrack);
+            }
+            break;
+        case TraceRecorder::kTraceType_SoundSet:
+            if (static_cast<size_t>(record.value0) < soundSets_.size())
+            {
+                synth.SetSoundSet(soundSets_[record.value0]);
+            }
+            break;
+        case TraceRecorder::kTraceType_AmpCoefficient:
+            synth.SetAmpCoefficient(record.value0, record.value1);
+            break;
+        case TraceRecorder::kTraceType_PanPosition:
+            synth.SetPanPosition(record.value0, record.value1);
+            break;
+        case TraceRecorder::kTraceType_Transpose:
+            synth.SetTranspose(record.value0, record.value1);
+            break;
+        case TraceRecorder::kTraceType_Tune:
+            synth.SetTune(record.value0, record.value1);
+            break;
+        case TraceRecorder::kTraceType_SilenceLevel:
+            synth.SetSilenceLevel(record.value0);
+            break;
+        case TraceRecorder::kTraceType_ReleaseLevel:
+            synth.SetReleaseLevel(record.value0);
+            break;
+        case TraceRecorder::kTraceType_VoiceState:
+            if ((index + 1 < records_.size()) &&
+                (records_[index + 1].type == TraceRecorder::kTraceType_VoiceVelocity))
+            {
+                synth.RestoreVoiceState(record.value0, record.floatValue != 0.0f, static_cast<uint32_t>(record.value1),
+                                        records_[index + 1].value1, static_cast<int32_t>(records_[index + 1].floatValue));
+                ++consumed;
+            }
+            else
+            {
+                synth.RestoreVoiceState(record.value0, record.floatValue != 0.0f, static_cast<uint32_t>(record.value1));
+            }
+            break;
+        case TraceRecorder::kTraceType_LaneUpdate:
+            {
+                //  the steps not recorded are x1.0, always, on time and at the pitch of the track
+                uint16_t    velocities[Sequencer::kMaxNumberOfSteps], probabilities[Sequencer::kMaxNumberOfSteps];
+                uint8_t     delays[Sequencer::kMaxNumberOfSteps] = {};
+                int8_t      pitches[Sequencer::kMaxNumberOfSteps] = {};
+                std::fill(velocities, velocities + Sequencer::kMaxNumberOfSteps, Sequencer::kVelocityUnity);
+                std::fill(probabilities, probabilities + Sequencer::kMaxNumberOfSteps, Sequencer::kProbabilityAlways);
+                while ((index + consumed < records_.size()) &&
+                       (records_[index + consumed].type == TraceRecorder::kTraceType_LaneStep))
+                {
+                    const TraceRecorder::Record&    lane = records_[index + consumed];
+                    const int   step = lane.value0 & 0xFFFF;
+                    if (step < Sequencer::kMaxNumberOfSteps)
+                    {
+                        velocities[step] = static_cast<uint16_t>(lane.value1 & 0xFFFF);
+                        probabilities[step] = static_cast<uint16_t>(static_cast<uint32_t>(lane.value1) >> 16);
+                        delays[step] = static_cast<uint8_t>(lane.floatValue);
+                        pitches[step] = static_cast<int8_t>(lane.value0 >> 16);
+                    }
+                    ++consumed;
+                }
+                seq.ReplayLanes(record.value0, velocities, probabilities, delays, pitches, Sequencer::kMaxNumberOfSteps);
+            }
+            break;
+        case TraceRecorder::kTraceType_RandomState:
+            if (record.floatValue != 0.0f)
+            {
+                seq.RestoreRandomState(static_cast<uint32_t>(record.value0), static_cast<uint32_t>(record.value1));
+            }
+            else
+            {
+                seq.SetRandomSeed(static_cast<uint32_t>(record.value0));
+            }
+            break;
+        case TraceRecorder::kTraceType_DelayedTrigger:
+            seq.RestoreDelayedTrigger(record.value0 & 0xFFFF, (record.value0 >> 16) & 0xFF, static_cast<int32_t>(record.floatValue),
+                                      static_cast<int8_t>(record.value0 >> 24), static_cast<uint32_t>(record.value1));
+            break;
+        case TraceRecorder::kTraceType_SequencerState:
+            if ((index + 1 < records_.size()) &&
+                (records_[index + 1].type == TraceRecorder::kTraceType_SequencerFrame))
+            {
+                const TraceRecorder::Record&    frame = records_[index + 1];
+                seq.RestoreState(record.value0 != 0, record.value1, frame.floatValue,
+                                 record.floatValue, frame.value0, frame.value1 != 0);
+                ++consumed;
+            }
+            break;
+        default:
+            break;
+    }
+    return consumed;
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::Replay
+//  ---------------------------------------------------------------------------
+bool
+TraceReplayer::Replay(const OutputHandler& handler) const
+{
+    return this->Replay(NULL, 1, handler);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::ReplayStems
+//  ---------------------------------------------------------------------------
+bool
+TraceReplayer::ReplayStems(const std::vector<int>& trackBuses, const int numberOfBuses,
+                           const OutputHandler& handler) const
+{
+    if ((numberOfBuses <= 0) || (numberOfBuses > Synthesizer::kMaxNumberOfBuses))
+    {
+        return false;
+    }
+    return this->Replay(&trackBuses, numberOfBuses, handler);
+}
+
+//  ---------------------------------------------------------------------------
+//      TraceReplayer::Replay
+//  ---------------------------------------------------------------------------
+//  trackBuses : NULL to render the master output
+bool
+TraceReplayer::Replay(const std::vector<int>* trackBuses, const int numberOfBuses, const OutputHandler& handler) const
+{
+    if (soundSets_.empty())
+    {
+        return false;
+    }
+
+    int32_t maxLength = 0;
+    for (const auto& record : records_)
+    {
+        if (record.type == TraceRecorder::kTraceType_Callback)
+        {
+            maxLength = std::max(maxLength, record.value0);
+        }
+    }
+    const int   numOfChannels = numberOfBuses * 2;
+    std::vector< std::vector<int16_t> > channels(numOfChannels, std::vector<int16_t>(maxLength));
+    std::vector<int16_t*>   output(numOfChannels);
+
+    Synthesizer synth(header_.samplingRate, sampleLoader_);
+    Sequencer*  seq = new Sequencer(header_.samplingRate, header_.numberOfTracks,
+                                    header_.numberOfSteps, header_.stepsPerBeat);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(soundSets_[0]);
+    if (trackBuses != NULL)
+    {
+        for (size_t trackNo = 0; trackNo < trackBuses->size(); ++trackNo)
+        {
+            synth.SetTrackBus(static_cast<int>(trackNo), (*trackBuses)[trackNo]);
+        }
+    }
+    const auto  render = [&](const int32_t position, const int32_t frames) {
+        for (int ch = 0; ch < numOfChannels; ++ch)
+        {
+            output[ch] = &channels[ch][position];
+        }
+        if (trackBuses != NULL)
+        {
+            synth.ProcessStems(&output[0], numberOfBuses, frames);
+        }
+        else
+        {
+            synth.ProcessReplacing(NULL, &output[0], frames);
+        }
+    };
+
+    size_t  index = 0;
+    while (index < records_.size())
+    {
+        const TraceRecorder::Record&    record = records_[index];
+        if (record.type != TraceRecorder::kTraceType_Callback)
+        {
+            //  state changes recorded between callbacks
+            index += this->ApplyRecord(synth, *seq, index);
+            continue;
+        }
+
+        //  commands were applied by the audio thread during this callback.
+        //  render up to each of them, then apply it at the same frame.
+        const uint64_t  start = record.sampleTime;
+        const int32_t   length = record.value0;
+        size_t  next = index + 1;
+        int32_t position = 0;
+        while ((next < records_.size()) && (records_[next].type != TraceRecorder::kTraceType_Callback))
+        {
+            const TraceRecorder::Record&    command = records_[next];
+            if (command.type == TraceRecorder::kTraceType_Command)
+            {
+                const int32_t   frame = std::min<int32_t>(static_cast<int32_t>(command.sampleTime - start), length);
+                if (frame > position)
+                {
+                    render(position, frame - position);
+                    position = frame;
+                }
+                this->ApplyRecord(synth, *seq, next);
+            }
+            ++next;
+        }
+        if (length > position)
+        {
+            render(position, length - position);
+        }
+        if (length > 0)
+        {
+            for (int ch = 0; ch < numOfChannels; ++ch)
+            {
+                output[ch] = &channels[ch][0];
+            }
+            handler(&output[0], length);
+        }
+
+        //  edits made by other threads while this callback was running take effect from the next one
+        index += 1;
+        while (index < next)
+        {
+            if (records_[index].type == TraceRecorder::kTraceType_Command)
+            {
+                ++index;
+            }
+            else
+            {
+                index += this->ApplyRecord(synth, *seq, index);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+//
+//  TraceReplayer.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "TraceRecorder.h"
+
+//  Replays a trace written by TraceRecorder through a fresh Synthesizer/Sequencer.
+//  Render callbacks are reproduced with their original lengths and every
+//  command is applied at the frame where it was applied during recording, so
+//  the output is deterministic and can be profiled or bisected offline.
+//  It uses no platform API : with a WavSampleLoader, a trace recorded on the
+//  device is replayed on any platform.
+class TraceReplayer
+{
+public:
+    typedef std::function<void(int16_t** buffer, const uint32_t length)>  OutputHandler;
+
+    /* loader : reads the recorded sound sets(not owned). NULL : WAV files by their names */
+    TraceReplayer(const class SampleLoader* loader = NULL);
+    ~TraceReplayer(void);
+
+    bool    Load(const std::string& path);
+
+    const TraceRecorder::FileHeader&    GetHeader(void) const   { return header_; }
+    size_t  GetNumberOfRecords(void) const      { return records_.size(); }
+    size_t  GetNumberOfCallbacks(void) const;
+
+    //  handler receives the output of every recorded callback
+    bool    Replay(const OutputHandler& handler) const;
+    //  stems : the tracks are rendered into their buses(trackBuses[trackNo], bus 0
+    //  if not given) in a single pass. handler receives L & R of each bus
+    bool    ReplayStems(const std::vector<int>& trackBuses, const int numberOfBuses, const OutputHandler& handler) const;
+
+private:
+    TraceReplayer(const TraceReplayer& other) = delete;
+    const TraceReplayer& operator= (const TraceReplayer& other) = delete;
+
+    size_t  ApplyRecord(class Synthesizer& synth, class Sequencer& seq, const size_t index) const;
+    bool    Replay(const std::vector<int>* trackBuses, const int numberOfBuses, const OutputHandler& handler) const;
+
+    const class SampleLoader*   sampleLoader_;
+    TraceRecorder::FileHeader   header_;
+    std::vector< std::vector<std::string> > soundSets_;
+    std::vector<TraceRecorder::Record>      records_;
+};
@@ -0,0 +1,88 @@
+//
+//  TriggerQueue.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <algorithm>
+
+#include "TriggerQueue.h"
+
+//  ---------------------------------------------------------------------------
+//      TriggerQueue::TriggerQueue
+//  ---------------------------------------------------------------------------
+TriggerQueue::TriggerQueue(const int maxNumberOfTracks) :
+wordsOfTracks_((std::max(maxNumberOfTracks, 1) + 31) / 32),
+queue_(kCapacity),
+tracks_(kCapacity * wordsOfTracks_),
+write_(0),
+read_(0),
+dropped_(0)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      TriggerQueue::~TriggerQueue
+//  ---------------------------------------------------------------------------
+TriggerQueue::~TriggerQueue(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      TriggerQueue::Push                              [audio thread]
+//  ---------------------------------------------------------------------------
+void
+TriggerQueue::Push(const uint64_t hostTime, const int step, const std::vector<int>& tracks)
+{
+    const uint64_t  write = write_.load(std::memory_order_relaxed);
+    if (write - read_.load(std::memory_order_acquire) >= kCapacity)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const size_t    index = write % kCapacity;
+    queue_[index].hostTime = hostTime;
+    queue_[index].step = step;
+    uint32_t*   bits = &tracks_[index * wordsOfTracks_];
+    std::fill(bits, bits + wordsOfTracks_, 0);
+    for (const int trackNo : tracks)
+    {
+        if ((trackNo >= 0) && (trackNo < wordsOfTracks_ * 32))
+        {
+            bits[trackNo / 32] |= 1U << (trackNo % 32);
+        }
+    }
+    write_.store(write + 1, std::memory_order_release);
+}
+
+//  ---------------------------------------------------------------------------
+//      TriggerQueue::Pop
+//  ---------------------------------------------------------------------------
+bool
+TriggerQueue::Pop(uint64_t& hostTime, int& step, std::vector<int>& tracks)
+{
+    const uint64_t  read = read_.load(std::memory_order_relaxed);
+    if (read == write_.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    const size_t    index = read % kCapacity;
+    hostTime = queue_[index].hostTime;
+    step = queue_[index].step;
+    tracks.clear();
+    const uint32_t* bits = &tracks_[index * wordsOfTracks_];
+    for (int word = 0; word < wordsOfTracks_; ++word)
+    {
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            if (((bits[word] >> bit) & 1) != 0)
+            {
+                tracks.push_back(word * 32 + bit);
+            }
+        }
+    }
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+}
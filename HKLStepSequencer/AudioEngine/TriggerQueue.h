@@ -0,0 +1,49 @@
+//
+//  TriggerQueue.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//  Carries the triggered steps from the audio thread to another thread(the
+//  delegate of AudioEngineIF) : a single producer/single consumer ring of
+//  preallocated entries, so the audio thread neither locks nor allocates.
+//  A trigger which does not fit is dropped and counted.
+class TriggerQueue
+{
+public:
+    enum { kCapacity = 256 };   //  triggers not taken yet
+
+    /* maxNumberOfTracks : the tracks above it are not carried */
+    TriggerQueue(const int maxNumberOfTracks);
+    ~TriggerQueue(void);
+
+    //  audio thread
+    void    Push(const uint64_t hostTime, const int step, const std::vector<int>& tracks);
+
+    //  the consumer thread. false : empty
+    bool    Pop(uint64_t& hostTime, int& step, std::vector<int>& tracks);
+    uint64_t    GetNumberOfDroppedTriggers(void) const  { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    TriggerQueue(const TriggerQueue& other) = delete;
+    const TriggerQueue& operator= (const TriggerQueue& other) = delete;
+
+    typedef struct {
+        uint64_t    hostTime;
+        int32_t     step;
+    } Trigger;
+
+    const int   wordsOfTracks_;
+    std::vector<Trigger>    queue_;
+    std::vector<uint32_t>   tracks_;        //  wordsOfTracks_ words per trigger. bit N of word M : track M * 32 + N
+    std::atomic<uint64_t>   write_;
+    std::atomic<uint64_t>   read_;
+    std::atomic<uint64_t>   dropped_;
+};
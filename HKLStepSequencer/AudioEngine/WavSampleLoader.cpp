@@ -0,0 +1,127 @@
+//
+//  WavSampleLoader.cpp
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstring>
+
+#include "WavSampleLoader.h"
+
+namespace {
+enum
+{
+    kFormat_PCM = 0x0001,
+    kFormat_Extensible = 0xFFFE,
+};
+
+//  WAV is little-endian whatever the host is
+inline uint16_t ReadUInt16(const uint8_t* bytes)
+{
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+inline uint32_t ReadUInt32(const uint8_t* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+}
+
+//  ---------------------------------------------------------------------------
+//      WavSampleLoader::WavSampleLoader
+//  ---------------------------------------------------------------------------
+WavSampleLoader::WavSampleLoader(const std::string& folder) :
+folder_(folder)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      WavSampleLoader::~WavSampleLoader
+//  ---------------------------------------------------------------------------
+WavSampleLoader::~WavSampleLoader(void)
+{
+}
+
+//  ---------------------------------------------------------------------------
+//      WavSampleLoader::Load
+//  ---------------------------------------------------------------------------
+bool
+WavSampleLoader::Load(const std::string& filename, std::vector<int16_t>& pcmData, float& samplingRate) const
+{
+    pcmData.clear();
+    if (filename.empty())
+    {
+        return false;
+    }
+    const bool  isAbsolute = (filename[0] == '/');
+    const std::string   path = (isAbsolute || folder_.empty()) ? filename : folder_ + "/" + filename;
+    FILE*   fp = ::fopen(path.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    bool    result = false;
+    bool    hasFormat = false;
+    uint8_t riff[12];
+    if ((::fread(riff, 1, sizeof(riff), fp) == sizeof(riff)) &&
+        (::memcmp(&riff[0], "RIFF", 4) == 0) && (::memcmp(&riff[8], "WAVE", 4) == 0))
+    {
+        uint8_t chunk[8];
+        while (::fread(chunk, 1, sizeof(chunk), fp) == sizeof(chunk))
+        {
+            const uint32_t  chunkSize = ReadUInt32(&chunk[4]);
+            const long      paddedSize = static_cast<long>(chunkSize) + (chunkSize & 1);
+            if (::memcmp(&chunk[0], "fmt ", 4) == 0)
+            {
+                uint8_t format[40] = {};
+                const size_t    formatSize = (chunkSize < sizeof(format)) ? chunkSize : sizeof(format);
+                if ((formatSize < 16) || (::fread(format, 1, formatSize, fp) != formatSize) ||
+                    (::fseek(fp, paddedSize - static_cast<long>(formatSize), SEEK_CUR) != 0))
+                {
+                    break;
+                }
+                uint16_t    formatTag = ReadUInt16(&format[0]);
+                if ((formatTag == kFormat_Extensible) && (formatSize >= 26))
+                {
+                    formatTag = ReadUInt16(&format[24]);    //  the first 2 bytes of the sub format GUID
+                }
+                const uint16_t  channels = ReadUInt16(&format[2]);
+                const uint32_t  rate = ReadUInt32(&format[4]);
+                const uint16_t  bitsPerSample = ReadUInt16(&format[14]);
+                if ((formatTag != kFormat_PCM) || (channels != 1) || (bitsPerSample != 16) || (rate == 0))
+                {
+                    break;
+                }
+                samplingRate = static_cast<float>(rate);
+                hasFormat = true;
+            }
+            else if (::memcmp(&chunk[0], "data", 4) == 0)
+            {
+                if (!hasFormat)
+                {
+                    break;
+                }
+                //  a truncated file : the frames which could be read
+                std::vector<uint8_t>    bytes(chunkSize & ~1U);
+                const size_t    numOfBytes = bytes.empty() ? 0 : ::fread(&bytes[0], 1, bytes.size(), fp);
+                pcmData.resize(numOfBytes / 2);
+                for (size_t frame = 0; frame < pcmData.size(); ++frame)
+                {
+                    pcmData[frame] = static_cast<int16_t>(ReadUInt16(&bytes[frame * 2]));
+                }
+                result = true;
+                break;
+            }
+            else if (::fseek(fp, paddedSize, SEEK_CUR) != 0)
+            {
+                break;
+            }
+        }
+    }
+    ::fclose(fp);
+    return result;
+}
@@ -0,0 +1,32 @@
+//
+//  WavSampleLoader.h
+//  HKLStepSequencer
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SampleLoader.h"
+
+//  Reads 16bit mono PCM WAV files(WAVE_FORMAT_PCM or EXTENSIBLE) with the C
+//  library only, so the engine loads its sounds on any platform.
+class WavSampleLoader : public SampleLoader
+{
+public:
+    /* folder : relative file names are read from it. empty : as they are */
+    WavSampleLoader(const std::string& folder = std::string());
+    ~WavSampleLoader(void);
+
+    bool    Load(const std::string& filename, std::vector<int16_t>& pcmData, float& samplingRate) const;
+
+private:
+    WavSampleLoader(const WavSampleLoader& other) = delete;
+    const WavSampleLoader& operator= (const WavSampleLoader& other) = delete;
+
+    const std::string   folder_;
+};
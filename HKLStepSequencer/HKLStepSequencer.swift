@@ -53,13 +53,14 @@ public class HKLStepSequencer: NSObject {
         set { engine_.tempo = newValue }
     }
 
-    /// number of tracks the sequencer has
+    /// number of tracks the sequencer has(up to 256).
+    /// Tracks can be added or removed while playing. The remaining tracks keep their patterns.
     public var numberOfTracks: Int {
         get { return engine_.numTracks }
         set { engine_.numTracks = newValue }
     }
 
-    /// number of steps in a track
+    /// number of steps in a track(up to 256). The sequences are kept when it is changed.
     public var numberOfSteps: Int {
         get { return engine_.numSteps }
         set { engine_.numSteps = newValue }
@@ -71,6 +72,46 @@ public class HKLStepSequencer: NSObject {
         set { engine_.sounds = newValue }
     }
 
+    /// Requested size of the audio I/O buffer in frames(default 1024).
+    /// Use a small size such as 64 for live playing. The hardware may choose another size.
+    public var preferredBufferSize: Int {
+        get { return engine_.preferredBufferSize }
+        set { engine_.preferredBufferSize = newValue }
+    }
+
+    /// Actual size of the audio I/O buffer in frames
+    public var bufferSize: Int {
+        return engine_.bufferSize
+    }
+
+    /// Playback latency in seconds : from rendering a frame to hearing it(I/O buffer + hardware output).
+    /// Output only : the audio session is for playback, so there is no input nor round-trip latency.
+    public var playbackLatency: TimeInterval {
+        return engine_.playbackLatency
+    }
+
+    /// Play the tracks repeating the same loop from pre-rendered buffers(default false).
+    /// The output is identical to the normal rendering.
+    /// Only the loops of a whole number of frames up to 8 sec are cached : at 44.1kHz, 16 sixteenths at 120 bpm(88200 frames), not at 128 bpm(82687.5).
+    public var loopCacheEnabled: Bool {
+        get { return engine_.loopCacheEnabled }
+        set { engine_.loopCacheEnabled = newValue }
+    }
+
+    /// Level(0.0…1.0 of full scale) at or below which the end of the sounds is trimmed when they are loaded
+    /// (default 0.0 : only digital silence). The sounds are reloaded when it is changed.
+    public var silenceThreshold: Double {
+        get { return engine_.silenceThreshold }
+        set { engine_.silenceThreshold = newValue }
+    }
+
+    /// Level(0.0…1.0 of full scale) to end a voice early when the rest of its sound is below it
+    /// at the current gain(default 0.0 : off). e.g. 0.001(-60dB)
+    public var releaseThreshold: Double {
+        get { return engine_.releaseThreshold }
+        set { engine_.releaseThreshold = newValue }
+    }
+
     /// Set sequence for the specified track.
     ///
     /// The sequence contains bool values. The size must be equal to numSteps property.
@@ -79,8 +120,90 @@ public class HKLStepSequencer: NSObject {
     ///   - sequence: an array of bool values. true means note on.
     ///   - trackNo: target track number
     public func setStepSequence(_ sequence: [Bool], ofTrack trackNo: Int) {
-        let seq = sequence.map{ NSNumber(value: $0) }
-        engine_.setStepSequence(seq, ofTrack: trackNo)
+        guard sequence.count == numberOfSteps else { return }
+        setStepSequences([sequence], fromTrack: trackNo)
+    }
+
+    /// Set sequences of consecutive tracks at once. They take effect together at the next render callback.
+    ///
+    /// - Parameters:
+    ///   - sequences: an array of sequences. Steps after numberOfSteps are ignored.
+    ///   - firstTrack: track number of the first sequence
+    public func setStepSequences(_ sequences: [[Bool]], fromTrack firstTrack: Int = 0) {
+        let packed = HKLStepSequencer.pack(sequences)
+        engine_.setPackedSequences(packed.bits, wordsPerTrack: packed.wordsPerTrack,
+                                   fromTrack: firstTrack, count: sequences.count)
+    }
+
+    /// Set packed sequences of consecutive tracks at once.
+    /// Bit N of the word W of a track is the step W * 32 + N.
+    ///
+    /// - Parameters:
+    ///   - bits: wordsPerTrack words for each track
+    ///   - wordsPerTrack: number of words per track. (numberOfSteps + 31) / 32 or more
+    ///   - firstTrack: track number of the first sequence
+    ///   - count: number of tracks in bits
+    public func setPackedStepSequences(_ bits: [UInt32], wordsPerTrack: Int, fromTrack firstTrack: Int, count: Int) {
+        guard wordsPerTrack > 0, count >= 0, bits.count >= wordsPerTrack * count else { return }
+        engine_.setPackedSequences(bits, wordsPerTrack: wordsPerTrack, fromTrack: firstTrack, count: count)
+    }
+
+    /// Replace the whole pattern. numberOfTracks becomes sequences.count and all tracks are set at once.
+    ///
+    /// - Parameters:
+    ///   - sequences: sequences of all tracks
+    ///   - numberOfSteps: number of steps(up to 256)
+    public func importPattern(_ sequences: [[Bool]], numberOfSteps: Int) {
+        let packed = HKLStepSequencer.pack(sequences)
+        engine_.importPackedPattern(packed.bits, wordsPerTrack: packed.wordsPerTrack,
+                                    numTracks: sequences.count, numSteps: numberOfSteps)
+    }
+
+    /// Pack sequences into 32bit words. Bit N of the word W of a track is the step W * 32 + N.
+    ///
+    /// - Parameter sequences: sequences of tracks
+    /// - Returns: the words of all tracks and the number of words per track
+    public static func pack(_ sequences: [[Bool]]) -> (bits: [UInt32], wordsPerTrack: Int) {
+        let maxSteps = sequences.map { $0.count }.max() ?? 0
+        let wordsPerTrack = max((maxSteps + 31) / 32, 1)
+        var bits = [UInt32](repeating: 0, count: wordsPerTrack * sequences.count)
+        for (trackNo, sequence) in sequences.enumerated() {
+            let base = trackNo * wordsPerTrack
+            for (step, isOn) in sequence.enumerated() where isOn {
+                bits[base + step / 32] |= UInt32(1) << UInt32(step % 32)
+            }
+        }
+        return (bits, wordsPerTrack)
+    }
+
+    /// Set the velocity, probability and delay of each step of the specified track.
+    /// Each array has numberOfSteps values. nil keeps the current values.
+    ///
+    /// - Parameters:
+    ///   - velocities: 0.0…1.0(default) of the amplifier gain
+    ///   - probabilities: 0.0(never)…1.0(always, default) chance that the note is ON
+    ///   - delays: 0.0(default)…1.0(exclusive) of a step to delay the note
+    ///   - trackNo: target track number
+    public func setStepLanes(velocities: [Double]? = nil, probabilities: [Double]? = nil, delays: [Double]? = nil,
+                             ofTrack trackNo: Int) {
+        engine_.setStepVelocities(velocities?.map { NSNumber(value: $0) },
+                                  probabilities: probabilities?.map { NSNumber(value: $0) },
+                                  delays: delays?.map { NSNumber(value: $0) }, ofTrack: trackNo)
+    }
+
+    /// Set the pitch of each step of the specified track, on top of its transpose.
+    ///
+    /// - Parameters:
+    ///   - pitches: -48…0(default)…48 semitones. numberOfSteps values
+    ///   - trackNo: target track number
+    public func setStepPitches(_ pitches: [Int], ofTrack trackNo: Int) {
+        engine_.setStepPitches(pitches.map { NSNumber(value: $0) }, ofTrack: trackNo)
+    }
+
+    /// Seed of the probabilities. The same seed plays the same notes in every run.
+    public var randomSeed: UInt32 {
+        get { return engine_.randomSeed }
+        set { engine_.randomSeed = newValue }
     }
 
     /// Erase all notes(ON/OFF) of the specified track
@@ -108,6 +231,135 @@ public class HKLStepSequencer: NSObject {
         engine_.setPanPosition(position, ofTrack: trackNo)
     }
 
+    /// Set the pitch of the specified track. It is applied to the sound playing as well.
+    ///
+    /// - Parameters:
+    ///   - transpose: -48…0(original)…48 semitones
+    ///   - tune: -100…0…100 cents
+    ///   - trackNo: target track number
+    public func setPitch(transpose: Int, tune: Int = 0, ofTrack trackNo: Int) {
+        engine_.setTranspose(transpose, tune: tune, ofTrack: trackNo)
+    }
+
+    /// Get the output level(peak & rms, 0.0…1.0 of full scale) of the specified track.
+    /// It is cheap enough to be polled at display rate.
+    ///
+    /// - Parameter trackNo: target track number
+    /// - Returns: output level of the track
+    public func level(ofTrack trackNo: Int) -> AudioEngineLevel {
+        return engine_.level(ofTrack: trackNo)
+    }
+
+    /// Get the analysis(duration, peak & loudness) of the sound of the specified track.
+    /// For example, setAmpGain(1.0 / peak) normalizes the peak.
+    ///
+    /// - Parameter trackNo: target track number
+    /// - Returns: analysis of the sound
+    public func sampleInfo(ofTrack trackNo: Int) -> AudioEngineSampleInfo {
+        return engine_.sampleInfo(ofTrack: trackNo)
+    }
+
+    /// Output level(peak & rms, 0.0…1.0 of full scale) of the master
+    public var masterLevel: AudioEngineLevel {
+        return engine_.masterLevel
+    }
+
+    /// Telemetry of the render path(callback durations, deadline misses, voices, etc.)
+    /// It can be read from any thread without disturbing the audio thread.
+    public var performance: AudioEnginePerformance {
+        return engine_.performance
+    }
+
+    /// Reset the telemetry. It takes effect at the next render callback.
+    public func resetPerformance() {
+        engine_.resetPerformance()
+    }
+
+    /// Start recording every command, pattern edit, parameter change and render callback.
+    /// The trace can be replayed offline deterministically to reproduce glitches.
+    public func startTraceRecording() {
+        engine_.startTraceRecording()
+    }
+
+    /// Stop recording and write the trace to the specified file.
+    ///
+    /// - Parameter path: file path to write
+    /// - Returns: true if succeeded
+    @discardableResult
+    public func stopTraceRecording(toFile path: String) -> Bool {
+        return engine_.stopTraceRecording(toFile: path)
+    }
+
+    /// Render the stems of a recorded trace offline and write them to WAV files(16bit stereo).
+    /// All the stems are rendered in a single pass and the files are written concurrently.
+    ///
+    /// - Parameters:
+    ///   - tracePath: trace file written by stopTraceRecording(toFile:)
+    ///   - paths: WAV file of each bus(64 at most)
+    ///   - buses: bus(index of paths) of each track. -1 leaves the track out. the others go to bus 0
+    /// - Returns: true if succeeded
+    @discardableResult
+    public func exportStems(ofTrace tracePath: String, toFiles paths: [String], busOfTracks buses: [Int]) -> Bool {
+        return engine_.exportStems(ofTrace: tracePath, toFiles: paths, busOfTracks: buses.map { NSNumber(value: $0) })
+    }
+
+    /// Receive a tick of an external clock(24 per beat, as MIDI clock).
+    /// While the ticks keep coming, the tempo and the position of the sequencer follow them
+    /// sample-accurately and `tempo` is ignored. The jitter of the ticks is filtered.
+    ///
+    /// - Parameter hostTime: mach_absolute_time at which the tick is heard. The sequencer is heard with it.
+    public func receiveClockTick(atTime hostTime: UInt64) {
+        engine_.receiveClockTick(atTime: hostTime)
+    }
+
+    /// Receive a beat(24 ticks) of an external clock. See receiveClockTick(atTime:)
+    public func receiveClockBeat(atTime hostTime: UInt64) {
+        engine_.receiveClockBeat(atTime: hostTime)
+    }
+
+    /// Receive the start of an external clock. The next tick is the first step of the sequence.
+    public func receiveClockStart(atTime hostTime: UInt64) {
+        engine_.receiveClockStart(atTime: hostTime)
+    }
+
+    /// Bandwidth of the jitter filter in Hz(default 1.0).
+    /// Lower filters more jitter, higher follows tempo changes faster.
+    public var clockBandwidth: Double {
+        get { return engine_.clockBandwidth }
+        set { engine_.clockBandwidth = newValue }
+    }
+
+    /// Receive the clock on a local UDP port(127.0.0.1) as a stand-in for a MIDI clock input.
+    /// Each datagram is a byte(0xF8 : tick, 0xF9 : beat, 0xFA : start), optionally followed by
+    /// the host time at which it is heard(8 bytes, little-endian).
+    ///
+    /// - Parameter port: UDP port. 0 chooses a free port(clockReceiverPort)
+    /// - Returns: true if succeeded
+    @discardableResult
+    public func startClockReceiver(onPort port: Int = 0) -> Bool {
+        return engine_.startClockReceiver(onPort: port)
+    }
+
+    /// Stop receiving the clock on the UDP port
+    public func stopClockReceiver() {
+        engine_.stopClockReceiver()
+    }
+
+    /// UDP port receiving the clock. 0 if not receiving
+    public var clockReceiverPort: Int {
+        return engine_.clockReceiverPort
+    }
+
+    /// State of the sync to the external clock : tempo, jitter, sync error and latency
+    public var clockSync: AudioEngineClockSync {
+        return engine_.clockSync
+    }
+
+    /// Reset the statistics of clockSync. It takes effect at the next render callback.
+    public func resetClockSync() {
+        engine_.resetClockSync()
+    }
+
     /// Start the sequencer
     public func start() {
         engine_.start()
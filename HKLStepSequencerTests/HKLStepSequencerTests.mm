@@ -0,0 +1,1210 @@
+//
+//  HKLStepSequencerTests.mm
+//  HKLStepSequencerTests
+//
+//  Created by Hirohito Kato on 2016/01/08.
+//  Copyright © 2016年 Hirohito Kato. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+#include "AudioIO.h"
+#include "RenderCorpus.h"
+#include "WavSampleLoader.h"
+#include "TraceRecorder.h"
+#include "TraceReplayer.h"
+#include "StemWriter.h"
+#include "ClockSync.h"
+#include "TriggerQueue.h"
+
+//  maximum difference from the scalar render allowed for each kernel.
+//  0 means that the kernel must reproduce the reference render bit-exactly.
+static const int kKernelTolerance[DrumOscillator::kNumberOfRenderKernels] = {
+    0,  //  kRenderKernel_Scalar
+    0,  //  kRenderKernel_Block
+};
+
+//  collects the triggered tracks of each step
+class TriggerCollector : public SequencerListener
+{
+public:
+    std::vector< std::pair<int, std::vector<int> > > triggers;  //  step, tracks
+    void NoteOnViaSequencer(int /*frame*/, const std::vector<int> &parts, const std::vector<int32_t> &/*velocities*/,
+                            const std::vector<int32_t> &/*pitches*/, int step) {
+        triggers.push_back(std::make_pair(step, parts));
+    }
+};
+
+//  a full project : 256 tracks of 64 steps
+enum { kProjectTracks = 256, kProjectSteps = 64, kProjectWords = kProjectSteps / 32 };
+
+static bool ProjectStep(int trackNo, int step) {
+    return ((trackNo * 7 + step * 13) % 5) == 0;
+}
+
+//  frames played by a voice of the sound from its trigger to its end
+static int VoiceFrames(const std::string& path, const int32_t releaseLevel, const int32_t ampCoef,
+                       const int kernel, const bool skip, const int32_t pitch = 0) {
+    DrumOscillator osc(44100.0f);
+    osc.LoadAudioFile(WavSampleLoader(), path);
+    osc.SetReleaseLevel(releaseLevel);
+    osc.SetAmpCoefficient(ampCoef);
+    osc.SetRenderKernel(kernel);
+    osc.TriggerOn(DrumOscillator::kVelocityUnity, pitch);
+    std::vector<int16_t> left(100), right(100);
+    int frames = 0;
+    while (osc.IsRunning()) {
+        int16_t* buffer[] = { &left[0], &right[0] };
+        if (skip) {
+            osc.Skip(100);
+        } else {
+            osc.Process(buffer, 100);
+        }
+        frames += 100;
+    }
+    return frames;
+}
+
+//  number of notes triggered by a loop of 256 tracks x 16 steps, all on
+static size_t CountHits(const uint16_t probability, const uint32_t seed) {
+    TriggerCollector collector;
+    Sequencer seq(44100.0f, kProjectTracks, 16, 4);
+    seq.AddListener(&collector);
+    const std::vector<uint32_t> bits(kProjectTracks, 0xFFFF);
+    const std::vector<uint16_t> probabilities(kProjectTracks * 16, probability);
+    seq.ImportPatterns(kProjectTracks, &bits[0], 1);
+    seq.UpdateStepLanes(0, kProjectTracks, NULL, &probabilities[0], NULL, NULL, 16);
+    seq.SetRandomSeed(seed);
+    seq.Start(0, 120.0f);
+    for (int block = 0; block < 5513 * 64 / 512; ++block) {     //  4 loops
+        seq.Process(NULL, 0, 512);
+    }
+    size_t hits = 0;
+    for (const auto& trigger : collector.triggers) {
+        hits += trigger.second.size();
+    }
+    return hits;
+}
+
+//  velocity of the last trigger of each track
+class VelocityCollector : public SequencerListener
+{
+public:
+    std::vector<int32_t>    velocities;
+    void NoteOnViaSequencer(int /*frame*/, const std::vector<int> &parts, const std::vector<int32_t> &hitVelocities,
+                            const std::vector<int32_t> &/*pitches*/, int /*step*/) {
+        for (size_t index = 0; index < parts.size(); ++index) {
+            velocities[parts[index]] = hitVelocities[index];
+        }
+    }
+};
+
+//  frame of the triggers of each step
+class StepFrameCollector : public SequencerListener
+{
+public:
+    uint64_t    blockFrame = 0;
+    std::vector< std::pair<uint64_t, int> > steps;      //  frame, step
+    void NoteOnViaSequencer(int frame, const std::vector<int> &/*parts*/, const std::vector<int32_t> &/*velocities*/,
+                            const std::vector<int32_t> &/*pitches*/, int step) {
+        steps.push_back(std::make_pair(blockFrame + frame, step));
+    }
+};
+
+//  a sequencer started at 120bpm follows a simulated clock(24 ticks per beat) for 20 sec.
+//  the ticks are late or early by up to jitter(sec) and taken at the next block.
+//  every droppedEvery-th tick is lost. returns the errors(frames) of the steps triggered after 5 sec
+static std::vector<double> SyncToClock(const double tempo, const double jitter, const int droppedEvery,
+                                       ClockSync::Report& report) {
+    const float fs = 44100.0f;
+    const int blockSize = 512;
+    const double period = fs * 60.0 / tempo / ClockSync::kTicksPerBeat;
+    const double firstTick = 3000.5;
+    StepFrameCollector collector;
+    ClockSync sync(fs);
+    Sequencer seq(fs, 1, 16, 4);
+    seq.AddListener(&collector);
+    seq.SetClockSync(&sync);
+    const uint32_t bits = 0xFFFF;
+    seq.ImportPatterns(1, &bits, 1);
+    seq.Start(0, 120.0f);
+
+    uint32_t random = 1;
+    int64_t tick = 0;
+    for (uint64_t frame = 0; frame < fs * 20; frame += blockSize) {
+        for (; firstTick + tick * period < frame; ++tick) {
+            random = random * 1664525u + 1013904223u;
+            const double deviation = ((random >> 8) / double(1 << 24) * 2.0 - 1.0) * jitter * fs;
+            if ((droppedEvery == 0) || ((tick % droppedEvery) != droppedEvery - 1)) {
+                sync.ReceiveAtFrame(ClockSync::kClockMessage_Tick, firstTick + tick * period + deviation);
+            }
+        }
+        collector.blockFrame = frame;
+        seq.Process(NULL, 0, blockSize);
+    }
+    sync.GetReport(report);
+
+    //  the step N is at the tick N * 6
+    std::vector<double> errors;
+    for (const auto& step : collector.steps) {
+        if (step.first < fs * 5) {
+            continue;
+        }
+        const double position = (step.first - firstTick) / (period * 6);
+        const double nearest = std::floor(position + 0.5);
+        errors.push_back((static_cast<int>(nearest) % 16 == step.second) ? (position - nearest) * period * 6 : 1e9);
+    }
+    return errors;
+}
+
+static double RootMeanSquare(const std::vector<double>& values) {
+    double sumOfSquares = 0.0;
+    for (const auto value : values) {
+        sumOfSquares += value * value;
+    }
+    return values.empty() ? 0.0 : std::sqrt(sumOfSquares / values.size());
+}
+
+@interface HKLStepSequencerTests : XCTestCase
+{
+    std::string soundDirectory_;
+    bool        recordMode_;
+}
+@end
+
+@implementation HKLStepSequencerTests
+
+- (void)setUp {
+    [super setUp];
+    NSString* kick = [[NSBundle bundleForClass:[self class]] pathForResource:@"kick" ofType:@"wav"];
+    XCTAssertNotNil(kick);
+    soundDirectory_ = [[kick stringByDeletingLastPathComponent] UTF8String];
+
+    //  HKL_RECORD_GOLDEN=1 : print the hashes of the scalar renders instead of checking them
+    const char* record = ::getenv("HKL_RECORD_GOLDEN");
+    recordMode_ = (record != NULL) && (::strcmp(record, "1") == 0);
+}
+
+- (void)tearDown {
+    [super tearDown];
+}
+
+- (void)testGoldenRenders {
+    for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+        const RenderCorpus::Case& rc = RenderCorpus::kCases[caseNo];
+        std::vector<int16_t> reference;
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+        const uint64_t hash = RenderCorpus::Hash(reference);
+        if (recordMode_) {
+            NSLog(@"%s 0x%016llxULL", rc.name, hash);
+            continue;
+        }
+        XCTAssertEqual(hash, rc.goldenHash, @"%s: render differs from the golden render", rc.name);
+    }
+}
+
+- (void)testRenderKernels {
+    for (int kernel = 0; kernel < DrumOscillator::kNumberOfRenderKernels; ++kernel) {
+        double totalSec = 0.0;
+        uint64_t totalFrames = 0;
+        int maxDiff = 0;
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            const RenderCorpus::Case& rc = RenderCorpus::kCases[caseNo];
+            std::vector<int16_t> reference, output;
+            RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+
+            const auto start = std::chrono::steady_clock::now();
+            RenderCorpus::Render(rc, kernel, soundDirectory_, output);
+            totalSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            totalFrames += rc.frames;
+
+            XCTAssertEqual(output.size(), reference.size(), @"%s", rc.name);
+            int caseDiff = 0;
+            for (size_t i = 0; i < std::min(output.size(), reference.size()); ++i) {
+                caseDiff = std::max(caseDiff, std::abs(output[i] - reference[i]));
+            }
+            XCTAssertLessThanOrEqual(caseDiff, kKernelTolerance[kernel], @"%s: kernel %d", rc.name, kernel);
+            maxDiff = std::max(maxDiff, caseDiff);
+        }
+        NSLog(@"kernel %d: max diff %d, %.1f x realtime", kernel, maxDiff,
+              (totalSec > 0.0) ? totalFrames / 44100.0 / totalSec : 0.0);
+    }
+}
+
+- (void)testLoopCache {
+    for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+        RenderCorpus::Case rc = RenderCorpus::kCases[caseNo];
+        rc.frames *= 4;     //  the loops are played from the cache from the 3rd one
+        std::vector<int16_t> reference, output;
+        uint64_t cachedFrames = 0;
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, output, &cachedFrames);
+        XCTAssertTrue(output == reference, @"%s: the cached render differs", rc.name);
+        NSLog(@"%s: %llu frames cached", rc.name, cachedFrames);
+        //  their loops are whole frames long and repeat more than twice in the render
+        if ((::strcmp(rc.name, "four_on_the_floor") == 0) || (::strcmp(rc.name, "retrigger") == 0)) {
+            XCTAssertGreaterThan(cachedFrames, 0ULL, @"%s", rc.name);
+        }
+    }
+}
+
+- (void)testLoopCacheRenderTime {
+    //  the cached time includes rendering the loops(UpdateLoopCache after each block)
+    for (const char* name : { "four_on_the_floor", "dense_clipping", "retrigger" }) {
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            RenderCorpus::Case rc = RenderCorpus::kCases[caseNo];
+            if (::strcmp(rc.name, name) != 0) {
+                continue;
+            }
+            rc.frames = 44100 * 60;
+            std::vector<int16_t> reference, output;
+            uint64_t cachedFrames = 0;
+            auto start = std::chrono::steady_clock::now();
+            RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+            const double liveSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            start = std::chrono::steady_clock::now();
+            RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, output, &cachedFrames);
+            const double cachedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            XCTAssertTrue(output == reference, @"%s: the cached render differs", rc.name);
+            XCTAssertGreaterThan(cachedFrames, 0ULL, @"%s", rc.name);
+            NSLog(@"%s: live %.1f ms, cached %.1f ms(x%.2f), %.0f%% of the track frames cached", rc.name,
+                  liveSec * 1000.0, cachedSec * 1000.0, (cachedSec > 0.0) ? liveSec / cachedSec : 0.0,
+                  100.0 * cachedFrames / (static_cast<double>(rc.frames) * RenderCorpus::kNumberOfTracks));
+        }
+    }
+}
+
+- (void)testLoopCacheBudget {
+    RenderCorpus::Case rc = RenderCorpus::kCases[0];    //  four_on_the_floor : 88200 frames a loop
+    XCTAssertEqual(::strcmp(rc.name, "four_on_the_floor"), 0);
+    rc.frames *= 4;
+    const size_t loopBytes = 88200 * 2 * sizeof(int16_t);
+    std::vector<int16_t> reference, output;
+    uint64_t cachedFrames = 0;
+    RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+    //  room for the loop of a single track : the others are rendered live
+    RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, output, &cachedFrames, 0,
+                         loopBytes + loopBytes / 2);
+    XCTAssertTrue(output == reference, @"the cached render differs");
+    XCTAssertGreaterThan(cachedFrames, 0ULL);
+    XCTAssertLessThanOrEqual(cachedFrames, static_cast<uint64_t>(rc.frames));
+    //  nothing fits
+    RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, output, &cachedFrames, 0,
+                         loopBytes - 1);
+    XCTAssertTrue(output == reference, @"the live render differs");
+    XCTAssertEqual(cachedFrames, 0ULL);
+}
+
+//  renders tracks 2 & 3 added while playing and removed later.
+//  the reference has 4 tracks all the time and only edits their patterns & gains.
+- (void)renderTrackChanges:(bool)dynamic output:(std::vector<int16_t>&)output numTracks:(int&)numTracks {
+    const auto pattern = [](uint32_t bits) {
+        std::vector<bool> sequence(16);
+        for (int step = 0; step < 16; ++step) {
+            sequence[step] = ((bits >> step) & 1) != 0;
+        }
+        return sequence;
+    };
+    std::vector<std::string> sounds;
+    for (const char* sound : RenderCorpus::kSounds) {
+        sounds.push_back(soundDirectory_ + "/" + sound);
+    }
+    const std::vector<std::string> twoSounds(sounds.begin(), sounds.begin() + 2);
+
+    Synthesizer synth(44100.0f);
+    Sequencer* seq = new Sequencer(44100.0f, dynamic ? 2 : 4, 16, 4);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(dynamic ? twoSounds : sounds);
+    seq->UpdateTrack(0, pattern(0x1111));
+    seq->UpdateTrack(1, pattern(0x1010));
+    synth.SetPanPosition(1, 20);
+    seq->Start(0, 120.0f);
+
+    std::vector<int16_t> left(512), right(512);
+    output.clear();
+    for (int block = 0; block < 400; ++block) {
+        if (block == 100) {
+            if (dynamic) {
+                seq->UpdateNumTracks(0, 4);
+                synth.SetSoundSet(sounds);
+            }
+            seq->UpdateTrack(2, pattern(0xAAAA));
+            seq->UpdateTrack(3, pattern(0x8888));
+        } else if (block == 250) {
+            if (dynamic) {
+                seq->UpdateNumTracks(0, 2);
+                synth.SetSoundSet(twoSounds);
+            } else {
+                seq->UpdateTrack(2, pattern(0));
+                seq->UpdateTrack(3, pattern(0));
+                synth.SetAmpCoefficient(2, 0);
+                synth.SetAmpCoefficient(3, 0);
+            }
+        } else if ((block == 300) && dynamic) {
+            seq->UpdateNumTracks(0, 3);     //  added again : must be empty
+        }
+        int16_t* buffer[] = { &left[0], &right[0] };
+        synth.ProcessReplacing(NULL, buffer, 512);
+        for (int i = 0; i < 512; ++i) {
+            output.push_back(left[i]);
+            output.push_back(right[i]);
+        }
+    }
+    numTracks = seq->GetNumTracks();
+}
+
+- (void)testDynamicTracks {
+    std::vector<int16_t> reference, output;
+    int numTracks = 0;
+    [self renderTrackChanges:false output:reference numTracks:numTracks];
+    [self renderTrackChanges:true output:output numTracks:numTracks];
+    XCTAssertEqual(numTracks, 3);
+    XCTAssertTrue(output == reference, @"tracks added or removed while playing");
+}
+
+- (void)testNoTracks {
+    TriggerCollector collector;
+    Sequencer seq(44100.0f, 0, 16, 4);
+    seq.AddListener(&collector);
+    seq.Start(0, 120.0f);
+    seq.Process(NULL, 0, 5512 * 16);     //  a loop(5512.5 frames per step)
+    XCTAssertEqual(collector.triggers.size(), (size_t)16);
+    for (const auto& trigger : collector.triggers) {
+        XCTAssertTrue(trigger.second.empty(), @"step %d", trigger.first);
+    }
+}
+
+- (void)testPackedPatterns {
+    std::vector<uint32_t> bits(kProjectTracks * kProjectWords, 0);
+    for (int trackNo = 0; trackNo < kProjectTracks; ++trackNo) {
+        for (int step = 0; step < kProjectSteps; ++step) {
+            bits[trackNo * kProjectWords + step / 32] |= (ProjectStep(trackNo, step) ? 1u : 0u) << (step % 32);
+        }
+    }
+    TriggerCollector collector;
+    Sequencer seq(44100.0f, kProjectTracks, kProjectSteps, 4);
+    seq.AddListener(&collector);
+    seq.UpdateTrack(0, std::vector<bool>(kProjectSteps, true));   //  replaced by the import
+    seq.ImportPatterns(kProjectTracks, &bits[0], kProjectWords);
+    seq.Start(0, 120.0f);
+    seq.Process(NULL, 0, 5512 * kProjectSteps);     //  a loop(5512.5 frames per step)
+
+    XCTAssertGreaterThanOrEqual(collector.triggers.size(), (size_t)kProjectSteps);
+    for (const auto& trigger : collector.triggers) {
+        std::vector<int> expected;
+        for (int trackNo = 0; trackNo < kProjectTracks; ++trackNo) {
+            if (ProjectStep(trackNo, trigger.first)) {
+                expected.push_back(trackNo);
+            }
+        }
+        XCTAssertTrue(trigger.second == expected, @"step %d", trigger.first);
+    }
+
+    //  the removed steps are cleared : empty when they are added again
+    seq.UpdateNumSteps(0, 16);
+    seq.UpdateNumSteps(0, kProjectSteps);
+    collector.triggers.clear();
+    seq.Process(NULL, 0, 5513 * kProjectSteps);
+    for (const auto& trigger : collector.triggers) {
+        if (trigger.first >= 16) {
+            XCTAssertTrue(trigger.second.empty(), @"step %d", trigger.first);
+        }
+    }
+
+    //  only the tracks in use are cleared by the steps removed : the others when they are added again
+    seq.UpdateNumTracks(0, 2);
+    seq.UpdateNumSteps(0, 8);
+    seq.UpdateNumSteps(0, kProjectSteps);
+    seq.UpdateNumTracks(0, kProjectTracks);
+    collector.triggers.clear();
+    seq.Process(NULL, 0, 5513 * kProjectSteps);
+    for (const auto& trigger : collector.triggers) {
+        std::vector<int> expected;
+        for (int trackNo = 0; (trackNo < 2) && (trigger.first < 8); ++trackNo) {
+            if (ProjectStep(trackNo, trigger.first)) {
+                expected.push_back(trackNo);
+            }
+        }
+        XCTAssertTrue(trigger.second == expected, @"step %d", trigger.first);
+    }
+
+    //  an import with its numbers of tracks and steps is taken at once. it replaces the numbers requested before
+    seq.UpdateNumSteps(0, 8);
+    const std::vector<uint32_t> allOn(4 * 2, ~0u);
+    seq.ImportPatterns(4, 48, &allOn[0], 2);
+    XCTAssertEqual(seq.GetNumTracks(), 4);
+    collector.triggers.clear();
+    seq.Process(NULL, 0, 5513 * 48);
+    int lastStep = -1;
+    for (const auto& trigger : collector.triggers) {
+        XCTAssertEqual(trigger.second.size(), (size_t)4, @"step %d", trigger.first);
+        lastStep = std::max(lastStep, trigger.first);
+    }
+    XCTAssertEqual(lastStep, 47);
+
+    //  an import clears the tracks in use only : the others when they are added again
+    seq.UpdateNumTracks(0, 2);
+    seq.ImportPatterns(3, 8, &allOn[0], 2);
+    seq.UpdateNumTracks(0, 4);
+    seq.UpdateNumSteps(0, 48);
+    collector.triggers.clear();
+    seq.Process(NULL, 0, 5513 * 48);
+    for (const auto& trigger : collector.triggers) {
+        const std::vector<int> expected = (trigger.first < 8) ? std::vector<int>({ 0, 1, 2 }) : std::vector<int>();
+        XCTAssertTrue(trigger.second == expected, @"step %d", trigger.first);
+    }
+}
+
+//  the project loaded as before : a NSNumber array per track, converted to std::vector<bool>
+- (void)testPerformanceProjectLoadBoxed {
+    Sequencer* seq = new Sequencer(44100.0f, kProjectTracks, kProjectSteps, 4);
+    [self measureBlock:^{
+        for (int trackNo = 0; trackNo < kProjectTracks; ++trackNo) {
+            NSMutableArray<NSNumber *>* sequence = [NSMutableArray arrayWithCapacity:kProjectSteps];
+            for (int step = 0; step < kProjectSteps; ++step) {
+                [sequence addObject:@(ProjectStep(trackNo, step))];
+            }
+            std::vector<bool> steps;
+            for (NSNumber* stepObj in sequence) {
+                steps.push_back(stepObj.boolValue);
+            }
+            seq->UpdateTrack(trackNo, steps);
+        }
+    }];
+    delete seq;
+}
+
+//  the project packed and imported in a single transaction
+- (void)testPerformanceProjectLoadPacked {
+    Sequencer* seq = new Sequencer(44100.0f, kProjectTracks, kProjectSteps, 4);
+    [self measureBlock:^{
+        std::vector<uint32_t> bits(kProjectTracks * kProjectWords, 0);
+        for (int trackNo = 0; trackNo < kProjectTracks; ++trackNo) {
+            for (int step = 0; step < kProjectSteps; ++step) {
+                bits[trackNo * kProjectWords + step / 32] |= (ProjectStep(trackNo, step) ? 1u : 0u) << (step % 32);
+            }
+        }
+        seq->ImportPatterns(kProjectTracks, &bits[0], kProjectWords);
+    }];
+    delete seq;
+}
+
+//  renders the kick on every other step of a track with the lanes
+- (void)renderLanesWithGain:(int32_t)gain velocities:(const uint16_t *)velocities
+              probabilities:(const uint16_t *)probabilities delays:(const uint8_t *)delays
+                  loopCache:(bool)loopCache output:(std::vector<int16_t>&)output cachedFrames:(uint64_t&)cachedFrames {
+    [self renderLanesWithGain:gain velocities:velocities probabilities:probabilities delays:delays
+                      pitches:NULL transpose:0 loopCache:loopCache output:output cachedFrames:cachedFrames];
+}
+
+- (void)renderLanesWithGain:(int32_t)gain velocities:(const uint16_t *)velocities
+              probabilities:(const uint16_t *)probabilities delays:(const uint8_t *)delays
+                    pitches:(const int8_t *)pitches transpose:(int32_t)transpose
+                  loopCache:(bool)loopCache output:(std::vector<int16_t>&)output cachedFrames:(uint64_t&)cachedFrames {
+    Synthesizer synth(44100.0f);
+    Sequencer* seq = new Sequencer(44100.0f, 1, 16, 4);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(std::vector<std::string>(1, soundDirectory_ + "/kick.wav"));
+    std::vector<bool> sequence(16, false);
+    for (int step = 0; step < 16; step += 2) {
+        sequence[step] = true;
+    }
+    seq->UpdateTrack(0, sequence);
+    seq->UpdateStepLanes(0, 1, velocities, probabilities, delays, pitches, 16);
+    seq->SetRandomSeed(3);
+    synth.SetAmpCoefficient(0, gain);
+    synth.SetTranspose(0, transpose);
+    if (loopCache) {
+        synth.SetLoopCacheEnabled(true, false);
+    }
+    seq->Start(0, 120.0f);
+
+    std::vector<int16_t> left(1000), right(1000);
+    output.clear();
+    for (int block = 0; block < 353; ++block) {     //  4 loops
+        int16_t* buffer[] = { &left[0], &right[0] };
+        synth.ProcessReplacing(NULL, buffer, 1000);
+        for (int i = 0; i < 1000; ++i) {
+            output.push_back(left[i]);
+            output.push_back(right[i]);
+        }
+        if (loopCache) {
+            synth.UpdateLoopCache();
+        }
+    }
+    cachedFrames = synth.GetNumberOfCachedFrames();
+}
+
+- (void)testStepLanes {
+    std::vector<int16_t> reference, output;
+    uint64_t cachedFrames = 0;
+
+    //  velocity x0.5 is the amp x0.5
+    uint16_t half[16];
+    std::fill(half, half + 16, 0x4000);
+    [self renderLanesWithGain:0x3FFF velocities:NULL probabilities:NULL delays:NULL
+                    loopCache:false output:reference cachedFrames:cachedFrames];
+    [self renderLanesWithGain:0x7FFF velocities:half probabilities:NULL delays:NULL
+                    loopCache:false output:output cachedFrames:cachedFrames];
+    XCTAssertTrue(output == reference, @"velocity");
+
+    //  delay of a half step(2756.25 frames) : the same render, later by 2756 frames
+    uint8_t delays[16];
+    std::fill(delays, delays + 16, Sequencer::kDelayResolution / 2);
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:NULL
+                    loopCache:false output:reference cachedFrames:cachedFrames];
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:delays
+                    loopCache:false output:output cachedFrames:cachedFrames];
+    const size_t shift = 2756 * 2;
+    bool isShifted = true;
+    for (size_t i = 0; i < output.size(); ++i) {
+        isShifted = isShifted && (output[i] == ((i < shift) ? 0 : reference[i - shift]));
+    }
+    XCTAssertTrue(isShifted, @"delay");
+
+    //  the loop cache plays the velocities and the delays identically
+    uint16_t velocities[16];
+    for (int step = 0; step < 16; ++step) {
+        velocities[step] = 0x800 * (step + 1);
+    }
+    [self renderLanesWithGain:0x7FFF velocities:velocities probabilities:NULL delays:delays
+                    loopCache:false output:reference cachedFrames:cachedFrames];
+    [self renderLanesWithGain:0x7FFF velocities:velocities probabilities:NULL delays:delays
+                    loopCache:true output:output cachedFrames:cachedFrames];
+    XCTAssertTrue(output == reference, @"loop cache");
+    XCTAssertGreaterThan(cachedFrames, 0ULL);
+}
+
+//  each commit copies only the track edited : every buffer must still follow all the edits
+- (void)testStepLanesOfEachTrack {
+    enum { kTracks = 8 };
+    VelocityCollector collector;
+    collector.velocities.assign(kTracks, -1);
+    Sequencer seq(44100.0f, kTracks, 16, 4);
+    seq.AddListener(&collector);
+    const std::vector<uint32_t> bits(kTracks, 0xFFFF);
+    seq.ImportPatterns(kTracks, &bits[0], 1);
+    seq.Start(0, 120.0f);
+    std::vector<uint16_t> expected(kTracks, Sequencer::kVelocityUnity);
+    for (int edit = 0; edit < 40; ++edit) {
+        const int trackNo = (edit * 3) % kTracks;
+        expected[trackNo] = static_cast<uint16_t>(0x1000 + edit * 0x100);
+        const std::vector<uint16_t> velocities(16, expected[trackNo]);
+        seq.UpdateStepLanes(trackNo, 1, &velocities[0], NULL, NULL, NULL, 16);
+        seq.Process(NULL, 0, 5513);     //  a step
+        for (int i = 0; i < kTracks; ++i) {
+            XCTAssertEqual(collector.velocities[i], (int32_t)expected[i], @"edit %d track %d", edit, i);
+        }
+    }
+}
+
+- (void)testStepProbability {
+    const size_t all = kProjectTracks * 64;
+    XCTAssertEqual(CountHits(Sequencer::kProbabilityAlways, 1), all);
+    XCTAssertEqual(CountHits(0, 1), (size_t)0);
+
+    //  the same seed plays the same notes
+    const size_t hits = CountHits(0x4000, 1);
+    XCTAssertEqual(CountHits(0x4000, 1), hits);
+    XCTAssertNotEqual(CountHits(0x4000, 2), hits);
+    XCTAssertGreaterThan(hits, all * 45 / 100);
+    XCTAssertLessThan(hits, all * 55 / 100);
+}
+
+//  the triggers of 256 tracks at 2000bpm(330 frames per step) : the sequencer alone
+- (void)measureStepTriggersWithLanes:(bool)withLanes {
+    Sequencer* seq = new Sequencer(44100.0f, kProjectTracks, kProjectSteps, 4);
+    std::vector<uint32_t> bits(kProjectTracks * kProjectWords, 0);
+    for (int trackNo = 0; trackNo < kProjectTracks; ++trackNo) {
+        for (int step = 0; step < kProjectSteps; ++step) {
+            bits[trackNo * kProjectWords + step / 32] |= (ProjectStep(trackNo, step) ? 1u : 0u) << (step % 32);
+        }
+    }
+    seq->ImportPatterns(kProjectTracks, &bits[0], kProjectWords);
+    if (withLanes) {
+        const std::vector<uint16_t> velocities(kProjectTracks * kProjectSteps, 0x6000);
+        const std::vector<uint16_t> probabilities(kProjectTracks * kProjectSteps, 0x6000);
+        const std::vector<uint8_t> delays(kProjectTracks * kProjectSteps, 0);
+        std::vector<int8_t> pitches(kProjectTracks * kProjectSteps);
+        for (size_t index = 0; index < pitches.size(); ++index) {
+            pitches[index] = static_cast<int8_t>(index % 25) - 12;
+        }
+        seq->UpdateStepLanes(0, kProjectTracks, &velocities[0], &probabilities[0], &delays[0], &pitches[0], kProjectSteps);
+    }
+    seq->Start(0, 2000.0f);
+    [self measureBlock:^{
+        for (int block = 0; block < 20000; ++block) {
+            seq->Process(NULL, 0, 256);
+        }
+    }];
+    delete seq;
+}
+
+- (void)testPitch {
+    //  an octave up plays the sound in half the frames
+    const std::string kick = soundDirectory_ + "/kick.wav";
+    const int original = VoiceFrames(kick, 0, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, false);
+    const int octaveUp = VoiceFrames(kick, 0, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, false, 12);
+    XCTAssertLessThanOrEqual(std::abs(octaveUp * 2 - original), 200);
+    XCTAssertEqual(VoiceFrames(kick, 0, 0x7FFF, DrumOscillator::kRenderKernel_Block, false, 12), octaveUp);
+    XCTAssertEqual(VoiceFrames(kick, 0, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, true, 12), octaveUp);
+
+    //  the transpose of the track is the pitch of every step
+    std::vector<int16_t> reference, output;
+    uint64_t cachedFrames = 0;
+    int8_t pitches[16];
+    std::fill(pitches, pitches + 16, 12);
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:NULL pitches:NULL transpose:12
+                    loopCache:false output:reference cachedFrames:cachedFrames];
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:NULL pitches:pitches transpose:0
+                    loopCache:false output:output cachedFrames:cachedFrames];
+    XCTAssertTrue(output == reference, @"transpose");
+
+    //  the loop cache plays the pitches identically
+    for (int step = 0; step < 16; ++step) {
+        pitches[step] = static_cast<int8_t>(step * 3 - 24);
+    }
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:NULL pitches:pitches transpose:-5
+                    loopCache:false output:reference cachedFrames:cachedFrames];
+    [self renderLanesWithGain:0x7FFF velocities:NULL probabilities:NULL delays:NULL pitches:pitches transpose:-5
+                    loopCache:true output:output cachedFrames:cachedFrames];
+    XCTAssertTrue(output == reference, @"loop cache");
+    XCTAssertGreaterThan(cachedFrames, 0ULL);
+}
+
+- (void)testPerformanceStepTriggers {
+    [self measureStepTriggersWithLanes:false];
+}
+
+- (void)testPerformanceStepTriggersWithLanes {
+    [self measureStepTriggersWithLanes:true];
+}
+
+- (void)testSampleAnalysis {
+    const std::string kick = soundDirectory_ + "/kick.wav";
+    DrumOscillator whole(44100.0f);
+    whole.LoadAudioFile(WavSampleLoader(), kick);
+    const DrumOscillator::SampleInfo& wholeInfo = whole.GetSampleInfo();
+    XCTAssertEqual(wholeInfo.trimmedFrames, 0U);    //  no digital silence at its end
+    XCTAssertEqual(wholeInfo.peak, 0x7FFF);
+    XCTAssertGreaterThan(wholeInfo.loudness, 0);
+    XCTAssertLessThan(wholeInfo.loudness, wholeInfo.peak);
+
+    DrumOscillator trimmed(44100.0f);
+    trimmed.SetSilenceLevel(16);
+    trimmed.LoadAudioFile(WavSampleLoader(), kick);
+    const DrumOscillator::SampleInfo& trimmedInfo = trimmed.GetSampleInfo();
+    XCTAssertGreaterThan(trimmedInfo.trimmedFrames, 0U);
+    XCTAssertEqual(trimmedInfo.numberOfFrames + trimmedInfo.trimmedFrames, wholeInfo.numberOfFrames);
+    XCTAssertEqual(trimmedInfo.loudness, wholeInfo.loudness);
+    NSLog(@"kick: %u frames, %u trimmed at 16", wholeInfo.numberOfFrames, trimmedInfo.trimmedFrames);
+
+    //  a voice sharing the sample plays it without a copy
+    DrumOscillator shared(44100.0f);
+    shared.SetSample(trimmed.GetSample());
+    XCTAssertEqual(shared.GetSample().get(), trimmed.GetSample().get());
+    XCTAssertEqual(shared.GetSampleInfo().numberOfFrames, trimmedInfo.numberOfFrames);
+    shared.SetSample(nullptr);
+    XCTAssertEqual(shared.GetSampleInfo().numberOfFrames, 0U);
+
+    //  the sounds loaded by the synthesizer are trimmed as well
+    Synthesizer synth(44100.0f);
+    synth.SetSoundSet(std::vector<std::string>(1, kick));
+    synth.SetSilenceLevel(16);
+    DrumOscillator::SampleInfo info;
+    XCTAssertTrue(synth.GetSampleInfo(0, info));
+    XCTAssertEqual(info.numberOfFrames, trimmedInfo.numberOfFrames);
+    XCTAssertFalse(synth.GetSampleInfo(1, info));
+}
+
+- (void)testEarlyRelease {
+    const std::string kick = soundDirectory_ + "/kick.wav";
+    const int full = VoiceFrames(kick, 0, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, false);
+    const int released = VoiceFrames(kick, 64, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, false);
+    XCTAssertLessThan(released, full);
+    //  quieter voices end earlier
+    XCTAssertLessThan(VoiceFrames(kick, 64, 0x2000, DrumOscillator::kRenderKernel_Scalar, false), released);
+    XCTAssertEqual(VoiceFrames(kick, 64, 0x7FFF, DrumOscillator::kRenderKernel_Block, false), released);
+    XCTAssertEqual(VoiceFrames(kick, 64, 0x7FFF, DrumOscillator::kRenderKernel_Scalar, true), released);
+    NSLog(@"kick: %d frames, %d frames released at 64", full, released);
+
+    //  each voice differs by at most the level. the kernels and the loop cache agree
+    const int32_t level = 32;
+    for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+        RenderCorpus::Case rc = RenderCorpus::kCases[caseNo];
+        rc.frames *= 4;
+        std::vector<int16_t> reference, scalar, block, cached;
+        uint64_t cachedFrames = 0;
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, reference);
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, scalar, NULL, level);
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Block, soundDirectory_, block, NULL, level);
+        RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Block, soundDirectory_, cached, &cachedFrames, level);
+        XCTAssertTrue(block == scalar, @"%s", rc.name);
+        XCTAssertTrue(cached == scalar, @"%s", rc.name);
+        int maxDiff = 0;
+        for (size_t i = 0; i < std::min(scalar.size(), reference.size()); ++i) {
+            maxDiff = std::max(maxDiff, std::abs(scalar[i] - reference[i]));
+        }
+        XCTAssertLessThanOrEqual(maxDiff, level * RenderCorpus::kNumberOfTracks, @"%s", rc.name);
+    }
+}
+
+- (void)testLevelMeter {
+    //  a square wave of half scale for 1 sec(10 time constants of the rms)
+    LevelMeter meter(2);
+    LevelMeter::Level level;
+    const uint32_t frames = 441;
+    const int32_t amplitude = 0x4000;
+    const float half = amplitude / 32767.0f;
+    for (int block = 0; block < 100; ++block) {
+        meter.BeginUpdate(frames, 44100.0f);
+        meter.UpdateTrack(0, amplitude, static_cast<uint64_t>(amplitude * amplitude) * 2 * frames);
+        meter.UpdateMaster(amplitude / 2, static_cast<uint64_t>(amplitude * amplitude / 4) * 2 * frames);
+        meter.EndUpdate();
+    }
+    XCTAssertTrue(meter.GetTrackLevel(0, level));
+    XCTAssertEqualWithAccuracy(level.peak, half, 1e-6);
+    XCTAssertEqualWithAccuracy(level.rms, half, 1e-4);
+    meter.GetMasterLevel(level);
+    XCTAssertEqualWithAccuracy(level.peak, half / 2, 1e-6);
+    XCTAssertEqualWithAccuracy(level.rms, half / 2, 1e-4);
+    XCTAssertTrue(meter.GetTrackLevel(1, level));
+    XCTAssertEqual(level.peak, 0.0f);
+    XCTAssertFalse(meter.GetTrackLevel(2, level));
+    XCTAssertFalse(meter.GetTrackLevel(-1, level));
+
+    //  silence : the peak falls by 1/e in 0.3 sec, the mean square in 0.1 sec
+    for (int block = 0; block < 30; ++block) {
+        meter.BeginUpdate(frames, 44100.0f);
+        meter.UpdateTrack(0, 0, 0);
+        meter.EndUpdate();
+    }
+    XCTAssertTrue(meter.GetTrackLevel(0, level));
+    XCTAssertEqualWithAccuracy(level.peak, half * std::exp(-1.0f), 1e-4);
+    XCTAssertEqualWithAccuracy(level.rms, half * std::exp(-1.5f), 1e-4);
+
+    //  without ballistics the rms of a square wave is its peak : a torn read mixes two updates
+    meter.BeginUpdate(frames, 1.0f);
+    meter.UpdateTrack(0, 256, static_cast<uint64_t>(256 * 256) * 2 * frames);
+    meter.EndUpdate();
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int32_t step = 1; !done.load(); step = (step % 127) + 1) {
+            const int32_t peak = step * 256;    //  the square is exact in float
+            meter.BeginUpdate(frames, 1.0f);
+            meter.UpdateTrack(0, peak, static_cast<uint64_t>(peak * peak) * 2 * frames);
+            meter.EndUpdate();
+        }
+    });
+    int torn = 0;
+    for (int read = 0; read < 100000; ++read) {
+        meter.GetTrackLevel(0, level);
+        torn += (level.peak != level.rms) ? 1 : 0;
+    }
+    done = true;
+    writer.join();
+    XCTAssertEqual(torn, 0);
+}
+
+- (void)testTrackAndMasterLevels {
+    //  a track alone : its level is the level of the mix
+    Synthesizer synth(44100.0f);
+    Sequencer* seq = new Sequencer(44100.0f, 2, 16, 4);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(std::vector<std::string>(2, soundDirectory_ + "/kick.wav"));
+    std::vector<bool> sequence(16, false);
+    sequence[0] = sequence[8] = true;
+    seq->UpdateTrack(0, sequence);
+    synth.SetAmpCoefficient(0, 0x7FFF);
+    seq->Start(0, 120.0f);
+
+    std::vector<int16_t> left(512), right(512);
+    float maxPeak = 0.0f;
+    for (int block = 0; block < 200; ++block) {
+        int16_t* buffer[] = { &left[0], &right[0] };
+        synth.ProcessReplacing(NULL, buffer, 512);
+        LevelMeter::Level track, silent, master;
+        XCTAssertTrue(synth.GetTrackLevel(0, track));
+        XCTAssertTrue(synth.GetTrackLevel(1, silent));
+        synth.GetMasterLevel(master);
+        XCTAssertEqual(track.peak, master.peak, @"block %d", block);
+        XCTAssertEqual(track.rms, master.rms, @"block %d", block);
+        XCTAssertEqual(silent.peak, 0.0f);
+        maxPeak = std::max(maxPeak, master.peak);
+    }
+    XCTAssertGreaterThan(maxPeak, 0.25f);   //  the kick at full scale, panned to the center
+    LevelMeter::Level level;
+    XCTAssertFalse(synth.GetTrackLevel(-1, level));
+}
+
+- (void)testPerformanceMonitor {
+    //  the kick on every step, rendered through the callback of AudioIO without the hardware
+    AudioIO io(44100.0f);
+    Synthesizer synth(44100.0f);
+    Sequencer* seq = new Sequencer(44100.0f, 1, 16, 4);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(std::vector<std::string>(1, soundDirectory_ + "/kick.wav"));
+    seq->UpdateTrack(0, std::vector<bool>(16, true));
+    seq->Start(0, 120.0f);
+    io.SetListener(&synth);
+    PerformanceMonitor& monitor = io.GetPerformanceMonitor();
+
+    //  every snapshot read while rendering is consistent
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+    std::thread reader([&]() {
+        while (!done.load()) {
+            PerformanceMonitor::Snapshot snapshot;
+            monitor.GetSnapshot(snapshot);
+            uint64_t count = 0;
+            for (const auto bin : snapshot.callbackHistogram) {
+                count += bin;
+            }
+            if ((count != snapshot.numberOfCallbacks) || (snapshot.activeVoices > snapshot.maxActiveVoices)) {
+                ++torn;
+            }
+        }
+    });
+    std::vector<int16_t> output(512 * 2);
+    const int numOfCallbacks = 1723;        //  a bit more than 10 loops(5512.5 frames per step)
+    for (int block = 0; block < numOfCallbacks; ++block) {
+        io.RenderOffline(&output[0], 512, 0);
+    }
+    done = true;
+    reader.join();
+    XCTAssertEqual(torn.load(), 0);
+
+    PerformanceMonitor::Snapshot snapshot;
+    monitor.GetSnapshot(snapshot);
+    uint64_t count = 0;
+    for (const auto bin : snapshot.callbackHistogram) {
+        count += bin;
+    }
+    XCTAssertEqual(snapshot.numberOfCallbacks, (uint64_t)numOfCallbacks);
+    XCTAssertEqual(count, (uint64_t)numOfCallbacks);
+    XCTAssertLessThanOrEqual(snapshot.numberOfDeadlineMisses, snapshot.numberOfCallbacks);
+    XCTAssertGreaterThanOrEqual(snapshot.numberOfEvents, 160ULL);   //  10 loops and the first step of the next one
+    XCTAssertLessThanOrEqual(snapshot.numberOfEvents, 161ULL);
+    XCTAssertEqual(snapshot.maxActiveVoices, 1U);
+    XCTAssertGreaterThan(snapshot.maxCallbackNanosec, 0ULL);
+    XCTAssertLessThanOrEqual(snapshot.maxCallbackNanosec, snapshot.totalCallbackNanosec);
+    XCTAssertLessThanOrEqual(snapshot.sequencerNanosec + snapshot.renderNanosec, snapshot.totalCallbackNanosec);
+
+    //  cleared at the next callback
+    monitor.Reset();
+    io.RenderOffline(&output[0], 512, 0);
+    monitor.GetSnapshot(snapshot);
+    XCTAssertEqual(snapshot.numberOfCallbacks, 1ULL);
+    XCTAssertLessThanOrEqual(snapshot.maxActiveVoices, 1U);
+}
+
+//  log only : the cost of a callback depends on the machine running the tests
+- (void)testCallbackCostVersusBlockSize {
+    static const uint32_t kBlockSizes[] = { 32, 64, 128, 256, 512, 1024 };
+    const RenderCorpus::Case& rc = RenderCorpus::kCases[0];
+    const float samplingRate = 44100.0f;
+    for (const uint32_t blockSize : kBlockSizes) {
+        //  the sounds are loaded before the measurement
+        AudioIO io(samplingRate);
+        Synthesizer synth(samplingRate);
+        Sequencer* seq = RenderCorpus::Setup(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, 0, synth, samplingRate);
+        seq->Start(0, rc.tempo);
+        io.SetListener(&synth);
+        std::vector<int16_t> output(blockSize * 2);
+        io.RenderOffline(&output[0], blockSize, 0);     //  the oscillators are taken at the first callback
+
+        //  measured by the performance monitor of the callback
+        PerformanceMonitor& monitor = io.GetPerformanceMonitor();
+        monitor.Reset();
+        const uint32_t numOfCallbacks = static_cast<uint32_t>(samplingRate) * 4 / blockSize;
+        for (uint32_t callbackNo = 0; callbackNo < numOfCallbacks; ++callbackNo) {
+            io.RenderOffline(&output[0], blockSize, 0);
+        }
+        PerformanceMonitor::Snapshot snapshot;
+        monitor.GetSnapshot(snapshot);
+        XCTAssertEqual(snapshot.numberOfCallbacks, (uint64_t)numOfCallbacks);
+
+        const double meanNanosec = static_cast<double>(snapshot.totalCallbackNanosec) / numOfCallbacks;
+        const double budgetNanosec = blockSize * 1e9 / samplingRate;
+        NSLog(@"block %4u: %7.2f usec/callback(max %7.2f), %6.1f nsec/frame, %5.2f%% of the buffer duration, %llu misses",
+              blockSize, meanNanosec / 1000.0, snapshot.maxCallbackNanosec / 1000.0, meanNanosec / blockSize,
+              meanNanosec / budgetNanosec * 100.0, snapshot.numberOfDeadlineMisses);
+    }
+}
+
+- (void)testTriggerQueue {
+    TriggerQueue queue(Sequencer::kMaxNumberOfTracks);
+    uint64_t hostTime = 0;
+    int step = 0;
+    std::vector<int> tracks;
+    XCTAssertFalse(queue.Pop(hostTime, step, tracks));
+
+    //  the tracks come back in order, through the words of the bitset
+    const std::vector<int> triggered = { 0, 31, 32, 100, Sequencer::kMaxNumberOfTracks - 1 };
+    queue.Push(1000, 3, triggered);
+    queue.Push(2000, 4, std::vector<int>());
+    XCTAssertTrue(queue.Pop(hostTime, step, tracks));
+    XCTAssertEqual(hostTime, 1000ULL);
+    XCTAssertEqual(step, 3);
+    XCTAssert(tracks == triggered);
+    XCTAssertTrue(queue.Pop(hostTime, step, tracks));
+    XCTAssertEqual(hostTime, 2000ULL);
+    XCTAssertEqual(step, 4);
+    XCTAssertTrue(tracks.empty());
+    XCTAssertFalse(queue.Pop(hostTime, step, tracks));
+
+    //  a full queue drops the new triggers and keeps the old ones
+    for (int i = 0; i < TriggerQueue::kCapacity + 10; ++i) {
+        queue.Push(i, i, triggered);
+    }
+    XCTAssertEqual(queue.GetNumberOfDroppedTriggers(), 10ULL);
+    for (int i = 0; i < TriggerQueue::kCapacity; ++i) {
+        XCTAssertTrue(queue.Pop(hostTime, step, tracks));
+        XCTAssertEqual(step, i);
+    }
+    XCTAssertFalse(queue.Pop(hostTime, step, tracks));
+}
+
+- (void)testPerformanceScalarKernel {
+    __block std::vector<int16_t> output;
+    [self measureBlock:^{
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            RenderCorpus::Render(RenderCorpus::kCases[caseNo], DrumOscillator::kRenderKernel_Scalar, soundDirectory_, output);
+        }
+    }];
+}
+
+- (void)testPerformanceBlockKernel {
+    __block std::vector<int16_t> output;
+    [self measureBlock:^{
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            RenderCorpus::Render(RenderCorpus::kCases[caseNo], DrumOscillator::kRenderKernel_Block, soundDirectory_, output);
+        }
+    }];
+}
+
+- (void)testPerformanceEarlyRelease {
+    __block std::vector<int16_t> output;
+    [self measureBlock:^{
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            RenderCorpus::Render(RenderCorpus::kCases[caseNo], DrumOscillator::kRenderKernel_Block, soundDirectory_,
+                                 output, NULL, 128);    //  -48dB
+        }
+    }];
+}
+
+- (void)testStems {
+    const std::vector<int> eachTrack = { 0, 1, 2, 3 };
+    for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+        RenderCorpus::Case rc = RenderCorpus::kCases[caseNo];
+        rc.frames *= 4;
+        std::vector< std::vector<int16_t> > stems, block, cached, solo;
+        uint64_t cachedFrames = 0;
+        RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, eachTrack, 4, stems);
+        RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Block, soundDirectory_, eachTrack, 4, block);
+        RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Block, soundDirectory_, eachTrack, 4, cached,
+                                  &cachedFrames);
+        XCTAssertTrue(block == stems, @"%s", rc.name);
+        XCTAssertTrue(cached == stems, @"%s", rc.name);
+
+        //  each stem is the track rendered alone
+        for (int trackNo = 0; trackNo < RenderCorpus::kNumberOfTracks; ++trackNo) {
+            std::vector<int> alone(RenderCorpus::kNumberOfTracks, -1);
+            alone[trackNo] = 0;
+            RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, alone, 1, solo);
+            XCTAssertTrue(solo[0] == stems[trackNo], @"%s: track %d", rc.name, trackNo);
+        }
+    }
+
+    //  a bus of a group mixes its tracks as the master does
+    const RenderCorpus::Case& rc = RenderCorpus::kCases[0];
+    std::vector< std::vector<int16_t> > groups;
+    std::vector<int16_t> master;
+    RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, { 1, 1, 1, 1 }, 2, groups);
+    RenderCorpus::Render(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, master);
+    XCTAssertTrue(groups[1] == master);
+    XCTAssertTrue(std::all_of(groups[0].begin(), groups[0].end(), [](int16_t value) { return value == 0; }));
+}
+
+- (void)testStemWriter {
+    const RenderCorpus::Case& rc = RenderCorpus::kCases[1];
+    std::vector< std::vector<int16_t> > stems;
+    RenderCorpus::RenderStems(rc, DrumOscillator::kRenderKernel_Scalar, soundDirectory_, { 0, 1, 2, 3 }, 4, stems);
+
+    //  written in odd blocks, across the chunks
+    const std::string directory = [NSTemporaryDirectory() fileSystemRepresentation];
+    std::vector<std::string> paths;
+    for (int busNo = 0; busNo < 4; ++busNo) {
+        paths.push_back(directory + "/stem" + std::to_string(busNo) + ".wav");
+    }
+    StemWriter writer;
+    XCTAssertTrue(writer.Open(paths, 44100));
+    const uint32_t frames = rc.frames;
+    for (uint32_t position = 0; position < frames; position += 1000) {
+        std::vector< std::vector<int16_t> > channels(8);
+        int16_t* buffer[8];
+        const uint32_t length = std::min<uint32_t>(1000, frames - position);
+        for (int ch = 0; ch < 8; ++ch) {
+            for (uint32_t i = 0; i < length; ++i) {
+                channels[ch].push_back(stems[ch / 2][(position + i) * 2 + (ch % 2)]);
+            }
+            buffer[ch] = &channels[ch][0];
+        }
+        XCTAssertTrue(writer.Write(buffer, length));
+    }
+    XCTAssertEqual(writer.GetNumberOfFrames(), (uint64_t)frames);
+    XCTAssertTrue(writer.Close());
+
+    for (int busNo = 0; busNo < 4; ++busNo) {
+        NSData* data = [NSData dataWithContentsOfFile:[NSString stringWithUTF8String:paths[busNo].c_str()]];
+        XCTAssertEqual(data.length, 44 + frames * 4);
+        const uint8_t* bytes = static_cast<const uint8_t*>(data.bytes);
+        XCTAssertEqual(::memcmp(bytes, "RIFF", 4), 0);
+        XCTAssertEqual(::memcmp(bytes + 44, &stems[busNo][0], frames * 4), 0, @"bus %d", busNo);
+        ::remove(paths[busNo].c_str());
+    }
+}
+
+//  a session edited while playing is replayed from its trace sample for sample
+- (void)testTraceReplay {
+    const float samplingRate = 44100.0f;
+    std::vector<std::string> sounds, swapped;
+    for (const char* sound : RenderCorpus::kSounds) {
+        sounds.push_back(soundDirectory_ + "/" + sound);
+    }
+    swapped.assign(sounds.rbegin(), sounds.rend());
+
+    Synthesizer synth(samplingRate);
+    Sequencer* seq = new Sequencer(samplingRate, 4, 8, 2);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetSoundSet(sounds);
+    TraceRecorder recorder(1 << 16);
+    synth.SetTraceRecorder(&recorder);
+    seq->UpdateTrack(0, { 1, 0, 0, 0, 1, 0, 0, 0 });
+    seq->UpdateTrack(1, { 0, 0, 1, 0, 0, 0, 1, 0 });
+    seq->SetRandomSeed(7);
+    seq->Start(0, 120.0f);
+
+    //  playing before the recording starts : the snapshot takes the state over
+    std::vector<int16_t> left(4096), right(4096), live;
+    int16_t* buffer[] = { &left[0], &right[0] };
+    for (int i = 0; i < 7; ++i) {
+        synth.ProcessReplacing(NULL, buffer, 1000);
+    }
+    recorder.Start(samplingRate, 4, 8, 2, synth.GetSoundSet());
+    synth.SetSoundSet(swapped);     //  before the snapshot is taken
+    const uint32_t lengths[] = { 512, 1024, 37, 4096, 256 };
+    for (int i = 0; i < 200; ++i) {
+        if (i == 20) {
+            seq->UpdateTrack(2, std::vector<bool>(8, true));
+        } else if (i == 30) {
+            seq->UpdateTempo(0, 150.0f);
+        } else if (i == 40) {
+            const uint16_t probabilities[8] = { 0x4000, 0x4000, 0x2000, 0x6000, 0x4000, 0x4000, 0x4000, 0x1000 };
+            const uint8_t delays[8] = { 0, 50, 0, 250, 0, 10, 0, 0 };
+            seq->UpdateStepLanes(2, 1, NULL, probabilities, delays, NULL, 8);
+        } else if (i == 50) {
+            synth.SetPanPosition(1, 0);
+        } else if (i == 60) {
+            synth.SetAmpCoefficient(0, 0x2000);
+        } else if (i == 90) {
+            seq->Stop(0);
+        } else if (i == 95) {
+            seq->Start(0, 97.0f);
+        } else if (i == 120) {
+            synth.SetSoundSet(sounds);
+        }
+        const uint32_t length = lengths[i % 5];
+        synth.ProcessReplacing(NULL, buffer, length);
+        for (uint32_t frame = 0; frame < length; ++frame) {
+            live.push_back(left[frame]);
+            live.push_back(right[frame]);
+        }
+    }
+    const std::string path = std::string([NSTemporaryDirectory() fileSystemRepresentation]) + "/replay.trace";
+    XCTAssertTrue(recorder.WriteToFile(path));
+    XCTAssertEqual(recorder.GetNumberOfDroppedRecords(), 0ULL);
+
+    TraceReplayer replayer;
+    XCTAssertTrue(replayer.Load(path));
+    XCTAssertEqual(replayer.GetNumberOfCallbacks(), (size_t)200);
+    std::vector<int16_t> replayed;
+    XCTAssertTrue(replayer.Replay([&replayed](int16_t** output, const uint32_t length) {
+        for (uint32_t frame = 0; frame < length; ++frame) {
+            replayed.push_back(output[0][frame]);
+            replayed.push_back(output[1][frame]);
+        }
+    }));
+    ::remove(path.c_str());
+
+    XCTAssertEqual(replayed.size(), live.size());
+    size_t firstDiff = 0;
+    while ((firstDiff < live.size()) && (firstDiff < replayed.size()) && (live[firstDiff] == replayed[firstDiff])) {
+        ++firstDiff;
+    }
+    XCTAssertEqual(firstDiff, live.size(), @"first difference at frame %zu", firstDiff / 2);
+    XCTAssertLessThan((size_t)std::count(live.begin(), live.end(), 0), live.size() / 2, @"silent");
+}
+
+//  4 stems in a single pass. compare with testPerformanceStemsBySolos
+- (void)testPerformanceStems {
+    __block std::vector< std::vector<int16_t> > stems;
+    [self measureBlock:^{
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            RenderCorpus::RenderStems(RenderCorpus::kCases[caseNo], DrumOscillator::kRenderKernel_Block,
+                                      soundDirectory_, { 0, 1, 2, 3 }, 4, stems);
+        }
+    }];
+}
+
+//  4 stems by rendering each track alone
+- (void)testPerformanceStemsBySolos {
+    __block std::vector< std::vector<int16_t> > stems;
+    [self measureBlock:^{
+        for (int caseNo = 0; caseNo < RenderCorpus::kNumberOfCases; ++caseNo) {
+            for (int trackNo = 0; trackNo < RenderCorpus::kNumberOfTracks; ++trackNo) {
+                std::vector<int> alone(RenderCorpus::kNumberOfTracks, -1);
+                alone[trackNo] = 0;
+                RenderCorpus::RenderStems(RenderCorpus::kCases[caseNo], DrumOscillator::kRenderKernel_Block,
+                                          soundDirectory_, alone, 1, stems);
+            }
+        }
+    }];
+}
+
+- (void)testClockSync {
+    //  a steady clock : every step on its frame(the triggers are on whole frames)
+    ClockSync::Report report;
+    std::vector<double> errors = SyncToClock(120.0, 0.0, 0, report);
+    XCTAssertEqual(errors.size(), (size_t)120);
+    for (const auto error : errors) {
+        XCTAssertLessThanOrEqual(std::fabs(error), 1.0);
+    }
+    XCTAssertTrue(report.isLocked);
+    XCTAssertEqualWithAccuracy(report.tempo, 120.0, 0.001);
+    XCTAssertEqual(report.numberOfRelocations, 1ULL);      //  to the clock once locked
+
+    //  1msec of jitter(0.58msec rms) : the steps are much steadier than the ticks
+    errors = SyncToClock(123.4, 0.001, 0, report);
+    XCTAssertFalse(errors.empty());
+    for (const auto error : errors) {
+        XCTAssertLessThan(std::fabs(error), 0.001 * 44100);
+    }
+    XCTAssertLessThan(RootMeanSquare(errors), report.jitterRms * 44100 / 2);
+    XCTAssertEqualWithAccuracy(report.tempo, 123.4, 0.1);
+    XCTAssertEqual(report.numberOfRelocations, 1ULL);
+    XCTAssertLessThan(report.errorRms, 0.001);
+    XCTAssertLessThan(std::fabs(report.latency), 0.0005);
+
+    //  the lost ticks are bridged
+    errors = SyncToClock(123.4, 0.001, 10, report);
+    XCTAssertGreaterThan(report.numberOfMissedTicks, 0ULL);
+    XCTAssertEqual(report.numberOfRelocks, 0ULL);
+    XCTAssertLessThan(RootMeanSquare(errors), report.jitterRms * 44100 / 2);
+}
+
+@end
@@ -0,0 +1,228 @@
+//
+//  RenderCorpus.h
+//  HKLStepSequencerTests
+//
+//  Created by Hirohito Kato on 2026/10/19.
+//  Copyright © 2026 Hirohito Kato. All rights reserved.
+//
+//  Reference renders of the audio engine. Each case is rendered offline
+//  (without AudioIO) and its output is compared with the hash of the render
+//  produced by the scalar kernel, so any change of the output is detected.
+//
+
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include "RenderContext.h"
+#include "Sequencer.h"
+#include "DrumOscillator.h"
+#include "LevelMeter.h"
+#include "LoopCache.h"
+#include "Synthesizer.h"
+
+namespace RenderCorpus {
+
+enum { kNumberOfTracks = 4 };
+
+typedef struct {
+    const char* name;
+    float       tempo;
+    int         numberOfSteps;
+    int         stepsPerBeat;
+    uint32_t    patterns[kNumberOfTracks];  //  bit N : step N
+    int         pans[kNumberOfTracks];      //  0-127
+    int32_t     gains[kNumberOfTracks];     //  0x0-0xFFFF
+    uint32_t    frames;
+    uint32_t    blockSize;
+    uint32_t    tempoChangeFrame;           //  0 : none
+    float       newTempo;
+    uint64_t    goldenHash;                 //  FNV-1a of the interleaved scalar render
+} Case;
+
+static const char* const kSounds[kNumberOfTracks] = { "kick.wav", "snare.wav", "zap.wav", "noiz.wav" };
+
+static const Case kCases[] = {
+    { "four_on_the_floor", 120.0f, 16, 4, { 0x1111, 0x1010, 0xAAAA, 0x0000 }, { 64, 64, 64, 64 },
+      { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF }, 88200, 1024, 0, 0.0f, 0x8682b60b5b7565d0ULL },
+    { "hard_pans", 120.0f, 16, 4, { 0x1111, 0x1010, 0xAAAA, 0x8888 }, { 0, 127, 32, 96 },
+      { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF }, 88200, 1024, 0, 0.0f, 0x9ff449c6177bae16ULL },
+    { "gains", 120.0f, 16, 4, { 0x1111, 0x1010, 0xAAAA, 0x8888 }, { 64, 64, 64, 64 },
+      { 0x0000, 0x4000, 0x7FFF, 0xFFFF }, 88200, 1024, 0, 0.0f, 0x4fa2a626722efc6aULL },
+    { "dense_clipping", 240.0f, 8, 2, { 0xFF, 0xFF, 0xFF, 0xFF }, { 64, 64, 64, 64 },
+      { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF }, 88200, 1024, 0, 0.0f, 0x1a6f66002f650d25ULL },
+    { "odd_tempo", 133.3f, 7, 3, { 0x49, 0x12, 0x7F, 0x24 }, { 40, 80, 64, 20 },
+      { 0x6000, 0x7FFF, 0x3000, 0x9000 }, 88200, 512, 0, 0.0f, 0x1c37bcc4845a2090ULL },
+    { "tempo_change_mid_block", 120.0f, 16, 4, { 0x1111, 0x1010, 0xAAAA, 0x8888 }, { 64, 0, 127, 64 },
+      { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF }, 88200, 512, 30001, 171.5f, 0xb93b0c27cc76574cULL },
+    { "tiny_blocks", 120.0f, 16, 4, { 0x1111, 0x1010, 0xAAAA, 0x8888 }, { 64, 64, 64, 64 },
+      { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF }, 44100, 37, 0, 0.0f, 0x64a25161e851e43cULL },
+    { "retrigger", 600.0f, 16, 4, { 0xFFFF, 0x5555, 0x3333, 0x0F0F }, { 64, 64, 64, 64 },
+      { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF }, 88200, 4096, 0, 0.0f, 0x8d214b07f33286d5ULL },
+};
+
+static const int kNumberOfCases = sizeof(kCases) / sizeof(kCases[0]);
+
+//  ---------------------------------------------------------------------------
+//      Hash                    FNV-1a 64bit of little-endian samples
+//  ---------------------------------------------------------------------------
+static inline uint64_t
+Hash(const std::vector<int16_t>& samples)
+{
+    uint64_t    hash = 0xcbf29ce484222325ULL;
+    for (const int16_t sample : samples)
+    {
+        const uint16_t  value = static_cast<uint16_t>(sample);
+        hash = (hash ^ (value & 0xFF)) * 0x100000001b3ULL;
+        hash = (hash ^ (value >> 8)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//  ---------------------------------------------------------------------------
+//      Setup                   the synthesizer ready to start the case
+//  ---------------------------------------------------------------------------
+//  returns the sequencer(owned by synth), not started yet
+static inline Sequencer*
+Setup(const Case& rc, const int kernel, const std::string& soundDirectory, const int32_t releaseLevel,
+      Synthesizer& synth, const float samplingRate)
+{
+    Sequencer*  seq = new Sequencer(samplingRate, kNumberOfTracks, rc.numberOfSteps, rc.stepsPerBeat);
+    synth.SetSequencer(seq);    //  owned by synth
+    synth.SetRenderKernel(kernel);
+
+    std::vector<std::string>    sounds;
+    for (const char* sound : kSounds)
+    {
+        sounds.push_back(soundDirectory + "/" + sound);
+    }
+    synth.SetSoundSet(sounds);
+    synth.SetReleaseLevel(releaseLevel);
+    for (int trackNo = 0; trackNo < kNumberOfTracks; ++trackNo)
+    {
+        std::vector<bool>   sequence(rc.numberOfSteps);
+        for (int step = 0; step < rc.numberOfSteps; ++step)
+        {
+            sequence[step] = ((rc.patterns[trackNo] >> step) & 1) != 0;
+        }
+        seq->UpdateTrack(trackNo, sequence);
+        synth.SetPanPosition(trackNo, rc.pans[trackNo]);
+        synth.SetAmpCoefficient(trackNo, rc.gains[trackNo]);
+    }
+    return seq;
+}
+
+//  ---------------------------------------------------------------------------
+//      RenderBuses             interleaved stereo output of each bus
+//  ---------------------------------------------------------------------------
+//  trackBuses : NULL renders the master output(ProcessReplacing) into outputs[0],
+//  otherwise the bus of each track(ProcessStems).
+//  cachedFrames : if not NULL, the loop cache is enabled and rendered after
+//  every block. returns the number of frames played from it.
+//  releaseLevel : Synthesizer::SetReleaseLevel. 0 renders the whole sounds
+//  loopCacheMaxBytes : Synthesizer::SetLoopCacheMaxBytes
+static inline void
+RenderBuses(const Case& rc, const int kernel, const std::string& soundDirectory,
+            const std::vector<int>* trackBuses, const int numberOfBuses,
+            std::vector< std::vector<int16_t> >& outputs, uint64_t* cachedFrames, const int32_t releaseLevel,
+            const size_t loopCacheMaxBytes = LoopCache::kDefaultMaxBytes)
+{
+    const float samplingRate = 44100.0f;
+    Synthesizer synth(samplingRate);
+    Sequencer*  seq = Setup(rc, kernel, soundDirectory, releaseLevel, synth, samplingRate);
+    for (int trackNo = 0; trackNo < kNumberOfTracks; ++trackNo)
+    {
+        if ((trackBuses != NULL) && (static_cast<size_t>(trackNo) < trackBuses->size()))
+        {
+            synth.SetTrackBus(trackNo, (*trackBuses)[trackNo]);
+        }
+    }
+    if (cachedFrames != NULL)
+    {
+        synth.SetLoopCacheMaxBytes(loopCacheMaxBytes);
+        synth.SetLoopCacheEnabled(true, false);
+    }
+    seq->Start(0, rc.tempo);
+
+    const int   numOfChannels = numberOfBuses * 2;
+    std::vector< std::vector<int16_t> > channels(numOfChannels, std::vector<int16_t>(rc.blockSize));
+    std::vector<int16_t*>   buffer(numOfChannels);
+    const auto  render = [&](const uint32_t offset, const uint32_t length) {
+        for (int ch = 0; ch < numOfChannels; ++ch)
+        {
+            buffer[ch] = &channels[ch][offset];
+        }
+        if (trackBuses != NULL)
+        {
+            synth.ProcessStems(&buffer[0], numberOfBuses, length);
+        }
+        else
+        {
+            synth.ProcessReplacing(NULL, &buffer[0], length);
+        }
+    };
+    outputs.assign(numberOfBuses, std::vector<int16_t>());
+    for (auto& output : outputs)
+    {
+        output.reserve(rc.frames * 2);
+    }
+    for (uint32_t position = 0; position < rc.frames; position += rc.blockSize)
+    {
+        const uint32_t  length = std::min(rc.blockSize, rc.frames - position);
+        uint32_t    split = length;
+        if ((rc.tempoChangeFrame > position) && (rc.tempoChangeFrame < position + length))
+        {
+            split = rc.tempoChangeFrame - position;
+        }
+        render(0, split);
+        if (split < length)
+        {
+            seq->UpdateTempo(0, rc.newTempo);
+            render(split, length - split);
+        }
+        for (int busNo = 0; busNo < numberOfBuses; ++busNo)
+        {
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                outputs[busNo].push_back(channels[busNo * 2][i]);
+                outputs[busNo].push_back(channels[busNo * 2 + 1][i]);
+            }
+        }
+        if (cachedFrames != NULL)
+        {
+            synth.UpdateLoopCache();
+        }
+    }
+    if (cachedFrames != NULL)
+    {
+        *cachedFrames = synth.GetNumberOfCachedFrames();
+    }
+}
+
+//  ---------------------------------------------------------------------------
+//      Render                  interleaved stereo output of the case
+//  ---------------------------------------------------------------------------
+static inline void
+Render(const Case& rc, const int kernel, const std::string& soundDirectory, std::vector<int16_t>& output,
+       uint64_t* cachedFrames = NULL, const int32_t releaseLevel = 0,
+       const size_t loopCacheMaxBytes = LoopCache::kDefaultMaxBytes)
+{
+    std::vector< std::vector<int16_t> > outputs;
+    RenderBuses(rc, kernel, soundDirectory, NULL, 1, outputs, cachedFrames, releaseLevel, loopCacheMaxBytes);
+    output.swap(outputs[0]);
+}
+
+//  ---------------------------------------------------------------------------
+//      RenderStems             interleaved stereo output of each bus
+//  ---------------------------------------------------------------------------
+static inline void
+RenderStems(const Case& rc, const int kernel, const std::string& soundDirectory, const std::vector<int>& trackBuses,
+            const int numberOfBuses, std::vector< std::vector<int16_t> >& stems, uint64_t* cachedFrames = NULL)
+{
+    RenderBuses(rc, kernel, soundDirectory, &trackBuses, numberOfBuses, stems, cachedFrames, 0);
+}
+
+}   //  namespace RenderCorpus